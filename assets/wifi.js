@@ -0,0 +1,165 @@
+/* Configure WiFi page */
+let selectedNetwork = null;
+
+// Networks on the page by BSSID, patched in place from /scan?since= diffs
+const shownNetworks = new Map();
+let scanGeneration = 0;
+
+function loadNetworks(refresh) {
+    const container = document.getElementById('networks');
+    if (!refresh) {
+        container.innerHTML = '<div class="loading">Scanning networks...</div>';
+        shownNetworks.clear();
+        scanGeneration = 0;
+    }
+    
+    fetch('/scan?since=' + scanGeneration)
+        .then(response => {
+            // Background scan still running, the body holds what was found so far
+            const partial = response.status === 202;
+            return response.json().then(scan => ({ scan, partial }));
+        })
+        .then(({ scan, partial }) => {
+            if (partial) {
+                setTimeout(() => loadNetworks(true), 1000);
+            }
+            patchNetworks(container, scan);
+            if (shownNetworks.size === 0 && !partial) {
+                container.innerHTML = '<div class="error">No networks found</div>';
+            }
+        })
+        .catch(error => {
+            console.error('Network scan failed:', error);
+            container.innerHTML = '<div class="error">Error loading networks</div>';
+            shownNetworks.clear();
+            scanGeneration = 0;
+        });
+}
+
+// scan: {gen, full, add: [[bssid, ssid, rssi, channel, auth]], rssi: [[bssid, rssi]], del: [bssid]}
+function patchNetworks(container, scan) {
+    if (scan.full) {
+        shownNetworks.forEach(network => network.div.remove());
+        shownNetworks.clear();
+    }
+    // Removals first, a BSSID can leave and come back within one diff
+    scan.del.forEach(bssid => {
+        const network = shownNetworks.get(bssid);
+        if (network) {
+            network.div.remove();
+            shownNetworks.delete(bssid);
+        }
+    });
+    scan.add.forEach(([bssid, ssid, rssi, channel, encryption]) => {
+        if (!ssid || ssid.trim() === '') return;
+        let network = shownNetworks.get(bssid);
+        if (!network) {
+            network = { div: document.createElement('div') };
+            network.div.className = 'network';
+            network.div.onclick = () => selectNetwork(network.ssid, network.div);
+            shownNetworks.set(bssid, network);
+        }
+        Object.assign(network, { ssid, rssi, channel, encryption });
+        renderNetwork(network);
+    });
+    scan.rssi.forEach(([bssid, rssi]) => {
+        const network = shownNetworks.get(bssid);
+        if (network) {
+            network.rssi = rssi;
+            renderNetwork(network);
+        }
+    });
+    scanGeneration = scan.gen;
+    
+    if (shownNetworks.size > 0) {
+        container.querySelectorAll('.loading, .error').forEach(el => el.remove());
+    }
+    
+    // Strongest first; only nodes out of place are moved, none are rebuilt
+    const ordered = [...shownNetworks.values()].sort((a, b) => b.rssi - a.rssi);
+    ordered.forEach((network, i) => {
+        if (container.children[i] !== network.div) {
+            container.insertBefore(network.div, container.children[i] || null);
+        }
+    });
+}
+
+function renderNetwork(network) {
+    const signalIcon = getSignalIcon(network.rssi);
+    const security = network.encryption > 0 ? '🔒' : '🔓';
+    
+    network.div.innerHTML = `
+        <div>
+            <div class="network-name">${escapeHtml(network.ssid)} ${security}</div>
+            <div class="network-info">Channel ${network.channel}, ${network.rssi}dBm</div>
+        </div>
+        <div class="signal">${signalIcon}</div>
+    `;
+}
+
+function selectNetwork(ssid, element) {
+    if (selectedNetwork) {
+        selectedNetwork.classList.remove('selected');
+    }
+    selectedNetwork = element;
+    element.classList.add('selected');
+    document.getElementById('s').value = ssid;
+    
+    // Focus the password field for immediate typing
+    document.getElementById('p').focus();
+}
+
+function getSignalIcon(rssi) {
+    let bars = '';
+    let color = '#dc3545'; // Default red for weak
+    
+    if (rssi > -30) {
+        bars = '4';
+        color = '#28a745'; // Green for excellent
+    } else if (rssi > -50) {
+        bars = '3'; 
+        color = '#28a745'; // Green for good
+    } else if (rssi > -60) {
+        bars = '2';
+        color = '#ffc107'; // Yellow for fair
+    } else if (rssi > -70) {
+        bars = '1';
+        color = '#fd7e14'; // Orange for poor
+    } else {
+        bars = '0';
+        color = '#dc3545'; // Red for weak
+    }
+    
+    return `<div class="wifi-signal signal-${bars}" style="color: ${color};">
+                <div class="bar bar1"></div>
+                <div class="bar bar2"></div>
+                <div class="bar bar3"></div>
+                <div class="bar bar4"></div>
+            </div>`;
+}
+
+function escapeHtml(text) {
+    const div = document.createElement('div');
+    div.textContent = text;
+    return div.innerHTML;
+}
+
+function togglePassword() {
+    const passwordField = document.getElementById('p');
+    const checkbox = document.getElementById('showPass');
+    passwordField.type = checkbox.checked ? 'text' : 'password';
+}
+
+function validateForm() {
+    const ssid = document.getElementById('s').value.trim();
+    if (!ssid) {
+        alert('Please select or enter a network SSID');
+        return false;
+    }
+    return true;
+}
+
+// Load networks on page load
+window.onload = function() {
+    loadNetworks();
+};
@@ -29,8 +29,17 @@ function scanNetworks(callback) {
     wmState.scanInProgress = true;
     
     fetch('/scan')
-        .then(response => response.json())
+        .then(response => {
+            // Background scan still running with nothing cached yet
+            if (response.status === 202) {
+                wmState.scanInProgress = false;
+                setTimeout(() => scanNetworks(callback), 2000);
+                return null;
+            }
+            return response.json();
+        })
         .then(networks => {
+            if (!networks) return;
             wmState.networks = networks;
             wmState.scanInProgress = false;
             if (callback) callback(networks);
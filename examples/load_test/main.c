@@ -0,0 +1,75 @@
+/**
+ * @file main.c
+ * @brief Portal Load Test Example
+ * 
+ * This example benchmarks the captive portal on the device itself:
+ * - Starts the config portal without blocking
+ * - Runs synthetic HTTP probe clients and a DNS query generator over loopback
+ * - Prints client latency, drops and heap low-water when the run ends
+ * 
+ * Requires CONFIG_WM_ENABLE_METRICS, CONFIG_WM_ENABLE_LOAD_TEST and
+ * CONFIG_LWIP_NETIF_LOOPBACK.
+ */
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "WiFiManager.h"
+
+static const char* TAG = "main";
+
+static void print_results(const wm_metrics_t& m) {
+    const wm_load_test_metrics_t& lt = m.loadTest;
+    
+    ESP_LOGI(TAG, "📊 HTTP: %lu ok, %lu errors, %lu dropped, p50 %lu us, p99 %lu us",
+             (unsigned long)lt.httpRequests, (unsigned long)lt.httpErrors, (unsigned long)lt.httpDropped,
+             (unsigned long)lt.httpP50Us, (unsigned long)lt.httpP99Us);
+    ESP_LOGI(TAG, "📊 DNS: %lu answered, %lu timeouts, p50 %lu us, p99 %lu us, peak %lu qps",
+             (unsigned long)lt.dnsQueries, (unsigned long)lt.dnsTimeouts,
+             (unsigned long)lt.dnsP50Us, (unsigned long)lt.dnsP99Us, (unsigned long)m.dnsPeakQPS);
+    ESP_LOGI(TAG, "📊 Heap: %lu free, %lu low-water",
+             (unsigned long)m.heapFree, (unsigned long)m.heapLowWater);
+}
+
+void app_main(void) {
+    ESP_LOGI(TAG, "🚀 Starting Portal Load Test Example");
+    
+    WiFiManager wifiManager;
+    
+    // Keep the portal up for the whole run
+    wifiManager.setConfigPortalBlocking(false);
+    wifiManager.setConfigPortalTimeout(0);
+    
+    if (!wifiManager.startConfigPortal("LoadTest-WiFiManager")) {
+        ESP_LOGE(TAG, "❌ Failed to start config portal");
+        return;
+    }
+    
+    // Four clients every 50 ms and a DNS query every 10 ms for one minute
+    wm_load_test_config_t config = WM_LOAD_TEST_CONFIG_DEFAULT();
+    config.httpClients = 4;
+    config.httpIntervalMs = 50;
+    config.dnsIntervalMs = 10;
+    config.durationMs = 60000;
+    
+    if (!wifiManager.startLoadTest(config)) {
+        ESP_LOGE(TAG, "❌ Load test not available, check the Kconfig options above");
+        return;
+    }
+    
+    // Real phones can join the AP during the run, their requests add to the load
+    while (wifiManager.isLoadTestRunning()) {
+        wifiManager.process();
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    
+    print_results(wifiManager.getMetrics());
+    ESP_LOGI(TAG, "✅ Load test complete, full metrics at http://192.168.4.1/metrics");
+    
+    while (1) {
+        wifiManager.process();
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Just enough of esp_http_server for WMJsonWriter's httpd constructor to
+// link; host code writes through a Sink instead
+
+#include "esp_err.h"
+#include <sys/types.h>
+
+typedef struct httpd_req {
+    void* user_ctx;
+} httpd_req_t;
+
+static inline esp_err_t httpd_resp_send_chunk(httpd_req_t* req, const char* buf, ssize_t len) {
+    (void)req;
+    (void)buf;
+    (void)len;
+    return ESP_FAIL;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Included through wm_config.h, which WiFiManagerParameter.h needs for the
+// WMP_TYPE_* values; nothing in the host-built modules uses it
@@ -0,0 +1,52 @@
+#pragma once
+
+// Mocked esp_wifi: the record types the standalone modules use, laid out as
+// in ESP-IDF 5.x minus the fields they never touch, and a scan API that
+// replays a list set with wm_mock_wifi_set_scan()
+
+#include "esp_err.h"
+#include <cstddef>
+#include <cstdint>
+
+typedef enum {
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_ENTERPRISE,
+    WIFI_AUTH_WPA2_ENTERPRISE = WIFI_AUTH_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK,
+    WIFI_AUTH_WAPI_PSK,
+    WIFI_AUTH_OWE,
+    WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+typedef enum {
+    WIFI_SECOND_CHAN_NONE = 0,
+    WIFI_SECOND_CHAN_ABOVE,
+    WIFI_SECOND_CHAN_BELOW,
+} wifi_second_chan_t;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    wifi_second_chan_t second;
+    int8_t rssi;
+    wifi_auth_mode_t authmode;
+    uint32_t phy_11b:1;
+    uint32_t phy_11g:1;
+    uint32_t phy_11n:1;
+} wifi_ap_record_t;
+
+// Records served by the scan calls below as the result of one scan, copied
+void wm_mock_wifi_set_scan(const wifi_ap_record_t* records, size_t count);
+// Serve the same records again, as if another scan had found them
+void wm_mock_wifi_rewind(void);
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t* number);
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t* number, wifi_ap_record_t* ap_records);
+esp_err_t esp_wifi_scan_get_ap_record(wifi_ap_record_t* ap_record);
+esp_err_t esp_wifi_clear_ap_list(void);
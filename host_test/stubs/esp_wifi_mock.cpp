@@ -0,0 +1,43 @@
+#include "esp_wifi.h"
+#include <cstring>
+#include <vector>
+
+// The driver hands records out once each after a scan, in its own order
+static std::vector<wifi_ap_record_t> s_records;
+static size_t s_next;
+
+void wm_mock_wifi_set_scan(const wifi_ap_record_t* records, size_t count) {
+    s_records.assign(records, records + count);
+    s_next = 0;
+}
+
+void wm_mock_wifi_rewind(void) {
+    s_next = 0;
+}
+
+esp_err_t esp_wifi_scan_get_ap_num(uint16_t* number) {
+    *number = static_cast<uint16_t>(s_records.size() - s_next);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t* number, wifi_ap_record_t* ap_records) {
+    size_t n = s_records.size() - s_next;
+    if (n > *number) n = *number;
+    memcpy(ap_records, s_records.data() + s_next, n * sizeof(wifi_ap_record_t));
+    s_next = s_records.size();  // Like the driver, the rest of the list is freed
+    *number = static_cast<uint16_t>(n);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_record(wifi_ap_record_t* ap_record) {
+    if (s_next >= s_records.size()) {
+        return ESP_FAIL;
+    }
+    *ap_record = s_records[s_next++];
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_clear_ap_list(void) {
+    s_next = s_records.size();
+    return ESP_OK;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Host builds have no menuconfig; every CONFIG_ option is unset unless
+// passed on the command line, e.g. -DCONFIG_WM_LOG_LEVEL=5
@@ -0,0 +1,61 @@
+#include "wm_test.h"
+#include "wm_replay.h"
+#include "wm_dns.h"
+
+static const uint8_t PORTAL_IP[4] = {192, 168, 4, 1};
+
+static uint16_t get16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+WM_TEST(dns_answers_captured_queries) {
+    std::vector<WMDnsCapture> captures;
+    WM_CHECK(wmLoadDnsCaptures("dns_queries.txt", captures));
+    WM_CHECK(!captures.empty());
+    
+    uint32_t ip;
+    memcpy(&ip, PORTAL_IP, 4);
+    WMDnsResponder dns(ip);
+    
+    for (const WMDnsCapture& capture : captures) {
+        uint8_t packet[WMDnsResponder::MAX_PACKET_SIZE] = {};
+        memcpy(packet, capture.packet.data(), capture.packet.size());
+        int len = dns.respond(packet, static_cast<int>(capture.packet.size()));
+        
+        if (capture.expect == "DROP") {
+            WM_CHECK_EQ(len, 0);
+            continue;
+        }
+        WM_CHECK(len >= 12);
+        WM_CHECK_EQ(get16(packet), get16(capture.packet.data()));   // Transaction ID
+        uint16_t flags = get16(packet + 2);
+        WM_CHECK(flags & 0x8000);
+        WM_CHECK_EQ(get16(packet + 8), 0);
+        WM_CHECK_EQ(get16(packet + 10), 0);
+        
+        if (capture.expect == "A") {
+            WM_CHECK_EQ(flags & 0x000F, 0);
+            WM_CHECK_EQ(get16(packet + 6), 1);
+            WM_CHECK(memcmp(packet + len - 4, PORTAL_IP, 4) == 0);
+        } else if (capture.expect == "EMPTY") {
+            WM_CHECK_EQ(flags & 0x000F, 0);
+            WM_CHECK_EQ(get16(packet + 6), 0);
+        } else if (capture.expect == "NOTIMP") {
+            WM_CHECK_EQ(flags & 0x000F, 4);
+            WM_CHECK_EQ(len, 12);
+        } else if (capture.expect == "FORMERR") {
+            WM_CHECK_EQ(flags & 0x000F, 1);
+            WM_CHECK_EQ(len, 12);
+        } else {
+            WM_CHECK(!"unknown expectation");
+        }
+    }
+}
+
+WM_TEST(dns_skips_names) {
+    const uint8_t name[] = {3, 'w', 'w', 'w', 4, 't', 'e', 's', 't', 0, 0xC0, 12};
+    WM_CHECK_EQ(WMDnsResponder::skipName(name, sizeof(name), 0), 10);
+    WM_CHECK_EQ(WMDnsResponder::skipName(name, sizeof(name), 10), 12);
+    WM_CHECK_EQ(WMDnsResponder::skipName(name, 11, 10), -1);
+    WM_CHECK_EQ(WMDnsResponder::skipName(name, 6, 0), -1);
+}
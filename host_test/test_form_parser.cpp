@@ -0,0 +1,51 @@
+#include "wm_test.h"
+#include "wm_replay.h"
+#include "wm_form_parser.h"
+#include <string>
+
+struct Fields {
+    std::string dump;   // key=value|... with a trailing ! on truncated values
+};
+
+static void collect(void* ctx, const char* key, size_t keyLen, const char* value, size_t valueLen,
+                    bool truncated) {
+    std::string& dump = static_cast<Fields*>(ctx)->dump;
+    dump.append(key, keyLen).append("=").append(value, valueLen);
+    dump.append(truncated ? "!|" : "|");
+}
+
+static std::string parse(const std::string& body, size_t chunk) {
+    Fields fields;
+    WMFormParser parser(collect, &fields);
+    for (size_t i = 0; i < body.size(); i += chunk) {
+        parser.feed(body.data() + i, std::min(chunk, body.size() - i));
+    }
+    parser.finish();
+    return fields.dump;
+}
+
+WM_TEST(form_parser_decodes_fields) {
+    WM_CHECK(parse("s=Caf%C3%A9+Z%C3%BCrich&p=p%40ss%26word%3D1%25", 128) ==
+             "s=Caf\xC3\xA9 Z\xC3\xBCrich|p=p@ss&word=1%|");
+    // Malformed escapes are kept literally, empty keys and over-long keys are skipped
+    WM_CHECK(parse("p=50%+off%zz%4&=orphan&&flag", 128) == "p=50% off%zz%4|flag=|");
+    WM_CHECK(parse(std::string(WM_FORM_KEY_MAX + 1, 'k') + "=1&a=b", 128) == "a=b|");
+    
+    std::string expected = std::string(WM_FORM_VALUE_MAX, 'v');
+    WM_CHECK(parse("v=" + expected + "vv", 128) == "v=" + expected + "!|");
+}
+
+WM_TEST(form_parser_is_independent_of_chunking) {
+    std::vector<std::string> bodies;
+    WM_CHECK(wmLoadFormBodies("form_bodies.txt", bodies));
+    WM_CHECK(!bodies.empty());
+    
+    // Escapes split across recv() calls decode the same as in one piece
+    for (const std::string& body : bodies) {
+        std::string whole = parse(body, body.size());
+        WM_CHECK(!whole.empty());
+        for (size_t chunk : {1, 2, 3, 7, WM_FORM_RECV_CHUNK}) {
+            WM_CHECK(parse(body, chunk) == whole);
+        }
+    }
+}
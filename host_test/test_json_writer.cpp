@@ -0,0 +1,76 @@
+#include "wm_test.h"
+#include "wm_json_writer.h"
+#include <string>
+
+struct Capture {
+    std::string out;
+    int chunks = 0;
+    bool finished = false;
+};
+
+static esp_err_t captureSink(void* ctx, const char* data, size_t len) {
+    Capture* c = static_cast<Capture*>(ctx);
+    if (!data) {
+        c->finished = true;
+        return ESP_OK;
+    }
+    c->out.append(data, len);
+    c->chunks++;
+    return ESP_OK;
+}
+
+static esp_err_t failingSink(void* ctx, const char* data, size_t len) {
+    (*static_cast<int*>(ctx))++;
+    return ESP_FAIL;
+}
+
+WM_TEST(json_writer_nests_and_escapes) {
+    Capture c;
+    WMJsonWriter json(captureSink, &c);
+    json.beginObject();
+    json.field("s", "a\"b\\c\n\t\x01");
+    json.field("n", -42);
+    json.field("l", 4000000000L);
+    json.field("b", true);
+    json.beginArray("a");
+    json.value(0);
+    json.value("x");
+    json.value(false);
+    json.beginArray();
+    json.endArray();
+    json.beginObject();
+    json.endObject();
+    json.endArray();
+    json.endObject();
+    WM_CHECK_EQ(json.finish(), ESP_OK);
+    
+    WM_CHECK(c.finished);
+    WM_CHECK(c.out == "{\"s\":\"a\\\"b\\\\c\\n\\t\\u0001\",\"n\":-42,\"l\":4000000000,\"b\":true,"
+                      "\"a\":[0,\"x\",false,[],{}]}");
+}
+
+WM_TEST(json_writer_flushes_in_chunks) {
+    Capture c;
+    WMJsonWriter json(captureSink, &c);
+    json.beginArray();
+    for (int i = 0; i < 200; i++) {
+        json.value("0123456789");
+    }
+    json.endArray();
+    WM_CHECK_EQ(json.finish(), ESP_OK);
+    
+    WM_CHECK_EQ(c.out.size(), 2u + 200 * 13 - 1);
+    WM_CHECK_EQ(c.chunks, static_cast<int>((c.out.size() + WM_JSON_CHUNK_SIZE - 1) / WM_JSON_CHUNK_SIZE));
+}
+
+WM_TEST(json_writer_stops_after_a_send_error) {
+    int calls = 0;
+    WMJsonWriter json(failingSink, &calls);
+    json.beginArray();
+    for (int i = 0; i < 200; i++) {
+        json.value(i);
+    }
+    json.endArray();
+    WM_CHECK_EQ(json.finish(), ESP_FAIL);
+    WM_CHECK_EQ(calls, 1);
+}
@@ -0,0 +1,55 @@
+#include "wm_test.h"
+#include "wm_param_html.h"
+#include <string>
+
+static esp_err_t appendSink(void* ctx, const char* data, size_t len) {
+    if (data) {
+        static_cast<std::string*>(ctx)->append(data, len);
+    }
+    return ESP_OK;
+}
+
+static void resolveParam(void* ctx, std::string_view name, WMTemplate& out) {
+    wmWriteParameter(out, *static_cast<const WiFiManagerParameter*>(ctx));
+}
+
+// Rendered the way the /wifi page does it, through a {{params}} placeholder
+static std::string render(const WiFiManagerParameter& param) {
+    static const char PAGE[] = "{{params}}";
+    std::string out;
+    WMTemplate page(appendSink, &out);
+    WM_CHECK_EQ(page.render(reinterpret_cast<const uint8_t*>(PAGE),
+                            reinterpret_cast<const uint8_t*>(PAGE) + sizeof(PAGE) - 1,
+                            resolveParam, const_cast<WiFiManagerParameter*>(&param)), ESP_OK);
+    return out;
+}
+
+WM_TEST(param_html_empty_default_keeps_the_length) {
+    WiFiManagerParameter server("server", "MQTT server", "", 40);
+    WM_CHECK(render(server) ==
+        "<div class=\"form-group\"><label for=\"server\">MQTT server</label>"
+        "<input id=\"server\" name=\"server\" maxlength=\"40\" placeholder=\"MQTT server\" "
+        " type=\"text\" value=\"\"></div>");
+}
+
+WM_TEST(param_html_maxlength_is_not_the_value_length) {
+    WiFiManagerParameter port("port", "Port", "1883", 6, "inputmode=\"numeric\"", WMP_TYPE_NUMBER);
+    std::string out = render(port);
+    WM_CHECK(out.find(" maxlength=\"6\" ") != std::string::npos);
+    WM_CHECK(out.find(" type=\"number\" value=\"1883\">") != std::string::npos);
+    
+    // A value set later doesn't change the limit either
+    port.setValue("1");
+    WM_CHECK(render(port).find(" maxlength=\"6\" ") != std::string::npos);
+}
+
+WM_TEST(param_html_escapes_and_passes_custom_html) {
+    WiFiManagerParameter note("note", "Note <1>", "a\"b&c", 32, nullptr, WMP_TYPE_TEXTAREA);
+    WM_CHECK(render(note) ==
+        "<div class=\"form-group\"><label for=\"note\">Note &lt;1&gt;</label>"
+        "<textarea id=\"note\" name=\"note\" maxlength=\"32\" placeholder=\"Note &lt;1&gt;\" "
+        ">a&quot;b&amp;c</textarea></div>");
+    
+    WiFiManagerParameter html("<p>Raw</p>");
+    WM_CHECK(render(html) == "<p>Raw</p>");
+}
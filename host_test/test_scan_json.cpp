@@ -0,0 +1,68 @@
+#include "wm_test.h"
+#include "wm_replay.h"
+#include "wm_scan_json.h"
+#include <string>
+
+static esp_err_t appendSink(void* ctx, const char* data, size_t len) {
+    if (data) {
+        static_cast<std::string*>(ctx)->append(data, len);
+    }
+    return ESP_OK;
+}
+
+static std::string writeList(const WMScanTable& table, bool lean) {
+    WMScanRow rows[WMScanTable::CAPACITY];
+    size_t count = table.copyRows(rows);
+    std::string out;
+    WMJsonWriter json(appendSink, &out);
+    wmWriteScanList(json, rows, count, lean);
+    WM_CHECK_EQ(json.finish(), ESP_OK);
+    return out;
+}
+
+static void fillGolden(WMScanTable& table) {
+    table.add(wmRecord("Office", -48, 1, 6, WIFI_AUTH_WPA2_WPA3_PSK));
+    table.add(wmRecord("Cafe \"Corner\"", -67, 2, 1, WIFI_AUTH_OPEN));
+    table.add(wmRecord("Lab\\Test\t1", -71, 3, 11, WIFI_AUTH_WPA_PSK));
+    table.add(wmRecord("Caf\xC3\xA9", -80, 4, 13, WIFI_AUTH_WEP));
+    table.add(wmRecord("ctl\x01", -90, 5, 3, WIFI_AUTH_ENTERPRISE));
+    table.add(wmRecord("Home", -100, 6, 6, WIFI_AUTH_WPA2_PSK));
+    table.add(wmRecord("x", -20, 7, 9, WIFI_AUTH_WPA_WPA2_PSK));
+    table.add(wmRecord("W3", -55, 8, 5, WIFI_AUTH_WPA3_PSK));
+}
+
+// The schema /scan had when it was built with cJSON, printed unformatted: key
+// order, cJSON's escapes, hidden always false, quality clamped to 0-100 and
+// open networks reported as "Unknown" security
+WM_TEST(scan_json_matches_the_cjson_schema) {
+    WMScanTable table;
+    fillGolden(table);
+    
+    WM_CHECK(writeList(table, false) ==
+        "["
+        "{\"ssid\":\"x\",\"rssi\":-20,\"channel\":9,\"encryption\":4,\"hidden\":false,\"quality\":100,\"security\":\"WPA/WPA2\"},"
+        "{\"ssid\":\"Office\",\"rssi\":-48,\"channel\":6,\"encryption\":7,\"hidden\":false,\"quality\":100,\"security\":\"WPA2/WPA3\"},"
+        "{\"ssid\":\"W3\",\"rssi\":-55,\"channel\":5,\"encryption\":6,\"hidden\":false,\"quality\":90,\"security\":\"WPA3\"},"
+        "{\"ssid\":\"Cafe \\\"Corner\\\"\",\"rssi\":-67,\"channel\":1,\"encryption\":0,\"hidden\":false,\"quality\":66,\"security\":\"Unknown\"},"
+        "{\"ssid\":\"Lab\\\\Test\\t1\",\"rssi\":-71,\"channel\":11,\"encryption\":2,\"hidden\":false,\"quality\":58,\"security\":\"WPA\"},"
+        "{\"ssid\":\"Caf\xC3\xA9\",\"rssi\":-80,\"channel\":13,\"encryption\":1,\"hidden\":false,\"quality\":40,\"security\":\"WEP\"},"
+        "{\"ssid\":\"ctl\\u0001\",\"rssi\":-90,\"channel\":3,\"encryption\":5,\"hidden\":false,\"quality\":20,\"security\":\"Unknown\"},"
+        "{\"ssid\":\"Home\",\"rssi\":-100,\"channel\":6,\"encryption\":3,\"hidden\":false,\"quality\":0,\"security\":\"WPA2\"}"
+        "]");
+}
+
+WM_TEST(scan_json_lean_keeps_the_page_fields) {
+    WMScanTable table;
+    fillGolden(table);
+    
+    std::string out = writeList(table, true);
+    WM_CHECK_EQ(out.find("{\"ssid\":\"x\",\"rssi\":-20,\"channel\":9,\"encryption\":4},"), 1u);
+    WM_CHECK(out.find("hidden") == std::string::npos);
+    WM_CHECK(out.find("quality") == std::string::npos);
+    WM_CHECK(out.find("security") == std::string::npos);
+}
+
+WM_TEST(scan_json_empty_list) {
+    WMScanTable table;
+    WM_CHECK(writeList(table, false) == "[]");
+}
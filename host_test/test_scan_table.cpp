@@ -0,0 +1,370 @@
+#include "wm_test.h"
+#include "wm_replay.h"
+#include "wm_scan_table.h"
+
+static void fill(WMScanTable& table, const std::vector<wifi_ap_record_t>& records) {
+    for (const wifi_ap_record_t& ap : records) {
+        table.add(ap);
+    }
+}
+
+WM_TEST(scan_table_orders_by_rssi_and_dedups) {
+    std::vector<wifi_ap_record_t> records;
+    WM_CHECK(wmLoadScanList("scan_office.txt", records));
+    
+    WMScanTable table;
+    fill(table, records);
+    
+    // Three Office BSSIDs and two guest ones collapse, the hidden one is dropped
+    WM_CHECK_EQ(table.size(), 8u);
+    WM_CHECK_STR((const char*)table[0].ssid, "Office");
+    WM_CHECK_EQ(table[0].rssi, -48);
+    WM_CHECK_STR((const char*)table[1].ssid, "Office-Guest");
+    for (size_t i = 1; i < table.size(); i++) {
+        WM_CHECK(table[i - 1].rssi >= table[i].rssi);
+    }
+    WM_CHECK(table.find("Office") == &table[0]);
+    WM_CHECK(table.find("Lab\\Test") != nullptr);
+    WM_CHECK(table.find("Office-5G") == nullptr);
+    WM_CHECK(table.find("") == nullptr);
+}
+
+WM_TEST(scan_table_keeps_duplicates_when_asked) {
+    std::vector<wifi_ap_record_t> records;
+    WM_CHECK(wmLoadScanList("scan_office.txt", records));
+    
+    WMScanTable table;
+    table.reset(0, false);
+    fill(table, records);
+    WM_CHECK_EQ(table.size(), records.size() - 1);
+    WM_CHECK_EQ(table.find("Office")->rssi, -48);
+}
+
+WM_TEST(scan_table_filters_by_quality) {
+    std::vector<wifi_ap_record_t> records;
+    WM_CHECK(wmLoadScanList("scan_office.txt", records));
+    
+    // 40% is -80 dBm
+    WMScanTable table;
+    table.reset(40, true);
+    fill(table, records);
+    WM_CHECK_EQ(table.size(), 6u);
+    WM_CHECK(table.find("Cafe \"Corner\"") == nullptr);
+    WM_CHECK(table[table.size() - 1].rssi >= -80);
+}
+
+WM_TEST(scan_table_keeps_the_strongest_when_full) {
+    std::vector<wifi_ap_record_t> records;
+    WM_CHECK(wmLoadScanList("scan_apartment.txt", records));
+    
+    WMScanTable table;
+    fill(table, records);
+    WM_CHECK_EQ(table.size(), WMScanTable::CAPACITY);
+    
+    // Whatever didn't make it is no stronger than the weakest entry kept
+    int8_t weakest = table[table.size() - 1].rssi;
+    for (const wifi_ap_record_t& ap : records) {
+        const wifi_ap_record_t* kept = table.find((const char*)ap.ssid);
+        if (ap.ssid[0] && !kept) {
+            WM_CHECK(ap.rssi <= weakest);
+        }
+        if (kept) {
+            WM_CHECK(kept->rssi >= ap.rssi);
+        }
+    }
+}
+
+WM_TEST(scan_table_stamps_new_and_moved_entries) {
+    WMScanTable previous;
+    previous.add(wmRecord("Alpha", -50, 1));
+    previous.add(wmRecord("Beta", -60, 2));
+    previous.stamp(WMScanTable(), 5, WM_SCAN_RSSI_STEP);
+    
+    WMScanTable next;
+    next.add(wmRecord("Alpha", -51, 1));   // Jitter, keeps its stamps
+    next.add(wmRecord("Beta", -70, 2));    // Moved
+    next.add(wmRecord("Gamma", -65, 3));   // New
+    next.stamp(previous, 6, WM_SCAN_RSSI_STEP);
+    
+    WM_CHECK_STR((const char*)next[0].ssid, "Alpha");
+    WM_CHECK_EQ(next.addedAt(0), 5u);
+    WM_CHECK_EQ(next.changedAt(0), 5u);
+    WM_CHECK_STR((const char*)next[2].ssid, "Beta");
+    WM_CHECK_EQ(next.addedAt(2), 5u);
+    WM_CHECK_EQ(next.changedAt(2), 6u);
+    WM_CHECK_STR((const char*)next[1].ssid, "Gamma");
+    WM_CHECK_EQ(next.addedAt(1), 6u);
+    WM_CHECK_EQ(next.changedAt(1), 6u);
+}
+
+WM_TEST(scan_table_replays_through_the_driver_api) {
+    std::vector<wifi_ap_record_t> records;
+    WM_CHECK(wmLoadScanList("scan_apartment.txt", records));
+    wm_mock_wifi_set_scan(records.data(), records.size());
+    
+    // Same pull loop as WiFiManager::collectScanRecords() on IDF 5.1+
+    uint16_t count = 0;
+    esp_wifi_scan_get_ap_num(&count);
+    WM_CHECK_EQ(count, records.size());
+    WMScanTable table;
+    wifi_ap_record_t ap;
+    while (esp_wifi_scan_get_ap_record(&ap) == ESP_OK) {
+        table.add(ap);
+    }
+    
+    WMScanTable direct;
+    fill(direct, records);
+    WM_CHECK_EQ(table.size(), direct.size());
+    for (size_t i = 0; i < table.size(); i++) {
+        WM_CHECK(memcmp(table[i].bssid, direct[i].bssid, 6) == 0);
+    }
+}
+
+WM_TEST(scan_table_refresh_keeps_unscanned_networks) {
+    WMScanTable front;
+    front.add(wmRecord("Ch1", -50, 1, 1));
+    front.add(wmRecord("Ch6", -60, 2, 6));
+    front.add(wmRecord("Ch11", -70, 3, 11));
+    front.add(wmRecord("Gone", -55, 4, 11));
+    front.stamp(WMScanTable(), 10, WM_SCAN_RSSI_STEP);
+    
+    // First slice covers channel 1 only: it moves, everything else stays
+    WMScanTable back = front;
+    back.refresh(0, true);
+    back.add(wmRecord("Ch1", -75, 1, 1));
+    back.stamp(front, 11, WM_SCAN_RSSI_STEP);
+    WM_CHECK_EQ(back.size(), 4u);
+    WM_CHECK_STR((const char*)back[3].ssid, "Ch1");
+    WM_CHECK_EQ(back.addedAt(3), 10u);
+    WM_CHECK_EQ(back.changedAt(3), 11u);
+    WM_CHECK_EQ(back.changedAt(0), 10u);
+    
+    // The rest of the channels, then the sweep drops what nobody reported
+    back.add(wmRecord("Ch6", -61, 2, 6));
+    back.add(wmRecord("Ch11", -40, 3, 11));
+    back.sweep();
+    WM_CHECK_EQ(back.size(), 3u);
+    WM_CHECK(back.find("Gone") == nullptr);
+    WM_CHECK(!back.contains(wmRecord("Gone", -55, 4).bssid));
+    WM_CHECK_STR((const char*)back[0].ssid, "Ch11");
+    WM_CHECK_STR((const char*)back[1].ssid, "Ch6");
+    WM_CHECK_STR((const char*)back[2].ssid, "Ch1");
+    
+    // Swept tables keep working: lookups, dedup and the index
+    back.add(wmRecord("Ch6", -30, 5, 6));
+    WM_CHECK_EQ(back.size(), 3u);
+    WM_CHECK_EQ(back.find("Ch6")->rssi, -30);
+    WM_CHECK_STR((const char*)back[0].ssid, "Ch6");
+}
+
+WM_TEST(scan_table_refresh_takes_fresh_readings) {
+    WMScanTable table;
+    table.add(wmRecord("Mesh", -45, 1));
+    table.add(wmRecord("Other", -60, 3));
+    
+    // Its own BSSID updates a stale entry either way, another one has to be stronger
+    table.refresh(0, true);
+    table.add(wmRecord("Mesh", -80, 1));
+    WM_CHECK_EQ(table.find("Mesh")->rssi, -80);
+    WM_CHECK_STR((const char*)table[0].ssid, "Other");
+    table.add(wmRecord("Mesh", -70, 2));
+    WM_CHECK_EQ(table.find("Mesh")->bssid[5], 2);
+    WM_CHECK_STR((const char*)table[0].ssid, "Other");
+    
+    // Without dedup a BSSID is updated in place rather than listed twice
+    WMScanTable all;
+    all.reset(0, false);
+    all.add(wmRecord("Mesh", -45, 1));
+    all.refresh(0, false);
+    all.add(wmRecord("Mesh", -70, 1));
+    WM_CHECK_EQ(all.size(), 1u);
+    WM_CHECK_EQ(all[0].rssi, -70);
+}
+
+WM_TEST(scan_table_refresh_moves_quiet_ssids_to_another_bssid) {
+    WMScanTable table;
+    table.add(wmRecord("Mesh", -45, 1, 1));
+    table.add(wmRecord("Other", -60, 3, 6));
+    
+    // A weaker node of the SSID doesn't replace the listed one mid-scan...
+    table.refresh(0, true);
+    table.add(wmRecord("Mesh", -75, 2, 11));
+    table.add(wmRecord("Mesh", -70, 4, 6));
+    table.add(wmRecord("Other", -60, 3, 6));
+    WM_CHECK_EQ(table.find("Mesh")->bssid[5], 1);
+    WM_CHECK_STR((const char*)table[0].ssid, "Mesh");
+    
+    // ...but takes over, strongest first, when the listed one wasn't heard at all
+    table.sweep();
+    WM_CHECK_EQ(table.size(), 2u);
+    const wifi_ap_record_t* mesh = table.find("Mesh");
+    WM_CHECK_EQ(mesh->bssid[5], 4);
+    WM_CHECK_EQ(mesh->rssi, -70);
+    WM_CHECK_EQ(mesh->primary, 6);
+    WM_CHECK_STR((const char*)table[0].ssid, "Other");
+    WM_CHECK(table.contains(wmRecord("", 0, 4).bssid));
+    WM_CHECK(!table.contains(wmRecord("", 0, 1).bssid));
+}
+
+WM_TEST(scan_table_refresh_holds_places_against_weaker_newcomers) {
+    std::vector<wifi_ap_record_t> records;
+    WM_CHECK(wmLoadScanList("scan_apartment.txt", records));
+    
+    WMScanTable table;
+    fill(table, records);
+    WM_CHECK_EQ(table.size(), WMScanTable::CAPACITY);
+    int8_t weakest = table[WMScanTable::CAPACITY - 1].rssi;
+    
+    // Stale entries compete at their last reading until the sweep
+    table.refresh(0, true);
+    table.add(wmRecord("Newcomer", weakest - 5, 0xEE));
+    WM_CHECK(table.find("Newcomer") == nullptr);
+    table.add(wmRecord("Strong", -30, 0xEF));
+    WM_CHECK_STR((const char*)table[0].ssid, "Strong");
+    WM_CHECK_EQ(table.size(), WMScanTable::CAPACITY);
+    table.sweep();
+    WM_CHECK_EQ(table.size(), 1u);
+}
+
+// Front/back pair published the way WiFiManager::flipScanTables() does it
+struct Published {
+    WMScanTable tables[2];
+    uint8_t front = 0;
+    WMScanHistory history{1000};
+    
+    WMScanTable& back() { return tables[front ^ 1]; }
+    
+    void startRefresh() {
+        back() = tables[front];
+        back().refresh(0, true);
+    }
+    
+    void flip(bool complete) {
+        back().stamp(tables[front], history.generation() + 1, WM_SCAN_RSSI_STEP);
+        history.publish(back(), complete);
+        front ^= 1;
+        if (!complete) {
+            back() = tables[front];
+        }
+    }
+    
+    // Rows and removals a client at since is sent
+    size_t delta(uint32_t since, WMScanHistory::Delta& out, WMScanRow* rows) {
+        history.delta(since, out);
+        return tables[front].copyRows(rows, out.full ? 0 : since);
+    }
+};
+
+// A sliced refresh of the apartment scan: two channels per slice with a flip after each
+static void slicedRefresh(Published& p, const std::vector<wifi_ap_record_t>& records, int jitter) {
+    p.startRefresh();
+    for (int channel = 1; channel <= 13; channel++) {
+        for (wifi_ap_record_t ap : records) {
+            if (ap.primary == channel) {
+                ap.rssi += (channel % 2) ? jitter : -jitter;
+                p.back().add(ap);
+            }
+        }
+        if (channel == 13) {
+            p.back().sweep();
+            p.flip(true);
+        } else if (channel % 2 == 0) {
+            p.flip(false);
+        }
+    }
+}
+
+WM_TEST(scan_history_steady_refresh_is_an_empty_delta) {
+    std::vector<wifi_ap_record_t> records;
+    WM_CHECK(wmLoadScanList("scan_apartment.txt", records));
+    
+    Published p;
+    slicedRefresh(p, records, 0);
+    uint32_t since = p.history.generation();
+    
+    // The same networks again, RSSIs within the reporting step
+    for (int round = 0; round < 4; round++) {
+        slicedRefresh(p, records, round % 2 ? 1 : -1);
+    }
+    WMScanHistory::Delta delta;
+    WMScanRow rows[WMScanTable::CAPACITY];
+    size_t count = p.delta(since, delta, rows);
+    WM_CHECK(!delta.full);
+    WM_CHECK_EQ(delta.generation, since + 4 * 7);
+    WM_CHECK_EQ(delta.removedCount, 0);
+    WM_CHECK_EQ(count, 0u);
+}
+
+WM_TEST(scan_history_removes_only_when_complete) {
+    Published p;
+    p.back().add(wmRecord("Stays", -50, 1, 1));
+    p.back().add(wmRecord("Leaves", -60, 2, 11));
+    p.flip(true);
+    uint32_t since = p.history.generation();
+    
+    p.startRefresh();
+    p.back().add(wmRecord("Stays", -50, 1, 1));
+    p.flip(false);
+    WMScanHistory::Delta delta;
+    WMScanRow rows[WMScanTable::CAPACITY];
+    WM_CHECK_EQ(p.delta(since, delta, rows), 0u);
+    WM_CHECK_EQ(delta.removedCount, 0);
+    WM_CHECK_EQ(p.tables[p.front].size(), 2u);
+    
+    p.back().sweep();
+    p.flip(true);
+    p.delta(since, delta, rows);
+    WM_CHECK(!delta.full);
+    WM_CHECK_EQ(delta.removedCount, 1);
+    WM_CHECK_EQ(delta.removed[0][5], 2);
+}
+
+WM_TEST(scan_history_reports_bssids_dropped_mid_scan) {
+    // A mesh SSID moving to another BSSID during a partial slice still gets its old BSSID
+    // removed, even though the flip that dropped it wasn't complete
+    Published p;
+    p.back().add(wmRecord("Mesh", -45, 1, 1));
+    p.flip(true);
+    uint32_t since = p.history.generation();
+    
+    p.startRefresh();
+    p.back().add(wmRecord("Mesh", -70, 2, 6));
+    p.flip(false);
+    p.back().sweep();
+    p.flip(true);
+    
+    WMScanHistory::Delta delta;
+    WMScanRow rows[WMScanTable::CAPACITY];
+    size_t count = p.delta(since, delta, rows);
+    WM_CHECK_EQ(count, 1u);
+    WM_CHECK_EQ(rows[0].bssid[5], 2);
+    WM_CHECK_EQ(delta.removedCount, 1);
+    WM_CHECK_EQ(delta.removed[0][5], 1);
+}
+
+WM_TEST(scan_history_unknown_generations_get_everything) {
+    Published p;
+    p.back().add(wmRecord("A", -50, 1));
+    p.flip(true);
+    
+    WMScanHistory::Delta delta;
+    p.history.delta(0, delta);
+    WM_CHECK(delta.full);
+    p.history.delta(p.history.generation() + 1, delta);
+    WM_CHECK(delta.full);
+    p.history.delta(999, delta);
+    WM_CHECK(delta.full);
+    
+    // Overflowing the removal ring makes the oldest generations unusable
+    uint32_t since = p.history.generation();
+    for (int i = 0; i <= WM_SCAN_REMOVALS; i++) {
+        p.back().reset();
+        p.back().add(wmRecord("A", -50, static_cast<uint8_t>(i + 2)));
+        p.flip(true);
+    }
+    p.history.delta(since, delta);
+    WM_CHECK(delta.full);
+    p.history.delta(p.history.generation() - 1, delta);
+    WM_CHECK(!delta.full);
+    WM_CHECK_EQ(delta.removedCount, 1);
+}
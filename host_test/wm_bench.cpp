@@ -0,0 +1,170 @@
+#include "wm_replay.h"
+#include "wm_dns.h"
+#include "wm_form_parser.h"
+#include "wm_json_writer.h"
+#include "wm_scan_json.h"
+#include "wm_scan_table.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Replays the inputs in data/ through the hot paths and reports ns/op and
+// allocs/op. Allocations are counted at global operator new; the modules
+// themselves never call malloc.
+
+static size_t s_allocs;
+
+void* operator new(size_t size) {
+    s_allocs++;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+static long s_iterations = 20000;
+static volatile size_t s_sink;  // Keeps results observable so nothing is optimized out
+
+template <typename Fn>
+static void bench(const char* name, Fn fn) {
+    fn();  // Warm up, and let one-time setup allocate outside the count
+    
+    size_t allocs = s_allocs;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < s_iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    allocs = s_allocs - allocs;
+    
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / s_iterations;
+    printf("%-32s %10ld %10.1f ns/op %8.2f allocs/op\n", name, s_iterations, ns,
+           static_cast<double>(allocs) / s_iterations);
+}
+
+static void benchScan(const char* name, const char* file) {
+    std::vector<wifi_ap_record_t> records;
+    if (!wmLoadScanList(file, records)) {
+        exit(1);
+    }
+    wm_mock_wifi_set_scan(records.data(), records.size());
+    
+    // Driver pull as in WiFiManager::collectScanRecords()
+    WMScanTable table;
+    bench(name, [&] {
+        wm_mock_wifi_rewind();
+        table.reset();
+        wifi_ap_record_t ap;
+        while (esp_wifi_scan_get_ap_record(&ap) == ESP_OK) {
+            table.add(ap);
+        }
+        s_sink = table.size();
+    });
+}
+
+static esp_err_t discardSink(void* ctx, const char* data, size_t len) {
+    s_sink += len;
+    return ESP_OK;
+}
+
+static void benchScanJson(const char* name, const char* file) {
+    std::vector<wifi_ap_record_t> records;
+    if (!wmLoadScanList(file, records)) {
+        exit(1);
+    }
+    WMScanTable table;
+    for (const wifi_ap_record_t& ap : records) {
+        table.add(ap);
+    }
+    
+    // The /scan handler's work once it has the lock: copy the rows, then stream them
+    bench(name, [&] {
+        WMScanRow rows[WMScanTable::CAPACITY];
+        size_t count = table.copyRows(rows);
+        WMJsonWriter json(discardSink, nullptr);
+        wmWriteScanList(json, rows, count, false);
+        json.finish();
+    });
+}
+
+static void benchDns(const char* name, const char* file) {
+    std::vector<WMDnsCapture> captures;
+    if (!wmLoadDnsCaptures(file, captures)) {
+        exit(1);
+    }
+    
+    // op = one pass over every capture, copied in as recvfrom() would
+    WMDnsResponder dns(0x0104a8c0);
+    uint8_t packet[WMDnsResponder::MAX_PACKET_SIZE];
+    bench(name, [&] {
+        for (const WMDnsCapture& capture : captures) {
+            memcpy(packet, capture.packet.data(), capture.packet.size());
+            s_sink += dns.respond(packet, static_cast<int>(capture.packet.size()));
+        }
+    });
+}
+
+static void countField(void* ctx, const char* key, size_t keyLen, const char* value, size_t valueLen,
+                       bool truncated) {
+    s_sink += keyLen + valueLen;
+}
+
+static void benchForm(const char* name, const char* file) {
+    std::vector<std::string> bodies;
+    if (!wmLoadFormBodies(file, bodies)) {
+        exit(1);
+    }
+    
+    // op = every body, fed in WM_FORM_RECV_CHUNK pieces as httpd_req_recv() delivers them
+    bench(name, [&] {
+        for (const std::string& body : bodies) {
+            WMFormParser parser(countField, nullptr);
+            for (size_t i = 0; i < body.size(); i += WM_FORM_RECV_CHUNK) {
+                size_t n = body.size() - i;
+                parser.feed(body.data() + i, n < WM_FORM_RECV_CHUNK ? n : WM_FORM_RECV_CHUNK);
+            }
+            parser.finish();
+        }
+    });
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0) {
+            s_iterations = atol(argv[i + 1]);
+        }
+    }
+    if (s_iterations <= 0) {
+        s_iterations = 1;
+    }
+    
+    benchScan("scan_table/office", "scan_office.txt");
+    benchScan("scan_table/apartment", "scan_apartment.txt");
+    benchScanJson("scan_json/office", "scan_office.txt");
+    benchScanJson("scan_json/apartment", "scan_apartment.txt");
+    benchDns("dns/captures", "dns_queries.txt");
+    benchForm("form_parser/wifisave", "form_bodies.txt");
+    return 0;
+}
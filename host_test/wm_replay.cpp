@@ -0,0 +1,97 @@
+#include "wm_replay.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static const char* const AUTH_NAMES[] = {
+    "OPEN", "WEP", "WPA", "WPA2", "WPA/WPA2", "ENTERPRISE", "WPA3", "WPA2/WPA3",
+};
+
+static bool readLines(const char* name, std::vector<std::string>& lines) {
+    std::string path = std::string(WM_HOST_DATA_DIR) + "/" + name;
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", path.c_str());
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line[0] != '#') {
+            lines.push_back(line);
+        }
+    }
+    return true;
+}
+
+bool wmLoadScanList(const char* name, std::vector<wifi_ap_record_t>& out) {
+    std::vector<std::string> lines;
+    if (!readLines(name, lines)) {
+        return false;
+    }
+    
+    for (const std::string& line : lines) {
+        unsigned mac[6];
+        int channel, rssi, consumed = 0;
+        char auth[16];
+        if (sscanf(line.c_str(), "%x:%x:%x:%x:%x:%x %d %d %15s %n", &mac[0], &mac[1], &mac[2],
+                   &mac[3], &mac[4], &mac[5], &channel, &rssi, auth, &consumed) < 9) {
+            fprintf(stderr, "%s: bad record: %s\n", name, line.c_str());
+            return false;
+        }
+        
+        wifi_ap_record_t ap = {};
+        for (int i = 0; i < 6; i++) {
+            ap.bssid[i] = static_cast<uint8_t>(mac[i]);
+        }
+        // %n skipped the separator, whatever follows is the SSID
+        strncpy(reinterpret_cast<char*>(ap.ssid), line.c_str() + consumed, sizeof(ap.ssid) - 1);
+        ap.primary = static_cast<uint8_t>(channel);
+        ap.rssi = static_cast<int8_t>(rssi);
+        ap.authmode = WIFI_AUTH_MAX;
+        for (size_t i = 0; i < sizeof(AUTH_NAMES) / sizeof(AUTH_NAMES[0]); i++) {
+            if (strcmp(auth, AUTH_NAMES[i]) == 0) {
+                ap.authmode = static_cast<wifi_auth_mode_t>(i);
+            }
+        }
+        out.push_back(ap);
+    }
+    return true;
+}
+
+bool wmLoadDnsCaptures(const char* name, std::vector<WMDnsCapture>& out) {
+    std::vector<std::string> lines;
+    if (!readLines(name, lines)) {
+        return false;
+    }
+    
+    for (const std::string& line : lines) {
+        size_t space = line.find(' ');
+        if (space == std::string::npos || (line.size() - space - 1) % 2) {
+            fprintf(stderr, "%s: bad capture: %s\n", name, line.c_str());
+            return false;
+        }
+        WMDnsCapture capture;
+        capture.expect = line.substr(0, space);
+        for (size_t i = space + 1; i + 1 < line.size(); i += 2) {
+            capture.packet.push_back(static_cast<uint8_t>(std::stoul(line.substr(i, 2), nullptr, 16)));
+        }
+        out.push_back(capture);
+    }
+    return true;
+}
+
+bool wmLoadFormBodies(const char* name, std::vector<std::string>& out) {
+    return readLines(name, out);
+}
+
+wifi_ap_record_t wmRecord(const char* ssid, int8_t rssi, uint8_t bssidTail,
+                          uint8_t channel, wifi_auth_mode_t auth) {
+    wifi_ap_record_t ap = {};
+    const uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x10, 0x00, bssidTail};
+    memcpy(ap.bssid, bssid, sizeof(bssid));
+    strncpy(reinterpret_cast<char*>(ap.ssid), ssid, sizeof(ap.ssid) - 1);
+    ap.rssi = rssi;
+    ap.primary = channel;
+    ap.authmode = auth;
+    return ap;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esp_wifi.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Loaders for the replay inputs in data/, see the header of each file for its format
+
+struct WMDnsCapture {
+    std::string expect;         // A, EMPTY, NOTIMP, FORMERR or DROP
+    std::vector<uint8_t> packet;
+};
+
+// name is relative to data/; false (with a message on stderr) if it can't be read
+bool wmLoadScanList(const char* name, std::vector<wifi_ap_record_t>& out);
+bool wmLoadDnsCaptures(const char* name, std::vector<WMDnsCapture>& out);
+bool wmLoadFormBodies(const char* name, std::vector<std::string>& out);
+
+// A record as the driver reports it
+wifi_ap_record_t wmRecord(const char* ssid, int8_t rssi, uint8_t bssidTail,
+                          uint8_t channel = 6, wifi_auth_mode_t auth = WIFI_AUTH_WPA2_PSK);
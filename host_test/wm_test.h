@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+// Minimal self-registering test cases, run in declaration order by wm_test_main.cpp
+
+struct WMTestCase {
+    const char* name;
+    void (*fn)();
+    WMTestCase* next;
+};
+
+void wmTestRegister(WMTestCase* test);
+void wmTestFail(const char* file, int line, const char* expr);
+
+struct WMTestRegistrar {
+    WMTestCase test;
+    WMTestRegistrar(const char* name, void (*fn)()) : test{name, fn, nullptr} {
+        wmTestRegister(&test);
+    }
+};
+
+#define WM_TEST(name)                                          \
+    static void name();                                        \
+    static WMTestRegistrar name##_registrar(#name, name);      \
+    static void name()
+
+#define WM_CHECK(cond)                                         \
+    do {                                                       \
+        if (!(cond)) wmTestFail(__FILE__, __LINE__, #cond);    \
+    } while (0)
+
+#define WM_CHECK_EQ(a, b) WM_CHECK((a) == (b))
+#define WM_CHECK_STR(a, b) WM_CHECK(strcmp((a), (b)) == 0)
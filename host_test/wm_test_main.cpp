@@ -0,0 +1,40 @@
+#include "wm_test.h"
+
+static WMTestCase* s_first;
+static WMTestCase** s_last = &s_first;
+static int s_failures;
+
+void wmTestRegister(WMTestCase* test) {
+    *s_last = test;
+    s_last = &test->next;
+}
+
+void wmTestFail(const char* file, int line, const char* expr) {
+    fprintf(stderr, "  %s:%d: check failed: %s\n", file, line, expr);
+    s_failures++;
+}
+
+int main(int argc, char** argv) {
+    // An argument runs only the tests whose name contains it
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int run = 0;
+    int failed = 0;
+    
+    for (WMTestCase* t = s_first; t; t = t->next) {
+        if (filter && !strstr(t->name, filter)) {
+            continue;
+        }
+        int before = s_failures;
+        t->fn();
+        run++;
+        if (s_failures != before) {
+            failed++;
+            printf("FAIL %s\n", t->name);
+        } else {
+            printf("ok   %s\n", t->name);
+        }
+    }
+    
+    printf("%d tests, %d failed\n", run, failed);
+    return failed ? 1 : 0;
+}
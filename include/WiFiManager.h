@@ -2,26 +2,55 @@
 
 #include "wm_config.h"
 #include "WiFiManagerParameter.h"
+#include "wm_scan_table.h"
+#include "wm_metrics.h"
+#include "wm_seqlock.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "esp_event.h"
+#if WM_PROVISION_HTTP
 #include "esp_http_server.h"
+#endif
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "esp_bit_defs.h"
 #include "lwip/ip4_addr.h"
 #include <string>
 #include <string_view>
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <functional>
 
 // Forward declarations
 class WiFiManager;
+class WMTemplate;
+class WMJsonWriter;
+class WMLoadTest;
 
 // Callback types
 typedef std::function<void(WiFiManager*)> APCallback;
 typedef std::function<void()> SaveConfigCallback;
 typedef std::function<void()> ConfigModeCallback;
 typedef std::function<void()> WebServerModeCallback;
+typedef std::function<void(bool connected, uint8_t attempts)> ReconnectCallback;
+
+#if WM_PROVISION_HTTP
+/**
+ * Portal route, the form of both the built-in table and extension routes.
+ * With a null userCtx the handler gets the serving WiFiManager in
+ * req->user_ctx; httpd_get_global_user_ctx(req->handle) always has it.
+ */
+struct WMRoute {
+    const char* uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t* req);
+    void* userCtx;
+};
+#endif
 
 /**
  * WiFi network information structure
@@ -34,6 +63,27 @@ struct WiFiNetwork {
     bool isHidden;
 };
 
+/**
+ * Stored network information (passwords stay in NVS)
+ */
+struct WiFiCredential {
+    std::string ssid;
+    uint16_t successCount;  // Successful connections
+    uint32_t lastUsed;      // Store clock of the last success, higher is more recent
+};
+
+/**
+ * Connection status snapshot, consistent across fields and readable from any task
+ */
+struct WiFiManagerStatus {
+    wm_state_t state;
+    wl_status_t lastResult;
+    int8_t rssi;                // Latest sample (GOT_IP or link monitor), 0 while not connected
+    esp_ip4_addr_t ip;          // STA address, 0 while not connected
+    int64_t connectStartUs;     // esp_timer time the last connection attempt started
+    int64_t connectedUs;        // esp_timer time of the last GOT_IP, 0 if never
+};
+
 /**
  * WiFiManager class - Main entry point for WiFi configuration management
  * API-compatible with Arduino WiFiManager
@@ -62,11 +112,15 @@ public:
     
     // WiFi credential management
     bool resetSettings();
+    bool addCredential(const char* ssid, const char* password);
+    bool removeCredential(const char* ssid);
+    std::vector<WiFiCredential> listCredentials();
     
     // WiFi connection management
     bool isWiFiConnected();
     bool reconnectWiFi();
     bool reconnectWiFi(uint32_t timeoutSeconds);
+    bool reconnectWiFiAsync();  // Result goes to the reconnect callback
 
     // Timeout configuration
     void setConfigPortalTimeout(uint32_t seconds);
@@ -79,12 +133,26 @@ public:
     void setSaveConfigCallback(SaveConfigCallback callback);
     void setConfigModeCallback(ConfigModeCallback callback);
     void setWebServerModeCallback(WebServerModeCallback callback);
+    void setReconnectCallback(ReconnectCallback callback);
 
     // Scanning and filtering
     void setMinimumSignalQuality(int percent = 8);
     void setRemoveDuplicateAPs(bool remove = true);
     bool preloadWiFiScan(bool enable = true);
     void setScanDispPerc(bool showPercent = false);
+    void setScanCacheMaxAge(uint32_t seconds);
+    void setScanConfig(const wm_scan_config_t& config);
+    wm_scan_config_t getScanConfig() const;
+
+    // HTTP server tuning
+    void setHTTPServerConfig(const wm_http_config_t& config);
+    wm_http_config_t getHTTPServerConfig() const;
+#if WM_PROVISION_HTTP
+    // Routes served after the built-in ones, from a table that outlives the portal
+    void setExtraRoutes(const WMRoute* routes, size_t count);
+    template <size_t N>
+    void setExtraRoutes(const WMRoute (&routes)[N]) { setExtraRoutes(routes, N); }
+#endif
 
     // Captive portal behavior
     void setCaptivePortalEnable(bool enable = true);
@@ -104,9 +172,10 @@ public:
     void setCustomHeadElement(const char* html);
 
     // Custom parameters
-    void addParameter(WiFiManagerParameter* parameter);
-    WiFiManagerParameter* getParameters();
+    void addParameter(WiFiManagerParameter* parameter);  // Not owned, must outlive the manager's use
+    WiFiManagerParameter** getParameters();
     int getParametersCount() const;
+    bool saveParameters();  // Persist current values now, also done after every successful connect
 
     // Diagnostics and helpers
     wl_status_t getLastConxResult() const;
@@ -116,8 +185,30 @@ public:
     std::string getSSID() const;
     std::string getPassword() const;
     
+    // Fast reconnect (cached BSSID/channel, optionally IP lease)
+    void setFastReconnect(bool enable = true, bool reuseIP = false);
+    wm_connect_metrics_t getConnectMetrics() const;
+    
+    // Link monitor and roaming (requires CONFIG_WM_ENABLE_ROAMING)
+    void setRoamConfig(const wm_roam_config_t& config);
+    wm_roam_config_t getRoamConfig() const;
+    
+    // Power save, TX power and listen interval by manager state, AP channel choice
+    void setPowerConfig(const wm_power_config_t& config);
+    wm_power_config_t getPowerConfig() const;
+    
+    // Instrumentation (zeros unless CONFIG_WM_ENABLE_METRICS)
+    wm_metrics_t getMetrics() const;
+    
+    // Synthetic loopback clients against the running portal (CONFIG_WM_ENABLE_LOAD_TEST)
+    bool startLoadTest(const wm_load_test_config_t& config);
+    void stopLoadTest();
+    bool isLoadTestRunning() const;
+    
     // WiFi control
     void setWiFiAutoReconnect(bool autoReconnect = true);
+    void setReconnectConfig(const wm_reconnect_config_t& config);
+    wm_reconnect_config_t getReconnectConfig() const;
     bool disconnect(bool wifioff = false);
     bool erase();
 
@@ -127,13 +218,32 @@ public:
 
     // Status getters
     wm_state_t getState() const { return _state; }
+    WiFiManagerStatus getStatus() const;  // Lock-free, safe from event handlers and HTTP handlers
     bool isConfigPortalActive() const;
     bool isWebPortalActive() const;
+    bool isPortalLean() const;  // Started low on memory, see the heap budget in setHTTPServerConfig()
 
 private:
+    // Event group bits signalled from the event handlers and HTTP handlers
+    static constexpr EventBits_t WM_EVT_GOT_IP       = BIT0;
+    static constexpr EventBits_t WM_EVT_DISCONNECTED = BIT1;
+    static constexpr EventBits_t WM_EVT_SAVED        = BIT2;
+    static constexpr EventBits_t WM_EVT_ABORT        = BIT3;
+    static constexpr EventBits_t WM_EVT_AP_START     = BIT4;
+    static constexpr EventBits_t WM_EVT_LINK_STOPPED = BIT5;  // Link monitor task left its loop
+    
+    // scheduleReconnect() reason for an immediate, explicitly requested attempt (never a driver reason)
+    static constexpr uint8_t WM_RECONNECT_NOW = 0;
+    
+    // _roaming phases; the next GOT_IP of either phase belongs to the roam
+    static constexpr uint8_t WM_ROAM_IDLE     = 0;
+    static constexpr uint8_t WM_ROAM_DIRECTED = 1;  // Connecting to the chosen BSSID, handlers stand aside
+    static constexpr uint8_t WM_ROAM_FALLBACK = 2;  // Any AP of the network, failures take the normal path
+
     // State management
-    wm_state_t _state;
+    std::atomic<wm_state_t> _state;
     std::mutex _mutex;
+    EventGroupHandle_t _eventGroup;
     
     // Configuration
     std::string _apName;
@@ -155,9 +265,43 @@ private:
     bool _removeDuplicateAPs;
     bool _scanDispPerc;
     std::vector<WiFiNetwork> _scanResults;
-    std::vector<wifi_ap_record_t> _rawScanResults;
+    WMScanTable _scanTables[2];  // Front buffer served to /scan, back buffer filled by the driver
+    uint8_t _scanFront;
+    std::mutex _scanMutex;       // Guards the front buffer swap and the history
+    WMScanHistory _scanHistory;  // Generations and removals for /scan?since=
     int64_t _lastScanTime;
-    bool _scanInProgress;
+    int64_t _scanStartTime;
+    uint64_t _scanCacheMaxAge;
+    std::atomic<bool> _scanInProgress;
+    bool _scanAsync;
+    bool _scanWaitSTAStart;
+    bool _scanRestoreAP;
+    
+    // Sliced background scan, driven by WIFI_EVENT_SCAN_DONE and _scanSliceTimer
+    wm_scan_config_t _scanConfig;
+    esp_timer_handle_t _scanSliceTimer;
+    uint8_t _scanChannels[WM_SCAN_MAX_CHANNELS];
+    uint8_t _scanChannelCount;
+    uint8_t _scanChannelPos;
+    uint8_t _scanSliceDone;
+    bool _scanSliced;
+    bool _preloadScan;
+    
+    // Reconnect scheduler, armed by STA_DISCONNECTED in RUN_STA and fired by _reconnectTimer
+    bool _autoReconnect;
+    wm_reconnect_config_t _reconnectConfig;
+    esp_timer_handle_t _reconnectTimer;
+    std::atomic<uint8_t> _reconnectAttempts;  // Since the link was lost, 0 = none pending
+    
+    // Link monitor, only runs while connected
+    wm_roam_config_t _roamConfig;
+    TaskHandle_t _linkMonitorTask;
+    std::atomic<bool> _linkMonitorRun;
+    std::atomic<uint8_t> _roaming;  // WM_ROAM_*, cleared by the event handlers that end the attempt
+    
+    // Power profiles, reapplied on every state change
+    wm_power_config_t _powerConfig;
+    std::atomic<wm_power_profile_t> _powerProfile;  // Last one the driver accepted
     
     // Captive portal settings
     bool _captivePortalEnable;
@@ -169,27 +313,105 @@ private:
     std::string _cssClass;
     std::vector<menu_page_t> _menuPages;
     
-    // Custom parameters
-    std::vector<std::unique_ptr<WiFiManagerParameter>> _params;
+    // Custom parameters (not owned), values live in _paramArena while it has room
+    WiFiManagerParameter* _params[WM_MAX_CUSTOM_PARAMS];
+    uint8_t _paramsCount;
+    uint16_t _paramArenaUsed;
+    char _paramArena[WM_PARAM_ARENA_SIZE > 0 ? WM_PARAM_ARENA_SIZE : 1];
+    
+    // Form key -> parameter lookup, sorted by key hash
+    struct ParamIndexEntry {
+        uint32_t hash;
+        uint8_t param;
+    };
+    ParamIndexEntry _paramIndex[WM_MAX_CUSTOM_PARAMS];
+    uint8_t _paramIndexCount;
     
     // Callbacks
     APCallback _apCallback;
     SaveConfigCallback _saveConfigCallback;
     ConfigModeCallback _configModeCallback;
     WebServerModeCallback _webServerModeCallback;
+    ReconnectCallback _reconnectCallback;
     
     // ESP-IDF handles
     esp_netif_t* _apNetif;
     esp_netif_t* _staNetif;
+    wm_http_config_t _httpConfig;
+#if WM_PROVISION_HTTP
     httpd_handle_t _httpServer;
+    bool _httpStaOnly;              // Server was started by startWebPortal() over the STA link
+    const WMRoute* _extraRoutes;    // Application's static table, not owned
+    uint8_t _extraRouteCount;
+    bool _portalLean;               // Heap preflight failed, portal runs with fewer sockets and no workers
+    std::atomic<uint32_t> _httpHeapReserved;  // Bytes claimed by handlers in flight, see reserveHeap()
+    
+    // Async request workers, fed by queueAsyncRequest()
+    struct AsyncRequest {
+        httpd_req_t* req;
+        esp_err_t (*handler)(httpd_req_t*);
+    };
+    QueueHandle_t _asyncQueue;
+    TaskHandle_t _asyncWorkers[WM_HTTP_ASYNC_WORKERS > 0 ? WM_HTTP_ASYNC_WORKERS : 1];
+    
+    // Open /events streams, only touched from the HTTP server task
+    httpd_req_t* _eventClients[WM_HTTP_EVENT_CLIENTS > 0 ? WM_HTTP_EVENT_CLIENTS : 1];
+#else
+    // UDP provisioning task; status pushes go to the last client that sent a request
+    TaskHandle_t _provisionTaskHandle;
+    int _provisionSocket;
+    bool _provisionRunning;
+    std::atomic<uint64_t> _provisionClient;  // IP << 16 | port, both network byte order, 0 = none yet
+#endif
     esp_event_handler_instance_t _wifiEventHandler;
     esp_event_handler_instance_t _ipEventHandler;
     
     // Internal state
-    wl_status_t _lastConxResult;
+    WMSeqLock<WiFiManagerStatus> _status;  // Published by the event handlers, read without _mutex
     bool _portalAbortResult;
     int64_t _configPortalStart;
     int64_t _connectStart;
+    wm_connect_metrics_t _connectMetrics;
+#if WM_ENABLE_METRICS
+    WMMetrics _metrics;
+#endif
+#if WM_ENABLE_LOAD_TEST
+    std::unique_ptr<WMLoadTest> _loadTest;
+#endif
+    
+    // Fast reconnect cache, persisted in NVS on GOT_IP
+    struct FastConnectCache {
+        uint8_t version;
+        uint8_t ssid[32];
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint32_t ip, gw, netmask;
+    };
+    FastConnectCache _fastConnect;
+    bool _fastConnectLoaded;
+    bool _fastConnectEnabled;
+    bool _fastConnectReuseIP;
+    bool _fastConnectActive;
+    
+    // Credential store, persisted in NVS together with the parameter values
+    struct StoredCredential {
+        char ssid[WM_MAX_SSID_LEN + 1];
+        char password[WM_MAX_PASSWORD_LEN + 1];
+        uint32_t lastUsed;
+        uint16_t successCount;
+    };
+    struct CredentialStore {
+        uint8_t version;
+        uint8_t count;
+        uint32_t clock;  // Bumped on every add/success, orders entries for LRU
+        StoredCredential entries[WM_MAX_CREDENTIALS];
+    };
+    CredentialStore _credStore;
+    bool _credStoreLoaded;
+    uint8_t _credUnsavedSuccesses;  // Reconnects counted since the store was last written
+    uint8_t _paramsRestored;        // Parameters that already got their stored value
+    uint32_t _storeCrc;             // storeContentCrc() of what is in NVS, 0 = unknown
+    std::mutex _credMutex;
     
     // Private methods
     void init();
@@ -197,23 +419,115 @@ private:
     
     // WiFi management
     bool setupWiFi();
+    bool setupAPNetif();
     bool startSTA();
     bool startAP(const char* ssid, const char* password);
     void stopWiFi();
     
+    // Fast reconnect
+    bool loadFastConnect();
+    bool applyFastConnect();
+    bool applyScannedAP(wifi_config_t& config);
+    void fallbackFromFastConnect();
+    void saveFastConnect(const esp_netif_ip_info_t& ip_info);
+    void clearFastConnect();
+    
+    // Reconnect scheduler
+    void scheduleReconnect(uint8_t reason);
+    void cancelReconnect();
+    void finishReconnect(bool connected);
+    uint32_t reconnectDelay(uint8_t reason, uint8_t attempt) const;
+    static void reconnectTimerCallback(void* arg);
+    
+    // Link monitor and roaming
+    void startLinkMonitor();
+    void stopLinkMonitor();
+    static void linkMonitorTask(void* pvParameters);
+    void roam(const wifi_ap_record_t& current, int8_t average);
+    bool findRoamCandidate(const wifi_ap_record_t& current, int8_t minRssi, wifi_ap_record_t& out);
+    void applyRoamCapabilities(wifi_config_t& config) const;
+    
+    // Power profiles
+    void applyPowerProfile();
+    void applyStaConfig(wifi_config_t& config) const;
+    uint8_t pickAPChannel();
+    
+    // Persistent store (load/save/find/insert expect _credMutex held)
+    bool loadStore();
+    bool saveStore();
+    void restoreStore();
+    void restoreParameters(const uint8_t* records, uint8_t count, size_t bytes);
+    int findCredential(const char* ssid) const;
+    int insertCredential(const char* ssid, const char* password);
+    int mostRecentCredential() const;
+    void recordCredentialSuccess();
+    uint32_t storeContentCrc(const uint8_t* params, size_t paramBytes) const;
+    bool connectToStoredNetworks(const char* skipSSID);
+    
     // State machine
     void updateState();
+    void setState(wm_state_t state);
+    bool transitionState(wm_state_t from, wm_state_t to);
+    void setLastConxResult(wl_status_t result);
+    void beginConnectAttempt();
+    EventBits_t waitForEvents(EventBits_t bits, int64_t deadline);
     bool handleSTAConnection();
     bool handlePortalMode();
     
+    // Credentials submitted through the portal, shared by every provisioning backend
+    bool beginPortalConnect(const char* ssid, const char* password);
+    
+#if WM_PROVISION_HTTP
     // HTTP server
-    bool startHTTPServer();
+    static const WMRoute ROUTES[];
+    void registerRoute(const WMRoute& route);
+    bool startHTTPServer(bool staOnly = false);
     void stopHTTPServer();
+    bool startAsyncWorkers();
+    void stopAsyncWorkers();
+    static void asyncWorkerTask(void* pvParameters);
+    static esp_err_t queueAsyncRequest(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t*));
+    
+    // Portal heap budget
+    void checkPortalHeap();
+    bool reserveHeap(uint32_t bytes);
+    void releaseHeap(uint32_t bytes);
+    static esp_err_t sendBusy(httpd_req_t *req);
+#endif
+    
+    // Connection progress push to /events clients (or the UDP client)
+    void notifyStatus();
+#if WM_PROVISION_HTTP
+    void writeStatus(WMJsonWriter& json) const;
+    static void broadcastStatus(void* arg);
+    static void closeEventClients(void* arg);
+    static esp_err_t sendEvent(httpd_req_t *req, const char* data, size_t len);
+    
+    // Runs Handler on an async worker instead of the server task
+    template <esp_err_t (*Handler)(httpd_req_t*)>
+    static esp_err_t asyncHandler(httpd_req_t *req) {
+        return queueAsyncRequest(req, Handler);
+    }
+    
+    // Runs Handler only while Cost bytes fit the heap budget, 503 otherwise
+    template <esp_err_t (*Handler)(httpd_req_t*), uint32_t Cost>
+    static esp_err_t budgetHandler(httpd_req_t *req) {
+        WiFiManager* manager = getManagerFromRequest(req);
+        if (!manager->reserveHeap(Cost)) {
+            return sendBusy(req);
+        }
+        esp_err_t ret = Handler(req);
+        manager->releaseHeap(Cost);
+        return ret;
+    }
+#endif
     
     // Internal methods (no mutex locking)
-    bool startConfigPortalInternal(const char* apName, const char* apPassword);
+    // Called with lock held on _mutex, releases it before blocking on the portal
+    bool startConfigPortalInternal(const char* apName, const char* apPassword,
+                                   std::unique_lock<std::mutex>& lock);
     
-
+#if WM_PROVISION_HTTP
     static esp_err_t handleRoot(httpd_req_t *req);
     static esp_err_t handleWifi(httpd_req_t *req);
     static esp_err_t handleStatus(httpd_req_t *req);
@@ -223,7 +537,27 @@ private:
     static esp_err_t handleReset(httpd_req_t *req);
     static esp_err_t handleExit(httpd_req_t *req);
     static esp_err_t handleCaptivePortal(httpd_req_t *req);
+    static esp_err_t handleMetrics(httpd_req_t *req);
+    static esp_err_t handleEvents(httpd_req_t *req);
+    static esp_err_t handleWifiCss(httpd_req_t *req);
+    static esp_err_t handleWifiJs(httpd_req_t *req);
     static WiFiManager* getManagerFromRequest(httpd_req_t *req);
+    // Fields collected from a /wifisave body
+    struct SaveForm {
+        WiFiManager* manager;
+        char ssid[WM_MAX_SSID_LEN + 1];
+        char password[WM_MAX_PASSWORD_LEN + 1];
+        bool tooLong;           // SSID or password longer than the driver accepts
+    };
+    static void handleFormField(void* ctx, const char* key, size_t keyLen,
+                                const char* value, size_t valueLen, bool truncated);
+    static esp_err_t sendAsset(httpd_req_t *req, const uint8_t* start, const uint8_t* end,
+                               const char* type, const char* etag);
+    
+    // Page template placeholders shared by every page ({{head}}, {{class}}, {{device}})
+    bool resolveCommon(std::string_view name, WMTemplate& out) const;
+    void renderMenu(WMTemplate& out) const;
+    void renderParameters(WMTemplate& out) const;
     
     // DNS server
     bool startDNSServer();
@@ -234,19 +568,37 @@ private:
     TaskHandle_t _dnsTaskHandle;
     int _dnsSocket;
     bool _dnsRunning;
+#else
+    // UDP provisioning server
+    bool startProvisionServer();
+    void stopProvisionServer();
+    static void provisionTask(void* pvParameters);
+    size_t handleProvisionRequest(const uint8_t* request, size_t len, uint8_t* reply);
+    size_t writeProvisionStatus(uint8_t* buffer, size_t capacity, uint8_t seq) const;
+#endif
+    WiFiManagerParameter* findParameter(const char* id, size_t len) const;
     
     // Initialization state
     bool _initialized;
+    bool _wifiInitialized;      // esp_wifi_init() done, survives cleanup()
     bool _cleanupInProgress;
     
     // Scanning
     bool scanWiFiNetworks();
-    void filterScanResults();
     void performWiFiScan(bool async = false);
-    bool isDuplicateSSID(const char* ssid, const std::vector<wifi_ap_record_t>& results);
+    bool startScanDriver(bool block);
+    bool startSlicedScan();
+    bool startScanChannel();
+    void continueSlicedScan(bool ok);
+    void finishAsyncScan();
+    static void scanSliceTimerCallback(void* arg);
+    size_t collectScanRecords(WMScanTable& table);
+    void flipScanTables(bool complete);
+    void publishScanResults();
+    bool isScanCacheStale() const;
     int calculateSignalQuality(int rssi);
-    void sortScanResultsBySignal();
-    std::vector<wifi_ap_record_t> getFilteredScanResults();
+    size_t getScanRows(WMScanRow* rows);
+    size_t getScanDelta(uint32_t since, WMScanRow* rows, WMScanHistory::Delta& delta);
     
     // Event handlers
     static void wifiEventHandler(void* arg, esp_event_base_t event_base,
@@ -7,6 +7,12 @@
 /**
  * WiFiManagerParameter class for custom configuration parameters
  * Compatible with Arduino WiFiManager API
+ *
+ * id, placeholder and custom HTML are not copied: like the Arduino library,
+ * the strings passed in (normally literals) must outlive the parameter.
+ * The value starts out pointing at the default and gets writable storage of
+ * `length` bytes on the first setValue(), either from the owning
+ * WiFiManager's arena or, for standalone parameters, from the heap.
  */
 class WiFiManagerParameter {
 public:
@@ -39,7 +45,7 @@ public:
     const char* getCustomHTML() const;
     int getType() const;
 
-    // Setters
+    // Setters (values longer than the parameter length are truncated)
     void setValue(const char* value, int length = -1);
     void setValue(const std::string& value);
     void setValue(std::string_view value);
@@ -51,15 +57,29 @@ public:
               int length, 
               const char* custom, 
               int type);
+    
+    // Value storage hand-over, used by WiFiManager::addParameter() and its destructor
+    size_t storageSize() const { return _length + 1; }
+    void attachStorage(char* buffer);
+    void detachStorage();
 
 private:
-    std::string _id;
-    std::string _placeholder;
-    std::string _label;
-    std::string _value;
-    std::string _customHTML;
-    int _length;
-    int _type;
+    // Value storage state
+    enum : uint8_t {
+        VALUE_WRITABLE = 1 << 0,  // _value points at storage we may write
+        VALUE_OWNED    = 1 << 1,  // ... and it was heap-allocated by this parameter
+    };
+    
+    std::string_view _id;
+    std::string_view _placeholder;
+    std::string_view _customHTML;
+    const char* _value;
+    uint16_t _valueLength;
+    uint16_t _length;
+    uint8_t _type;
+    uint8_t _flags;
     
     void copyFrom(const WiFiManagerParameter& other);
-}; 
\ No newline at end of file
+    void releaseValue();
+    char* writableValue();
+}; 
@@ -4,6 +4,8 @@
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
+#include "wm_log.h"
+#include "wm_limits.h"
 #include <string>
 #include <functional>
 
@@ -11,40 +13,6 @@
 extern "C" {
 #endif
 
-// Component name for logging
-#define WM_TAG "WiFiManager"
-
-// Logging macros
-#if CONFIG_WM_LOG_LEVEL >= 5
-#define WM_LOGV(format, ...) ESP_LOGV(WM_TAG, format, ##__VA_ARGS__)
-#else
-#define WM_LOGV(format, ...)
-#endif
-
-#if CONFIG_WM_LOG_LEVEL >= 4
-#define WM_LOGD(format, ...) ESP_LOGD(WM_TAG, format, ##__VA_ARGS__)
-#else
-#define WM_LOGD(format, ...)
-#endif
-
-#if CONFIG_WM_LOG_LEVEL >= 3
-#define WM_LOGI(format, ...) ESP_LOGI(WM_TAG, format, ##__VA_ARGS__)
-#else
-#define WM_LOGI(format, ...)
-#endif
-
-#if CONFIG_WM_LOG_LEVEL >= 2
-#define WM_LOGW(format, ...) ESP_LOGW(WM_TAG, format, ##__VA_ARGS__)
-#else
-#define WM_LOGW(format, ...)
-#endif
-
-#if CONFIG_WM_LOG_LEVEL >= 1
-#define WM_LOGE(format, ...) ESP_LOGE(WM_TAG, format, ##__VA_ARGS__)
-#else
-#define WM_LOGE(format, ...)
-#endif
-
 // WiFiManager states
 typedef enum {
     WM_STATE_INIT = 0,
@@ -92,23 +60,278 @@ typedef enum {
     WMP_TYPE_HIDDEN
 } wm_parameter_type_t;
 
+// Timing of the last STA connection attempt (microseconds since it started)
+typedef struct {
+    int64_t associatedUs;       // Until WIFI_EVENT_STA_CONNECTED
+    int64_t gotIPUs;            // Until IP_EVENT_STA_GOT_IP
+    bool fastConnect;           // Directed connect with cached BSSID/channel attempted
+    bool fastConnectFallback;   // Directed connect failed, retried with a full scan
+    bool cachedIP;              // Cached IP lease reused instead of DHCP
+} wm_connect_metrics_t;
+
+// HTTP server tuning, applied on the next server start
+typedef struct {
+    uint16_t maxOpenSockets;
+    uint16_t recvTimeout;       // Seconds
+    uint16_t sendTimeout;       // Seconds
+    bool lruPurge;              // Close the least recently used socket when full
+    int coreId;                 // -1 for no affinity
+    uint8_t webPortalPriority;  // Server task priority for startWebPortal() while connected
+    uint32_t heapBudget;        // Bytes handlers may claim at once, 0 = unlimited
+} wm_http_config_t;
+
+// Background scan scheduling, see setScanConfig()
+typedef struct {
+    uint8_t channelsPerSlice;   // Channels scanned before returning to the AP channel, 0 = one pass
+    uint16_t homeDwellMs;       // Time on the AP channel between slices
+    uint16_t activeDwellMs;     // Per channel
+    uint16_t passiveDwellMs;    // Per channel
+    uint16_t passiveChannels;   // Bit n = scan channel n passively
+    bool homeChannelFirst;      // Start on the AP's own channel
+} wm_scan_config_t;
+
+// Synthetic portal load, see startLoadTest()
+typedef struct {
+    uint8_t httpClients;        // Concurrent HTTP client tasks, 0 = none
+    uint16_t httpIntervalMs;    // Pause between requests of one client
+    uint16_t dnsIntervalMs;     // Pause between DNS queries, 0 = no DNS client
+    uint32_t durationMs;        // 0 = until stopLoadTest()
+} wm_load_test_config_t;
+
+// Automatic reconnect backoff, see setReconnectConfig()
+typedef struct {
+    uint32_t minDelayMs;        // First retry after a beacon timeout
+    uint32_t maxDelayMs;        // Backoff cap
+    uint32_t authFailDelayMs;   // Floor after WL_WRONG_PASSWORD
+    uint8_t maxAttempts;        // 0 = keep trying
+} wm_reconnect_config_t;
+
+// Radio power profiles, see setPowerConfig()
+typedef enum {
+    WM_POWER_UNMANAGED = 0,     // Power save and TX power left to the application
+    WM_POWER_PORTAL_RESPONSIVE, // No power save, full TX power
+    WM_POWER_STA_LOW_POWER,     // Max modem sleep, long listen interval, optional TX cap
+    WM_POWER_STA_BALANCED,      // Min modem sleep, wakes for every DTIM (ESP-IDF default)
+    WM_POWER_STA_THROUGHPUT     // No power save, full TX power
+} wm_power_profile_t;
+
+typedef struct {
+    wm_power_profile_t portalProfile;   // While a config portal or web portal is served
+    wm_power_profile_t staProfile;      // Connected or connecting, no portal
+    uint8_t listenInterval;     // Beacons between wakeups in STA_LOW_POWER, applied at association
+    int8_t lowPowerTxPower;     // TX cap in STA_LOW_POWER (0.25 dBm, 8-84), 0 = no cap
+    bool autoAPChannel;         // Start the AP on the least used of channels 1, 6 and 11
+} wm_power_config_t;
+
+// Link monitor and roaming, see setRoamConfig()
+typedef struct {
+    uint16_t intervalMs;        // RSSI sample period, 0 = monitor off
+    int8_t rssiThreshold;       // Averaged RSSI that triggers a roam (dBm)
+    uint8_t minGainDb;          // Required improvement of a candidate over the average
+    uint16_t holdoffSec;        // Minimum time between roaming attempts
+} wm_roam_config_t;
+
 // Constants
-#define WM_MAX_SSID_LEN 32
-#define WM_MAX_PASSWORD_LEN 64
 #define WM_MAX_HOSTNAME_LEN 32
 #define WM_MAX_CUSTOM_HTML_LEN 1024
 #define WM_MAX_CUSTOM_PARAMS CONFIG_WM_MAX_CUSTOM_PARAMS
-#define WM_MAX_SCAN_RESULTS 20
+#define WM_PARAM_ARENA_SIZE CONFIG_WM_PARAM_ARENA_SIZE
+#ifdef CONFIG_WM_PERSIST_PARAMS
+#define WM_PERSIST_PARAMS 1
+#else
+#define WM_PERSIST_PARAMS 0
+#endif
+#define WM_STORE_MAX_PARAM_BYTES 4096
+#define WM_SCAN_CACHE_MAX_AGE CONFIG_WM_SCAN_CACHE_MAX_AGE
+#define WM_SCAN_TIMEOUT_MS 15000
+#define WM_SCAN_SLICE_CHANNELS CONFIG_WM_SCAN_SLICE_CHANNELS
+#define WM_SCAN_HOME_DWELL CONFIG_WM_SCAN_HOME_DWELL
+#define WM_SCAN_ACTIVE_DWELL CONFIG_WM_SCAN_ACTIVE_DWELL
+#define WM_SCAN_PASSIVE_DWELL CONFIG_WM_SCAN_PASSIVE_DWELL
+#define WM_SCAN_PASSIVE_CHANNELS CONFIG_WM_SCAN_PASSIVE_CHANNELS
+#ifdef CONFIG_WM_SCAN_HOME_CHANNEL_FIRST
+#define WM_SCAN_HOME_CHANNEL_FIRST 1
+#else
+#define WM_SCAN_HOME_CHANNEL_FIRST 0
+#endif
+#define WM_SCAN_MAX_CHANNELS 14
 
 // Default values
 #define WM_DEFAULT_AP_CHANNEL 1
+#define WM_AP_START_TIMEOUT_MS 3000
 #define WM_DEFAULT_CONNECT_TIMEOUT CONFIG_WM_DEFAULT_CONNECT_TIMEOUT
 #define WM_DEFAULT_PORTAL_TIMEOUT CONFIG_WM_DEFAULT_PORTAL_TIMEOUT
 #define WM_MIN_QUALITY CONFIG_WM_MIN_SIGNAL_QUALITY
 
+// Provisioning backend, exactly one of these is 1
+#ifdef CONFIG_WM_PROVISION_UDP
+#define WM_PROVISION_HTTP 0
+#define WM_PROVISION_UDP 1
+#define WM_PROVISION_PORT CONFIG_WM_PROVISION_PORT
+#else
+#define WM_PROVISION_HTTP 1
+#define WM_PROVISION_UDP 0
+#endif
+#define WM_PROVISION_MAX_PACKET 512
+#define WM_PROVISION_STACK_SIZE 4096
+
+// Fast reconnect
+#ifdef CONFIG_WM_FAST_RECONNECT
+#define WM_FAST_RECONNECT 1
+#else
+#define WM_FAST_RECONNECT 0
+#endif
+#ifdef CONFIG_WM_FAST_RECONNECT_REUSE_IP
+#define WM_FAST_RECONNECT_REUSE_IP 1
+#else
+#define WM_FAST_RECONNECT_REUSE_IP 0
+#endif
+
+// Metrics
+#ifdef CONFIG_WM_ENABLE_METRICS
+#define WM_ENABLE_METRICS 1
+#else
+#define WM_ENABLE_METRICS 0
+#endif
+
+// Load test (bench builds only, needs metrics and LWIP loopback)
+#ifdef CONFIG_WM_ENABLE_LOAD_TEST
+#define WM_ENABLE_LOAD_TEST 1
+#define WM_LOAD_TEST_HTTP_CLIENTS CONFIG_WM_LOAD_TEST_HTTP_CLIENTS
+#define WM_LOAD_TEST_HTTP_INTERVAL CONFIG_WM_LOAD_TEST_HTTP_INTERVAL
+#define WM_LOAD_TEST_DNS_INTERVAL CONFIG_WM_LOAD_TEST_DNS_INTERVAL
+#define WM_LOAD_TEST_DURATION CONFIG_WM_LOAD_TEST_DURATION
+#else
+#define WM_ENABLE_LOAD_TEST 0
+#define WM_LOAD_TEST_HTTP_CLIENTS 2
+#define WM_LOAD_TEST_HTTP_INTERVAL 100
+#define WM_LOAD_TEST_DNS_INTERVAL 20
+#define WM_LOAD_TEST_DURATION 30
+#endif
+#define WM_LOAD_TEST_MAX_CLIENTS 4
+#define WM_LOAD_TEST_STACK_SIZE 3072
+#define WM_LOAD_TEST_TIMEOUT_MS 2000
+
+#define WM_LOAD_TEST_CONFIG_DEFAULT() {                     \
+    .httpClients = WM_LOAD_TEST_HTTP_CLIENTS,               \
+    .httpIntervalMs = WM_LOAD_TEST_HTTP_INTERVAL,           \
+    .dnsIntervalMs = WM_LOAD_TEST_DNS_INTERVAL,             \
+    .durationMs = WM_LOAD_TEST_DURATION * 1000u,            \
+}
+
+// Automatic reconnect
+#ifdef CONFIG_WM_AUTO_RECONNECT
+#define WM_AUTO_RECONNECT 1
+#define WM_RECONNECT_MIN_DELAY CONFIG_WM_RECONNECT_MIN_DELAY
+#define WM_RECONNECT_MAX_DELAY CONFIG_WM_RECONNECT_MAX_DELAY
+#define WM_RECONNECT_AUTH_DELAY CONFIG_WM_RECONNECT_AUTH_DELAY
+#else
+#define WM_AUTO_RECONNECT 0
+#define WM_RECONNECT_MIN_DELAY 500
+#define WM_RECONNECT_MAX_DELAY 60000
+#define WM_RECONNECT_AUTH_DELAY 30000
+#endif
+
+// Link monitor and roaming
+#ifdef CONFIG_WM_ENABLE_ROAMING
+#define WM_ENABLE_ROAMING 1
+#define WM_ROAM_INTERVAL CONFIG_WM_ROAM_INTERVAL
+#define WM_ROAM_RSSI_THRESHOLD CONFIG_WM_ROAM_RSSI_THRESHOLD
+#define WM_ROAM_MIN_GAIN CONFIG_WM_ROAM_MIN_GAIN
+#define WM_ROAM_HOLDOFF CONFIG_WM_ROAM_HOLDOFF
+#else
+#define WM_ENABLE_ROAMING 0
+#define WM_ROAM_INTERVAL 5000
+#define WM_ROAM_RSSI_THRESHOLD -75
+#define WM_ROAM_MIN_GAIN 8
+#define WM_ROAM_HOLDOFF 60
+#endif
+#if WM_ENABLE_ROAMING && defined(CONFIG_WPA_11KV_SUPPORT)
+#define WM_ROAM_11KV 1
+#else
+#define WM_ROAM_11KV 0
+#endif
+#define WM_ROAM_AVG_SAMPLES 4           // Moving average window
+#define WM_ROAM_MAX_CANDIDATES 8
+#define WM_ROAM_CONNECT_TIMEOUT_MS 8000
+#define WM_ROAM_STACK_SIZE 3072
+
+// Power profiles
+#if defined(CONFIG_WM_STA_POWER_BALANCED)
+#define WM_STA_POWER_PROFILE WM_POWER_STA_BALANCED
+#elif defined(CONFIG_WM_STA_POWER_THROUGHPUT)
+#define WM_STA_POWER_PROFILE WM_POWER_STA_THROUGHPUT
+#elif defined(CONFIG_WM_STA_POWER_UNMANAGED)
+#define WM_STA_POWER_PROFILE WM_POWER_UNMANAGED
+#else
+#define WM_STA_POWER_PROFILE WM_POWER_STA_LOW_POWER
+#endif
+#ifdef CONFIG_WM_STA_LISTEN_INTERVAL
+#define WM_STA_LISTEN_INTERVAL CONFIG_WM_STA_LISTEN_INTERVAL
+#else
+#define WM_STA_LISTEN_INTERVAL 3
+#endif
+#ifdef CONFIG_WM_STA_LOW_POWER_TX
+#define WM_STA_LOW_POWER_TX CONFIG_WM_STA_LOW_POWER_TX
+#else
+#define WM_STA_LOW_POWER_TX 0
+#endif
+#ifdef CONFIG_WM_AP_AUTO_CHANNEL
+#define WM_AP_AUTO_CHANNEL 1
+#else
+#define WM_AP_AUTO_CHANNEL 0
+#endif
+#define WM_MAX_TX_POWER 84              // 0.25 dBm units, the driver clamps to the country limit
+#define WM_MIN_TX_POWER 8
+
+// NVS storage
+#define WM_NVS_NAMESPACE "wifimgr"
+#define WM_MAX_CREDENTIALS CONFIG_WM_MAX_CREDENTIALS
+
 // HTTP server
 #define WM_HTTP_PORT 80
-#define WM_HTTP_MAX_HANDLERS 20
+#define WM_HTTP_MAX_SOCKETS CONFIG_WM_HTTP_MAX_SOCKETS
+#define WM_HTTP_RECV_TIMEOUT CONFIG_WM_HTTP_RECV_TIMEOUT
+#define WM_HTTP_SEND_TIMEOUT CONFIG_WM_HTTP_SEND_TIMEOUT
+#ifdef CONFIG_WM_HTTP_LRU_PURGE
+#define WM_HTTP_LRU_PURGE 1
+#else
+#define WM_HTTP_LRU_PURGE 0
+#endif
+#define WM_HTTP_CORE_ID CONFIG_WM_HTTP_CORE_ID
+#ifdef CONFIG_WM_WEB_PORTAL_PRIORITY
+#define WM_WEB_PORTAL_PRIORITY CONFIG_WM_WEB_PORTAL_PRIORITY
+#else
+#define WM_WEB_PORTAL_PRIORITY 2
+#endif
+#define WM_HTTP_ASYNC_WORKERS CONFIG_WM_HTTP_ASYNC_WORKERS
+#ifdef CONFIG_WM_HTTP_ASYNC_STACK_SIZE
+#define WM_HTTP_ASYNC_STACK_SIZE CONFIG_WM_HTTP_ASYNC_STACK_SIZE
+#else
+#define WM_HTTP_ASYNC_STACK_SIZE 4096
+#endif
+#define WM_HTTP_ASYNC_QUEUE_LEN 8
+#define WM_HTTP_EVENT_CLIENTS CONFIG_WM_HTTP_EVENT_CLIENTS
+#ifdef CONFIG_WM_HTTP_HEAP_BUDGET
+#define WM_HTTP_HEAP_BUDGET CONFIG_WM_HTTP_HEAP_BUDGET
+#else
+#define WM_HTTP_HEAP_BUDGET 16384
+#endif
+#ifdef CONFIG_WM_PORTAL_MIN_FREE_BLOCK
+#define WM_PORTAL_MIN_FREE_BLOCK CONFIG_WM_PORTAL_MIN_FREE_BLOCK
+#else
+#define WM_PORTAL_MIN_FREE_BLOCK 16384
+#endif
+#define WM_HTTP_HEAP_RESERVE 8192   // Free heap left to the rest of the system after a reservation
+#define WM_HTTP_LEAN_SOCKETS 3      // Socket cap when the portal starts low on memory
+// Heap a request holds while its handler runs: streamed responses can fill
+// the TCP send window, fixed ones need a segment or two
+#ifdef CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#define WM_HTTP_COST_STREAM CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#else
+#define WM_HTTP_COST_STREAM 5760
+#endif
+#define WM_HTTP_COST_SMALL 1536
 
 // DNS server
 #define WM_DNS_PORT 53
@@ -0,0 +1,21 @@
+#pragma once
+
+// Sizes shared with the standalone modules (scan table, JSON writer, form
+// parser, DNS responder, page templates). Kept free of sdkconfig and driver headers so those
+// modules also build off-target, see host_test/.
+
+// Credentials
+#define WM_MAX_SSID_LEN 32
+#define WM_MAX_PASSWORD_LEN 64
+
+// Scan results
+#define WM_MAX_SCAN_RESULTS 20
+#define WM_SCAN_REMOVALS 16      // Removed BSSIDs remembered for /scan?since= diffs
+#define WM_SCAN_RSSI_STEP 3      // dB an RSSI has to move before a diff reports it
+
+// HTTP bodies
+#define WM_JSON_CHUNK_SIZE 256
+#define WM_FORM_KEY_MAX 32
+#define WM_FORM_VALUE_MAX 255
+#define WM_FORM_RECV_CHUNK 128
+#define WM_FORM_MAX_BODY 4096
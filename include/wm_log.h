@@ -0,0 +1,38 @@
+#pragma once
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+
+// Component name for logging
+#define WM_TAG "WiFiManager"
+
+// Logging macros
+#if CONFIG_WM_LOG_LEVEL >= 5
+#define WM_LOGV(format, ...) ESP_LOGV(WM_TAG, format, ##__VA_ARGS__)
+#else
+#define WM_LOGV(format, ...)
+#endif
+
+#if CONFIG_WM_LOG_LEVEL >= 4
+#define WM_LOGD(format, ...) ESP_LOGD(WM_TAG, format, ##__VA_ARGS__)
+#else
+#define WM_LOGD(format, ...)
+#endif
+
+#if CONFIG_WM_LOG_LEVEL >= 3
+#define WM_LOGI(format, ...) ESP_LOGI(WM_TAG, format, ##__VA_ARGS__)
+#else
+#define WM_LOGI(format, ...)
+#endif
+
+#if CONFIG_WM_LOG_LEVEL >= 2
+#define WM_LOGW(format, ...) ESP_LOGW(WM_TAG, format, ##__VA_ARGS__)
+#else
+#define WM_LOGW(format, ...)
+#endif
+
+#if CONFIG_WM_LOG_LEVEL >= 1
+#define WM_LOGE(format, ...) ESP_LOGE(WM_TAG, format, ##__VA_ARGS__)
+#else
+#define WM_LOGE(format, ...)
+#endif
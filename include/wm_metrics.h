@@ -0,0 +1,155 @@
+#pragma once
+
+#include "wm_config.h"
+#include "esp_err.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Timed phases of boot, connection and portal startup
+typedef enum {
+    WM_PHASE_INIT = 0,      // NVS, netif and event loop init
+    WM_PHASE_WIFI_SETUP,    // Netifs, driver init, handlers, AP IP
+    WM_PHASE_STA_ASSOC,     // STA connect started -> associated
+    WM_PHASE_STA_DHCP,      // Associated -> got IP
+    WM_PHASE_AP_START,      // AP config -> AP up
+    WM_PHASE_HTTP_START,
+    WM_PHASE_DNS_START,
+    WM_PHASE_SCAN_MODE,     // AP -> AP+STA switch before a scan
+    WM_PHASE_SCAN,          // Scan started -> results published
+    WM_PHASE_COUNT
+} wm_phase_t;
+
+// Instrumented HTTP routes
+typedef enum {
+    WM_ROUTE_ROOT = 0,
+    WM_ROUTE_WIFI,
+    WM_ROUTE_SCAN,
+    WM_ROUTE_WIFISAVE,
+    WM_ROUTE_INFO,
+    WM_ROUTE_EXIT,
+    WM_ROUTE_STATUS,
+    WM_ROUTE_CAPTIVE,
+    WM_ROUTE_METRICS,
+    WM_ROUTE_EVENTS,
+    WM_ROUTE_COUNT
+} wm_route_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50Us;     // Upper bound of the histogram bucket holding the median
+    uint32_t p99Us;
+} wm_route_metrics_t;
+
+// Outcome of one synthetic load test request
+typedef enum {
+    WM_LOAD_OK = 0,
+    WM_LOAD_ERROR,      // Answered, but not with a 2xx/3xx status
+    WM_LOAD_DROPPED     // Connect failed, reset or timed out
+} wm_load_result_t;
+
+// Client-side view of a load test, see WiFiManager::startLoadTest()
+typedef struct {
+    uint32_t httpRequests;              // Completed with WM_LOAD_OK
+    uint32_t httpErrors;
+    uint32_t httpDropped;
+    uint32_t httpP50Us;
+    uint32_t httpP99Us;
+    uint32_t dnsQueries;                // Answered
+    uint32_t dnsTimeouts;
+    uint32_t dnsP50Us;
+    uint32_t dnsP99Us;
+} wm_load_test_metrics_t;
+
+// Snapshot returned by WiFiManager::getMetrics(), all zero when metrics are compiled out
+typedef struct {
+    int64_t phaseUs[WM_PHASE_COUNT];    // Last duration of each phase, 0 if never run
+    wm_route_metrics_t routes[WM_ROUTE_COUNT];
+    uint32_t dnsQueries;
+    uint32_t dnsQPS;                    // Queries in the last full second
+    uint32_t dnsPeakQPS;
+    uint32_t heapFree;
+    uint32_t heapLowWater;              // Lowest free heap seen at a sample point
+    uint32_t heapMinEver;               // esp_get_minimum_free_heap_size()
+    wm_load_test_metrics_t loadTest;    // Zero unless CONFIG_WM_ENABLE_LOAD_TEST
+} wm_metrics_t;
+
+/**
+ * Lock-free counters behind the WM_METRIC_* macros.
+ * Latencies go into log2 histograms so recording is a couple of
+ * atomic increments; percentiles are resolved when a snapshot is taken.
+ */
+class WMMetrics {
+public:
+    // Output sink for writeText(), same contract as WMJsonWriter::Sink
+    typedef esp_err_t (*Sink)(void* ctx, const char* data, size_t len);
+
+    WMMetrics();
+
+    void phaseSet(wm_phase_t phase, int64_t us);
+    void request(wm_route_t route, int64_t us);
+    void dnsQuery();
+    void sampleHeap();
+    void loadTestHttp(int64_t us, wm_load_result_t result);
+    void loadTestDns(int64_t us, bool answered);
+
+    void snapshot(wm_metrics_t& out) const;
+    esp_err_t writeText(Sink sink, void* ctx) const;
+
+    static const char* phaseName(wm_phase_t phase);
+    static const char* routeName(wm_route_t route);
+
+private:
+    static constexpr int BUCKETS = 24;  // 1 us .. 16 s
+
+    struct Route {
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> buckets[BUCKETS];
+    };
+
+    std::atomic<int64_t> _phaseUs[WM_PHASE_COUNT];
+    Route _routes[WM_ROUTE_COUNT];
+    std::atomic<uint32_t> _dnsQueries;
+    std::atomic<uint32_t> _dnsWindowCount;
+    std::atomic<int64_t> _dnsWindowStart;
+    std::atomic<uint32_t> _dnsLastQPS;
+    std::atomic<uint32_t> _dnsPeakQPS;
+    std::atomic<uint32_t> _heapLowWater;
+    Route _loadHttp;
+    Route _loadDns;
+    std::atomic<uint32_t> _loadHttpErrors;
+    std::atomic<uint32_t> _loadHttpDropped;
+    std::atomic<uint32_t> _loadDnsTimeouts;
+
+    static void record(Route& route, int64_t us);
+    static void reset(Route& route);
+    static uint32_t percentile(const Route& route, uint32_t total, uint32_t permille);
+};
+
+// Records the lifetime of the enclosing scope
+class WMScopeTimer {
+public:
+    WMScopeTimer(WMMetrics& metrics, wm_phase_t phase);
+    WMScopeTimer(WMMetrics& metrics, wm_route_t route);
+    ~WMScopeTimer();
+
+private:
+    WMMetrics& _metrics;
+    int64_t _start;
+    int _id;
+    bool _isRoute;
+};
+
+#if WM_ENABLE_METRICS
+#define WM_METRIC_PHASE(m, phase)         WMScopeTimer _wmPhaseTimer((m), (phase))
+#define WM_METRIC_PHASE_SET(m, phase, us) (m).phaseSet((phase), (us))
+#define WM_METRIC_REQUEST(m, route)       WMScopeTimer _wmRequestTimer((m), (route))
+#define WM_METRIC_DNS_QUERY(m)            (m).dnsQuery()
+#define WM_METRIC_HEAP_SAMPLE(m)          (m).sampleHeap()
+#else
+#define WM_METRIC_PHASE(m, phase)
+#define WM_METRIC_PHASE_SET(m, phase, us)
+#define WM_METRIC_REQUEST(m, route)
+#define WM_METRIC_DNS_QUERY(m)
+#define WM_METRIC_HEAP_SAMPLE(m)
+#endif
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "wm_limits.h"
+#include "esp_wifi.h"
+#include <cstddef>
+#include <cstdint>
+
+// A network as /scan sends it. Responses copy these out under the scan lock
+// and stream them afterwards, which needs far less stack than a whole table.
+struct WMScanRow {
+    uint8_t bssid[6];
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t authmode;
+    uint32_t added;
+    uint32_t changed;
+};
+
+/**
+ * Fixed-capacity scan result table.
+ * Filters by signal quality, dedups by SSID (hash index) and keeps the
+ * WM_MAX_SCAN_RESULTS strongest networks ordered by RSSI, in a single pass
+ * over the driver records and without heap allocation.
+ *
+ * A table can also be refreshed in place: after refresh() the previous
+ * results stay listed while a scan reports networks again, and sweep()
+ * drops the ones it didn't once every channel has been covered. A listed
+ * BSSID is only displaced mid-refresh by a stronger one, so a refresh that
+ * finds the same networks ends up with the same table.
+ */
+class WMScanTable {
+public:
+    static constexpr size_t CAPACITY = WM_MAX_SCAN_RESULTS;
+
+    WMScanTable();
+
+    void reset(int minimumQuality = 0, bool removeDuplicates = true);
+    void add(const wifi_ap_record_t& ap);
+    
+    // Keep the current entries, stamps included, as the base for another scan
+    void refresh(int minimumQuality, bool removeDuplicates);
+    // Drop entries not reported since refresh()
+    void sweep();
+
+    size_t size() const { return _count; }
+    bool empty() const { return _count == 0; }
+
+    // i-th strongest network
+    const wifi_ap_record_t& operator[](size_t i) const { return _entries[_order[i]].ap; }
+
+    // Strongest entry for an SSID, nullptr if not present
+    const wifi_ap_record_t* find(const char* ssid) const;
+    bool contains(const uint8_t* bssid) const { return findSlot(bssid) >= 0; }
+
+    // Generation in which the i-th entry's BSSID appeared, and its RSSI was last reported
+    uint32_t addedAt(size_t i) const { return _entries[_order[i]].added; }
+    uint32_t changedAt(size_t i) const { return _entries[_order[i]].changed; }
+
+    // Carry the stamps over from the table clients saw before this one. New
+    // BSSIDs get generation for both, an RSSI that moved by rssiStep dB or
+    // more since it was last reported gets a new changed stamp.
+    void stamp(const WMScanTable& previous, uint32_t generation, int rssiStep);
+    
+    // Strongest first into out (CAPACITY rows), only those whose changed stamp is after changedSince if set
+    size_t copyRows(WMScanRow* out, uint32_t changedSince = 0) const;
+    
+    // BSSID of the i-th strongest entry
+    const uint8_t* bssidAt(size_t i) const { return _entries[_order[i]].ap.bssid; }
+
+    static int signalQuality(int rssi);
+
+private:
+    // Open-addressed SSID index, at least twice the capacity and a power of two
+    static constexpr size_t INDEX_SIZE = CAPACITY <= 16 ? 32 : CAPACITY <= 32 ? 64 : 128;
+    static constexpr uint8_t EMPTY = 0xFF;
+
+    struct Entry {
+        wifi_ap_record_t ap;
+        uint32_t hash;
+        uint32_t added;
+        uint32_t changed;
+        int8_t reportedRssi;    // As of the changed stamp
+        bool seen;              // Reported since the last refresh()
+        // Strongest other BSSID of the SSID reported while this one wasn't, taken over on sweep()
+        uint8_t altBssid[6];
+        int8_t altRssi;         // NO_ALT if none
+        uint8_t altChannel;
+        wifi_auth_mode_t altAuth;
+    };
+    static constexpr int8_t NO_ALT = -128;
+
+    Entry _entries[CAPACITY];
+    uint8_t _order[CAPACITY];    // Entry slots sorted by RSSI, strongest first
+    uint8_t _index[INDEX_SIZE];  // SSID hash -> entry slot
+    uint8_t _count;
+    int _minimumQuality;
+    bool _removeDuplicates;
+
+    static uint32_t hashSSID(const char* ssid);
+    int lookup(const char* ssid, uint32_t hash) const;
+    int findSlot(const uint8_t* bssid) const;
+    void indexInsert(uint8_t slot);
+    void indexRemove(uint8_t slot);
+    void bubbleUp(size_t pos);
+    void reorder(uint8_t slot);
+    void rebuildIndex();
+};
+
+/**
+ * Generation counter and recent removals behind /scan?since= diffs.
+ * Every published table is a generation; the table's own stamps say what
+ * was added or moved, this keeps what left. Removals are worked out once a
+ * scan completes, against every BSSID published since the last complete
+ * one, so partial results never read as networks going away.
+ * Not locked, the owner publishes and reads it under its scan lock.
+ */
+class WMScanHistory {
+public:
+    // What a client at some earlier generation is missing besides the changed rows
+    struct Delta {
+        uint32_t generation;
+        bool full;              // Generation unknown or too old, the client has to start over
+        uint8_t removedCount;
+        uint8_t removed[WM_SCAN_REMOVALS][6];
+    };
+    
+    explicit WMScanHistory(uint32_t generation);
+    
+    uint32_t generation() const { return _generation; }
+    
+    // next has been stamped with generation() + 1 and is now what clients see
+    void publish(const WMScanTable& next, bool complete);
+    
+    void delta(uint32_t since, Delta& out) const;
+    
+private:
+    // Enough for a full table plus as many networks again appearing mid-scan
+    static constexpr size_t LISTED_MAX = WMScanTable::CAPACITY * 2;
+    
+    struct Removal {
+        uint8_t bssid[6];
+        uint32_t generation;
+    };
+    
+    uint32_t _generation;
+    uint32_t _floor;             // Oldest generation a diff can still start from
+    Removal _removals[WM_SCAN_REMOVALS];
+    uint8_t _removalPos;
+    uint8_t _listed[LISTED_MAX][6];  // BSSIDs published since the last complete scan
+    uint8_t _listedCount;
+    bool _listedOverflow;        // Some weren't tracked, old diffs can't be trusted
+    
+    bool listed(const uint8_t* bssid) const;
+    void recordRemoval(const uint8_t* bssid);
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+/**
+ * Sequence-locked value for small, trivially copyable snapshots.
+ * Readers never take a lock: they copy the value word by word and retry if
+ * a writer was active meanwhile. Writers are serialized by a mutex (with
+ * priority inheritance), so they may block briefly on each other but never
+ * on readers. Keep T small; a read is one copy of it per attempt.
+ */
+template <typename T>
+class WMSeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "WMSeqLock needs a trivially copyable type");
+
+public:
+    WMSeqLock() : _seq(0) {
+        store(T{});
+    }
+
+    T read() const {
+        uint32_t words[WORDS];
+        for (int attempt = 0; ; attempt++) {
+            uint32_t seq = _seq.load(std::memory_order_acquire);
+            if ((seq & 1) == 0) {
+                for (size_t i = 0; i < WORDS; i++) {
+                    words[i] = _words[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (_seq.load(std::memory_order_relaxed) == seq) {
+                    break;
+                }
+            }
+            // A preempted writer needs CPU time to finish, spinning would starve it
+            if (attempt >= 3) {
+                vTaskDelay(1);
+            }
+        }
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    // Applies fn to the current value and publishes the result
+    template <typename Fn>
+    void update(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(_writeMutex);
+        T value = load();
+        fn(value);
+
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store(value);
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    // Writer-side helpers, only called with _writeMutex held (or before sharing)
+    T load() const {
+        uint32_t words[WORDS];
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i] = _words[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    void store(const T& value) {
+        uint32_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < WORDS; i++) {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32_t> _seq;
+    std::atomic<uint32_t> _words[WORDS];
+    std::mutex _writeMutex;
+};
@@ -5,21 +5,57 @@
 #include "esp_timer.h"
 #include "esp_netif.h"
 #include "esp_chip_info.h"
-#include "esp_http_server.h"
+#include "esp_idf_version.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
-#include "cJSON.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+#include "wm_form_parser.h"
+#if WM_PROVISION_HTTP
+#include "esp_http_server.h"
+#include "wm_assets.h"
+#include "wm_json_writer.h"
+#include "wm_scan_json.h"
+#include "wm_template.h"
+#include "wm_param_html.h"
+#include "wm_dns.h"
+#else
+#include "wm_provision.h"
+#endif
+#if WM_ENABLE_LOAD_TEST
+#include "wm_load_test.h"
+#endif
+#if WM_ROAM_11KV
+#include "esp_wnm.h"
+#endif
 #include "lwip/sockets.h"
 #include "lwip/netdb.h"
 #include "lwip/ip4_addr.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <cstdlib>
 #include <cstring>
+#include <strings.h>
 #include <algorithm>
 #include <string>
+#include <new>
+
+// Detached requests (httpd_req_async_handler_begin) need ESP-IDF 5.1
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0) && WM_HTTP_ASYNC_WORKERS > 0
+#define WM_HTTP_ASYNC 1
+#else
+#define WM_HTTP_ASYNC 0
+#endif
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0) && WM_HTTP_EVENT_CLIENTS > 0
+#define WM_HTTP_EVENTS 1
+#else
+#define WM_HTTP_EVENTS 0
+#endif
 
 WiFiManager::WiFiManager() :
     _state(WM_STATE_INIT),
+    _eventGroup(xEventGroupCreate()),
     _connectTimeout(WM_DEFAULT_CONNECT_TIMEOUT * 1000000ULL), // Convert to microseconds
     _configPortalTimeout(WM_DEFAULT_PORTAL_TIMEOUT * 1000000ULL),
     _configPortalBlocking(true),
@@ -29,24 +65,86 @@ WiFiManager::WiFiManager() :
     _minimumQuality(WM_MIN_QUALITY),
     _removeDuplicateAPs(CONFIG_WM_REMOVE_DUP_APS),
     _scanDispPerc(false),
+    _scanFront(0),
+    // Random start, so a page left open across a reboot can't match a generation by accident
+    _scanHistory((esp_random() & 0x3FFFFFFF) | 1),
     _lastScanTime(0),
+    _scanStartTime(0),
+    _scanCacheMaxAge(WM_SCAN_CACHE_MAX_AGE * 1000000ULL),
     _scanInProgress(false),
+    _scanAsync(false),
+    _scanWaitSTAStart(false),
+    _scanRestoreAP(false),
+    _scanConfig{WM_SCAN_SLICE_CHANNELS, WM_SCAN_HOME_DWELL, WM_SCAN_ACTIVE_DWELL, WM_SCAN_PASSIVE_DWELL,
+                WM_SCAN_PASSIVE_CHANNELS, WM_SCAN_HOME_CHANNEL_FIRST != 0},
+    _scanSliceTimer(nullptr),
+    _scanChannels{},
+    _scanChannelCount(0),
+    _scanChannelPos(0),
+    _scanSliceDone(0),
+    _scanSliced(false),
+    _preloadScan(true),
+    _autoReconnect(WM_AUTO_RECONNECT),
+    _reconnectConfig{WM_RECONNECT_MIN_DELAY, WM_RECONNECT_MAX_DELAY, WM_RECONNECT_AUTH_DELAY, 0},
+    _reconnectTimer(nullptr),
+    _reconnectAttempts(0),
+    _roamConfig{WM_ROAM_INTERVAL, WM_ROAM_RSSI_THRESHOLD, WM_ROAM_MIN_GAIN, WM_ROAM_HOLDOFF},
+    _linkMonitorTask(nullptr),
+    _linkMonitorRun(false),
+    _roaming(WM_ROAM_IDLE),
+    _powerConfig{WM_POWER_PORTAL_RESPONSIVE, WM_STA_POWER_PROFILE, WM_STA_LISTEN_INTERVAL,
+                 WM_STA_LOW_POWER_TX, WM_AP_AUTO_CHANNEL != 0},
+    _powerProfile(WM_POWER_UNMANAGED),
     _captivePortalEnable(true),
     _captivePortalClientCheck(true),
     _webPortalClientCheck(true),
+    _params{},
+    _paramsCount(0),
+    _paramArenaUsed(0),
+    _paramIndexCount(0),
     _apNetif(nullptr),
     _staNetif(nullptr),
+    _httpConfig{WM_HTTP_MAX_SOCKETS, WM_HTTP_RECV_TIMEOUT, WM_HTTP_SEND_TIMEOUT,
+                WM_HTTP_LRU_PURGE != 0, WM_HTTP_CORE_ID, WM_WEB_PORTAL_PRIORITY, WM_HTTP_HEAP_BUDGET},
+#if WM_PROVISION_HTTP
     _httpServer(nullptr),
+    _httpStaOnly(false),
+    _extraRoutes(nullptr),
+    _extraRouteCount(0),
+    _portalLean(false),
+    _httpHeapReserved(0),
+    _asyncQueue(nullptr),
+    _asyncWorkers{},
+    _eventClients{},
+#else
+    _provisionTaskHandle(nullptr),
+    _provisionSocket(-1),
+    _provisionRunning(false),
+    _provisionClient(0),
+#endif
     _wifiEventHandler(nullptr),
     _ipEventHandler(nullptr),
-    _lastConxResult(WL_IDLE_STATUS),
     _portalAbortResult(false),
     _configPortalStart(0),
     _connectStart(0),
+    _connectMetrics{},
+    _fastConnect{},
+    _fastConnectLoaded(false),
+    _fastConnectEnabled(WM_FAST_RECONNECT),
+    _fastConnectReuseIP(WM_FAST_RECONNECT_REUSE_IP),
+    _fastConnectActive(false),
+    _credStore{},
+    _credStoreLoaded(false),
+    _credUnsavedSuccesses(0),
+    _paramsRestored(0),
+    _storeCrc(0),
+#if WM_PROVISION_HTTP
     _dnsTaskHandle(nullptr),
     _dnsSocket(-1),
     _dnsRunning(false),
+#endif
     _initialized(false),
+    _wifiInitialized(false),
     _cleanupInProgress(false)
 {
     WM_LOGI("WiFiManager constructor");
@@ -56,6 +154,28 @@ WiFiManager::WiFiManager() :
 WiFiManager::~WiFiManager() {
     WM_LOGI("WiFiManager destructor");
     cleanup();
+    
+    // Parameters outlive us, move their values out of the arena
+    for (uint8_t i = 0; i < _paramsCount; i++) {
+        _params[i]->detachStorage();
+    }
+    
+    if (_scanSliceTimer) {
+        esp_timer_stop(_scanSliceTimer);
+        esp_timer_delete(_scanSliceTimer);
+        _scanSliceTimer = nullptr;
+    }
+    
+    if (_reconnectTimer) {
+        esp_timer_stop(_reconnectTimer);
+        esp_timer_delete(_reconnectTimer);
+        _reconnectTimer = nullptr;
+    }
+    
+    if (_eventGroup) {
+        vEventGroupDelete(_eventGroup);
+        _eventGroup = nullptr;
+    }
 }
 
 void WiFiManager::init() {
@@ -65,6 +185,7 @@ void WiFiManager::init() {
     }
     
     WM_LOGI("Initializing WiFiManager...");
+    WM_METRIC_PHASE(_metrics, WM_PHASE_INIT);
     
     // Initialize NVS if not already done
     esp_err_t ret = nvs_flash_init();
@@ -90,8 +211,15 @@ void WiFiManager::init() {
 }
 
 void WiFiManager::cleanup() {
+    cancelReconnect();
+    stopLinkMonitor();
+    stopLoadTest();
+#if WM_PROVISION_HTTP
     stopHTTPServer();
     stopDNSServer();
+#else
+    stopProvisionServer();
+#endif
     stopWiFi();
     
     // Unregister event handlers
@@ -124,8 +252,14 @@ void WiFiManager::stopServers() {
     if (!_cleanupInProgress) {
         _cleanupInProgress = true;
         
+        stopLoadTest();
+#if WM_PROVISION_HTTP
         stopHTTPServer();
         stopDNSServer();
+#else
+        stopProvisionServer();
+#endif
+        applyPowerProfile();
         
         _cleanupInProgress = false;
         WM_LOGI("✅ Servers stopped successfully");
@@ -148,6 +282,13 @@ bool WiFiManager::resetSettings() {
         WM_LOGE("❌ Failed to clear WiFi credentials: %s", esp_err_to_name(ret));
         return false;
     }
+    clearFastConnect();
+    {
+        std::lock_guard<std::mutex> credLock(_credMutex);
+        loadStore();  // Parameter values not restored yet would be saved as defaults
+        memset(&_credStore, 0, sizeof(_credStore));
+        saveStore();
+    }
     
     WM_LOGI("✅ WiFi credentials reset successfully - device will need reconfiguration");
     return true;
@@ -171,6 +312,7 @@ bool WiFiManager::reconnectWiFi() {
 
 bool WiFiManager::reconnectWiFi(uint32_t timeoutSeconds) {
     WM_LOGI("🔄 Attempting WiFi reconnection (timeout: %lu seconds)...", timeoutSeconds);
+    cancelReconnect();  // Don't let a scheduled attempt interfere with this one
     
     // Check if we have saved credentials
     wifi_config_t wifi_config = {};
@@ -180,11 +322,16 @@ bool WiFiManager::reconnectWiFi(uint32_t timeoutSeconds) {
         return false;
     }
     
-    // Disconnect first to ensure clean state
+    // Disconnect first to ensure clean state, waiting for the driver to confirm
+    bool was_connected = isWiFiConnected();
+    xEventGroupClearBits(_eventGroup, WM_EVT_GOT_IP | WM_EVT_DISCONNECTED);
     esp_wifi_disconnect();
-    vTaskDelay(pdMS_TO_TICKS(100));
+    if (was_connected) {
+        waitForEvents(WM_EVT_DISCONNECTED, esp_timer_get_time() + 1000000LL);
+    }
     
     // Attempt to connect
+    xEventGroupClearBits(_eventGroup, WM_EVT_GOT_IP | WM_EVT_DISCONNECTED);
     ret = esp_wifi_connect();
     if (ret != ESP_OK) {
         WM_LOGE("❌ Failed to initiate WiFi connection: %s", esp_err_to_name(ret));
@@ -193,38 +340,25 @@ bool WiFiManager::reconnectWiFi(uint32_t timeoutSeconds) {
     
     WM_LOGI("📡 WiFi connection attempt initiated for SSID: %s", wifi_config.sta.ssid);
     
-    // Wait for connection result
-    const uint32_t timeout_ms = timeoutSeconds * 1000;
-    const int check_interval_ms = 250;
-    uint32_t elapsed_ms = 0;
+    // Block until the event handlers report the outcome
+    EventBits_t bits = waitForEvents(WM_EVT_GOT_IP | WM_EVT_DISCONNECTED,
+                                     esp_timer_get_time() + timeoutSeconds * 1000000LL);
     
-    while (elapsed_ms < timeout_ms) {
-        // Check if we're connected
-        if (isWiFiConnected()) {
-            WM_LOGI("✅ WiFi reconnection successful!");
-            return true;
-        }
-        
-        // Check if connection failed
-        if (_lastConxResult == WL_WRONG_PASSWORD) {
+    if (bits & WM_EVT_GOT_IP) {
+        WM_LOGI("✅ WiFi reconnection successful!");
+        return true;
+    }
+    
+    if (bits & WM_EVT_DISCONNECTED) {
+        wl_status_t result = getLastConxResult();
+        if (result == WL_WRONG_PASSWORD) {
             WM_LOGE("❌ WiFi reconnection failed: Wrong password");
-            return false;
-        } else if (_lastConxResult == WL_NO_SSID_AVAIL) {
+        } else if (result == WL_NO_SSID_AVAIL) {
             WM_LOGE("❌ WiFi reconnection failed: Network not found");
-            return false;
-        } else if (_lastConxResult == WL_CONNECT_FAILED) {
+        } else {
             WM_LOGE("❌ WiFi reconnection failed: Connection error");
-            return false;
-        }
-        
-        // Wait before next check
-        vTaskDelay(pdMS_TO_TICKS(check_interval_ms));
-        elapsed_ms += check_interval_ms;
-        
-        // Log progress every 2.5 seconds
-        if (elapsed_ms % 2500 == 0) {
-            WM_LOGD("⏱️  Waiting for WiFi connection... (%lu/%lu seconds)", elapsed_ms/1000, timeout_ms/1000);
         }
+        return false;
     }
     
     WM_LOGE("❌ WiFi reconnection failed: Timeout after %lu seconds", timeoutSeconds);
@@ -241,12 +375,14 @@ bool WiFiManager::autoConnect(const char* apName) {
 }
 
 bool WiFiManager::autoConnect(const char* apName, const char* apPassword) {
-    std::lock_guard<std::mutex> lock(_mutex);
+    // Held while configuring only; waits run unlocked so other tasks aren't stalled
+    std::unique_lock<std::mutex> lock(_mutex);
     
     WM_LOGI("AutoConnect called with AP: %s", apName ? apName : "null");
     
     // Initialize if not already done
     init();
+    restoreStore();
     
     if (apName) {
         _apName = apName;
@@ -255,9 +391,9 @@ bool WiFiManager::autoConnect(const char* apName, const char* apPassword) {
         _apPassword = apPassword;
     }
     
-    _state = WM_STATE_INIT;
+    setState(WM_STATE_INIT);
     _portalAbortResult = false;
-    _lastConxResult = WL_IDLE_STATUS;
+    setLastConxResult(WL_IDLE_STATUS);
     
     // Setup WiFi
     if (!setupWiFi()) {
@@ -266,19 +402,19 @@ bool WiFiManager::autoConnect(const char* apName, const char* apPassword) {
     }
     
     // First, try to connect using saved credentials
+    xEventGroupClearBits(_eventGroup, WM_EVT_GOT_IP | WM_EVT_DISCONNECTED);
+    setState(WM_STATE_TRY_STA);
+    beginConnectAttempt();
     if (getWiFiIsSaved() && startSTA()) {
-        _state = WM_STATE_TRY_STA;
-        _connectStart = esp_timer_get_time();
-        
         if (_configPortalBlocking) {
-            // Wait for connection or timeout
-            while (_state == WM_STATE_TRY_STA) {
-                updateState();
-                vTaskDelay(pdMS_TO_TICKS(100));
-                
-                if (esp_timer_get_time() - _connectStart > _connectTimeout) {
-                    WM_LOGW("STA connection timeout");
-                    break;
+            // Wait for GOT_IP, a disconnect or the connect deadline
+            lock.unlock();
+            EventBits_t bits = waitForEvents(WM_EVT_GOT_IP | WM_EVT_DISCONNECTED,
+                                             _connectStart + _connectTimeout);
+            if (!bits) {
+                WM_LOGW("STA connection timeout");
+                if (transitionState(WM_STATE_TRY_STA, WM_STATE_START_PORTAL)) {
+                    setLastConxResult(WL_CONNECT_FAILED);
                 }
             }
             
@@ -292,19 +428,39 @@ bool WiFiManager::autoConnect(const char* apName, const char* apPassword) {
         }
     }
     
+    // Last network not reachable, try the other stored ones strongest first
+    if (_configPortalBlocking) {
+        if (lock.owns_lock()) {
+            lock.unlock();
+        }
+        std::string lastSSID = getSSID();
+        if (connectToStoredNetworks(lastSSID.c_str())) {
+            WM_LOGI("AutoConnect successful");
+            return true;
+        }
+    }
+    
     // STA failed or no saved credentials, start config portal
     WM_LOGI("Starting config portal");
-    bool portalResult = startConfigPortalInternal(_apName.c_str(), _apPassword.empty() ? nullptr : _apPassword.c_str());
+    if (!lock.owns_lock()) {
+        lock.lock();
+    }
+    bool portalResult = startConfigPortalInternal(_apName.c_str(), _apPassword.empty() ? nullptr : _apPassword.c_str(),
+                                                  lock);
     
     // If successful connection via portal, switch to STA-only mode
     if (portalResult && _state == WM_STATE_RUN_STA) {
         WM_LOGI("🎉 WiFi connected successfully! Switching to STA-only mode...");
         
-        // Switch to STA-only mode (servers remain running for manual control)
+        // Switch to STA-only mode (HTTP server remains running for manual control).
+        // Without the AP nobody can reach the DNS responder, so its task goes too.
+#if WM_PROVISION_HTTP
+        stopDNSServer();
+#endif
         esp_err_t ret = esp_wifi_set_mode(WIFI_MODE_STA);
         if (ret == ESP_OK) {
             WM_LOGI("✅ Successfully switched to STA-only mode");
-            WM_LOGI("💡 Servers still running - call stopServers() manually to stop them");
+            WM_LOGI("💡 HTTP server still running - call startWebPortal() to keep it or stopServers() to stop it");
         } else {
             WM_LOGW("⚠️ Failed to switch to STA mode: %s", esp_err_to_name(ret));
         }
@@ -314,25 +470,27 @@ bool WiFiManager::autoConnect(const char* apName, const char* apPassword) {
 }
 
 bool WiFiManager::startConfigPortal() {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return startConfigPortalInternal(_apName.c_str(), _apPassword.empty() ? nullptr : _apPassword.c_str());
+    std::unique_lock<std::mutex> lock(_mutex);
+    return startConfigPortalInternal(_apName.c_str(), _apPassword.empty() ? nullptr : _apPassword.c_str(), lock);
 }
 
 bool WiFiManager::startConfigPortal(const char* apName) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return startConfigPortalInternal(apName, nullptr);
+    std::unique_lock<std::mutex> lock(_mutex);
+    return startConfigPortalInternal(apName, nullptr, lock);
 }
 
 bool WiFiManager::startConfigPortal(const char* apName, const char* apPassword) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return startConfigPortalInternal(apName, apPassword);
+    std::unique_lock<std::mutex> lock(_mutex);
+    return startConfigPortalInternal(apName, apPassword, lock);
 }
 
-bool WiFiManager::startConfigPortalInternal(const char* apName, const char* apPassword) {
+bool WiFiManager::startConfigPortalInternal(const char* apName, const char* apPassword,
+                                            std::unique_lock<std::mutex>& lock) {
     WM_LOGI("StartConfigPortal called with AP: %s", apName ? apName : "null");
     
     // Initialize if not already done
     init();
+    restoreStore();
     
     if (apName) {
         _apName = apName;
@@ -341,9 +499,10 @@ bool WiFiManager::startConfigPortalInternal(const char* apName, const char* apPa
         _apPassword = apPassword;
     }
     
-    _state = WM_STATE_START_PORTAL;
+    setState(WM_STATE_START_PORTAL);
     _portalAbortResult = false;
     _configPortalStart = esp_timer_get_time();
+    xEventGroupClearBits(_eventGroup, WM_EVT_SAVED | WM_EVT_ABORT);
     
     WM_LOGI("🔧 Setting up WiFi subsystem...");
     // Setup WiFi if not already done
@@ -359,6 +518,10 @@ bool WiFiManager::startConfigPortalInternal(const char* apName, const char* apPa
         return false;
     }
     
+#if WM_PROVISION_HTTP
+    // Decide on a lean portal now that the AP has taken its share of the heap
+    checkPortalHeap();
+    
     WM_LOGI("🌐 Starting HTTP server...");
     // Start HTTP server
     if (!startHTTPServer()) {
@@ -371,8 +534,19 @@ bool WiFiManager::startConfigPortalInternal(const char* apName, const char* apPa
     if (_captivePortalEnable && !startDNSServer()) {
         WM_LOGW("⚠️  Failed to start DNS server");
     }
+#else
+    if (!startProvisionServer()) {
+        WM_LOGE("❌ Failed to start provisioning server");
+        return false;
+    }
+#endif
     
-    _state = WM_STATE_RUN_PORTAL;
+    setState(WM_STATE_RUN_PORTAL);
+    
+    // Warm the scan cache so the first /scan request has results
+    if (_preloadScan && !isPortalLean()) {
+        performWiFiScan(true);
+    }
     
     // Trigger AP callback
     if (_apCallback) {
@@ -381,19 +555,39 @@ bool WiFiManager::startConfigPortalInternal(const char* apName, const char* apPa
     
     WM_LOGI("✅ Config portal started successfully!");
     WM_LOGI("📱 Connect to WiFi network: %s", _apName.c_str());
-    WM_LOGI("🌐 Open browser to: http://192.168.4.1");
+#if WM_PROVISION_HTTP
+    WM_LOGI("🌐 Open browser to: http://" IPSTR, IP2STR(&_apIP));
+#else
+    WM_LOGI("📲 Provisioning on udp://" IPSTR ":%d", IP2STR(&_apIP), WM_PROVISION_PORT);
+#endif
     
     if (_configPortalBlocking) {
-        // Blocking mode - wait for completion
+        // Blocking mode - sleep until an event handler or a deadline moves the state on.
+        // Everything below goes through atomics and the event group, so other tasks can
+        // call in (process(), stopServers(), ...) while the portal runs.
+        lock.unlock();
+        const EventBits_t wait_bits = WM_EVT_GOT_IP | WM_EVT_DISCONNECTED | WM_EVT_SAVED | WM_EVT_ABORT;
         while (_state == WM_STATE_RUN_PORTAL || _state == WM_STATE_TRY_STA) {
+            int64_t deadline = _configPortalTimeout > 0 ? _configPortalStart + _configPortalTimeout : 0;
+            if (_state == WM_STATE_TRY_STA) {
+                int64_t connect_deadline = _connectStart + _connectTimeout;
+                if (deadline == 0 || connect_deadline < deadline) {
+                    deadline = connect_deadline;
+                }
+            }
+            waitForEvents(wait_bits, deadline);
             updateState();
-            vTaskDelay(pdMS_TO_TICKS(100));
+            
+            // A failed attempt from the portal keeps the portal serving
+            if (transitionState(WM_STATE_START_PORTAL, WM_STATE_RUN_PORTAL)) {
+                WM_LOGW("Connection attempt failed, portal still running");
+            }
             
             // Check for timeout
             if (_configPortalTimeout > 0 && 
                 esp_timer_get_time() - _configPortalStart > _configPortalTimeout) {
                 WM_LOGW("Config portal timeout");
-                _state = WM_STATE_PORTAL_TIMEOUT;
+                setState(WM_STATE_PORTAL_TIMEOUT);
                 break;
             }
         }
@@ -418,28 +612,57 @@ void WiFiManager::startWebPortal() {
     
     WM_LOGI("Starting web portal");
     
-    if (!startHTTPServer()) {
+#if WM_PROVISION_HTTP
+    // Once connected the portal rides on the STA link: no softAP beaconing on the
+    // station's channel and no DNS task, so the radio stays with the uplink
+    bool staOnly = _state == WM_STATE_RUN_STA;
+    if (staOnly) {
+        stopDNSServer();
+        wifi_mode_t mode;
+        if (esp_wifi_get_mode(&mode) == ESP_OK && mode == WIFI_MODE_APSTA) {
+            esp_err_t ret = esp_wifi_set_mode(WIFI_MODE_STA);
+            if (ret != ESP_OK) {
+                WM_LOGW("⚠️ Failed to switch to STA mode: %s", esp_err_to_name(ret));
+            }
+        }
+    }
+    
+    checkPortalHeap();
+    if (!startHTTPServer(staOnly)) {
         WM_LOGE("Failed to start web portal HTTP server");
         return;
     }
+#else
+    // The provisioning socket listens on every interface, the STA link included
+    bool staOnly = _state == WM_STATE_RUN_STA;
+    if (!startProvisionServer()) {
+        WM_LOGE("Failed to start provisioning server");
+        return;
+    }
+#endif
     
+    applyPowerProfile();
     if (_webServerModeCallback) {
         _webServerModeCallback();
     }
     
-    WM_LOGI("Web portal started");
+    WM_LOGI("Web portal started%s", staOnly ? " on the STA interface" : "");
 }
 
 void WiFiManager::stopWebPortal() {
     std::lock_guard<std::mutex> lock(_mutex);
     
     WM_LOGI("Stopping web portal");
+#if WM_PROVISION_HTTP
     stopHTTPServer();
+#else
+    stopProvisionServer();
+#endif
+    applyPowerProfile();
 }
 
 bool WiFiManager::process() {
-    std::lock_guard<std::mutex> lock(_mutex);
-    
+    // No _mutex: updateState() only makes CAS transitions, so this never waits on a blocking call
     updateState();
     
     // Return true if still processing, false if finished
@@ -476,6 +699,10 @@ void WiFiManager::setSaveConfigCallback(SaveConfigCallback callback) {
     _saveConfigCallback = callback;
 }
 
+void WiFiManager::setReconnectCallback(ReconnectCallback callback) {
+    _reconnectCallback = callback;
+}
+
 void WiFiManager::setConfigModeCallback(ConfigModeCallback callback) {
     _configModeCallback = callback;
 }
@@ -490,61 +717,97 @@ bool WiFiManager::isConfigPortalActive() const {
 }
 
 bool WiFiManager::isWebPortalActive() const {
+#if WM_PROVISION_HTTP
     return _httpServer != nullptr;
+#else
+    return _provisionRunning;
+#endif
+}
+
+bool WiFiManager::isPortalLean() const {
+#if WM_PROVISION_HTTP
+    return _portalLean;
+#else
+    return false;
+#endif
 }
 
 wl_status_t WiFiManager::getLastConxResult() const {
-    return _lastConxResult;
+    return _status.read().lastResult;
 }
 
 // WiFi management implementations
 bool WiFiManager::setupWiFi() {
+    // NVS, netif and the event loop are brought up once by init()
+    if (_wifiInitialized && _wifiEventHandler && _ipEventHandler) {
+        return true;
+    }
+    
     WM_LOGD("Setting up WiFi subsystem");
+    WM_METRIC_PHASE(_metrics, WM_PHASE_WIFI_SETUP);
     
-    // Initialize NVS if not already done
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-
-    // Create default network interfaces if not already created
-    if (!_apNetif) {
-        _apNetif = esp_netif_create_default_wifi_ap();
+    // Only the STA interface is needed to connect, the AP one is created with the portal.
+    // The default netifs are process-wide, another manager instance may own them already.
+    if (!_staNetif) {
+        _staNetif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
     }
     if (!_staNetif) {
         _staNetif = esp_netif_create_default_wifi_sta();
-    }
-    
-    if (!_apNetif || !_staNetif) {
-        WM_LOGE("Failed to create network interfaces");
-        return false;
+        if (!_staNetif) {
+            WM_LOGE("Failed to create STA network interface");
+            return false;
+        }
     }
 
-    // Initialize WiFi with default configuration
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-    
-    // Set WiFi storage to flash for persistent credentials
-    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
+    if (!_wifiInitialized) {
+        // Initialize WiFi with default configuration
+        wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+        ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+        
+        // Set WiFi storage to flash for persistent credentials
+        ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
+        _wifiInitialized = true;
+    }
     
     // Register event handlers
-    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, 
-                                      &WiFiManager::wifiEventHandler, this, &_wifiEventHandler);
-    esp_event_handler_instance_register(IP_EVENT, ESP_EVENT_ANY_ID,
-                                      &WiFiManager::ipEventHandler, this, &_ipEventHandler);
+    if (!_wifiEventHandler) {
+        esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, 
+                                          &WiFiManager::wifiEventHandler, this, &_wifiEventHandler);
+    }
+    if (!_ipEventHandler) {
+        esp_event_handler_instance_register(IP_EVENT, ESP_EVENT_ANY_ID,
+                                          &WiFiManager::ipEventHandler, this, &_ipEventHandler);
+    }
+    
+    WM_LOGI("WiFi subsystem initialized");
+    return true;
+}
+
+bool WiFiManager::setupAPNetif() {
+    if (!_apNetif) {
+        _apNetif = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    }
+    if (!_apNetif) {
+        _apNetif = esp_netif_create_default_wifi_ap();
+        if (!_apNetif) {
+            WM_LOGE("Failed to create AP network interface");
+            return false;
+        }
+    }
     
-    // Configure default AP IP
+    // Configure AP IP, Kconfig defaults unless setAPStaticIPConfig() was called
+    if (!_apStaticIPSet) {
+        esp_netif_str_to_ip4(CONFIG_WM_AP_IP, (esp_ip4_addr_t*)&_apIP);
+        esp_netif_str_to_ip4(CONFIG_WM_AP_GW, (esp_ip4_addr_t*)&_apGW);
+        esp_netif_str_to_ip4(CONFIG_WM_AP_NETMASK, (esp_ip4_addr_t*)&_apNetmask);
+    }
     esp_netif_dhcps_stop(_apNetif);
     esp_netif_ip_info_t ip_info;
-    esp_netif_str_to_ip4(CONFIG_WM_AP_IP, &ip_info.ip);
-    esp_netif_str_to_ip4(CONFIG_WM_AP_GW, &ip_info.gw); 
-    esp_netif_str_to_ip4(CONFIG_WM_AP_NETMASK, &ip_info.netmask);
+    ip_info.ip.addr = _apIP.addr;
+    ip_info.gw.addr = _apGW.addr;
+    ip_info.netmask.addr = _apNetmask.addr;
     ESP_ERROR_CHECK(esp_netif_set_ip_info(_apNetif, &ip_info));
     ESP_ERROR_CHECK(esp_netif_dhcps_start(_apNetif));
-    
-    WM_LOGI("WiFi subsystem initialized");
     return true;
 }
 
@@ -552,7 +815,22 @@ bool WiFiManager::startSTA() {
     WM_LOGD("Starting STA mode");
     
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    
+    // Point the driver at the last known BSSID/channel before it starts
+    _connectMetrics = {};
+    applyFastConnect();
+    wifi_config_t wifi_config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+        // Only write the config back (and to NVS) when something changed
+        wifi_config_t wanted = wifi_config;
+        applyStaConfig(wanted);
+        if (memcmp(&wanted, &wifi_config, sizeof(wifi_config)) != 0) {
+            esp_wifi_set_config(WIFI_IF_STA, &wanted);
+        }
+    }
+    
     ESP_ERROR_CHECK(esp_wifi_start());
+    applyPowerProfile();
     
     // Trigger connection attempt with saved credentials
     esp_err_t ret = esp_wifi_connect();
@@ -566,12 +844,17 @@ bool WiFiManager::startSTA() {
 
 bool WiFiManager::startAP(const char* ssid, const char* password) {
     WM_LOGI("🚀 Starting AP mode: %s", ssid);
+    WM_METRIC_PHASE(_metrics, WM_PHASE_AP_START);
+    
+    if (!setupAPNetif()) {
+        return false;
+    }
     
     // Configure AP
     wifi_config_t wifi_config = {};
     strncpy((char*)wifi_config.ap.ssid, ssid, sizeof(wifi_config.ap.ssid) - 1);
     wifi_config.ap.ssid_len = strlen(ssid);
-    wifi_config.ap.channel = WM_DEFAULT_AP_CHANNEL;
+    wifi_config.ap.channel = _powerConfig.autoAPChannel ? pickAPChannel() : WM_DEFAULT_AP_CHANNEL;
     wifi_config.ap.max_connection = 4;
     wifi_config.ap.beacon_interval = 100;
     
@@ -585,6 +868,10 @@ bool WiFiManager::startAP(const char* ssid, const char* password) {
     }
     
     WM_LOGI("🔧 Setting WiFi mode to AP...");
+    wifi_mode_t previous_mode = WIFI_MODE_NULL;
+    esp_wifi_get_mode(&previous_mode);
+    bool ap_running = previous_mode == WIFI_MODE_AP || previous_mode == WIFI_MODE_APSTA;
+    xEventGroupClearBits(_eventGroup, WM_EVT_AP_START);
     esp_err_t ret = esp_wifi_set_mode(WIFI_MODE_AP);
     if (ret != ESP_OK) {
         WM_LOGE("❌ Failed to set WiFi mode: %s", esp_err_to_name(ret));
@@ -605,13 +892,20 @@ bool WiFiManager::startAP(const char* ssid, const char* password) {
         return false;
     }
     
-    // Wait a bit for AP to fully start
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    // Continue as soon as the driver reports the AP up (no event if it already was)
+    EventBits_t bits = ap_running ? WM_EVT_AP_START :
+        xEventGroupWaitBits(_eventGroup, WM_EVT_AP_START, pdTRUE, pdFALSE,
+                            pdMS_TO_TICKS(WM_AP_START_TIMEOUT_MS));
+    if (!(bits & WM_EVT_AP_START)) {
+        WM_LOGW("⚠️  No AP start event after %d ms, continuing", WM_AP_START_TIMEOUT_MS);
+    }
+    
+    applyPowerProfile();
     
     WM_LOGI("✅ AP started successfully!");
     WM_LOGI("📡 SSID: %s", ssid);
-    WM_LOGI("🔢 Channel: %d", WM_DEFAULT_AP_CHANNEL);
-    WM_LOGI("🌐 IP: 192.168.4.1");
+    WM_LOGI("🔢 Channel: %d", wifi_config.ap.channel);
+    WM_LOGI("🌐 IP: " IPSTR, IP2STR(&_apIP));
     
     return true;
 }
@@ -621,216 +915,1676 @@ void WiFiManager::stopWiFi() {
     esp_wifi_stop();
 }
 
-bool WiFiManager::startHTTPServer() {
-    WM_LOGD("Starting HTTP server");
-    
-    if (_httpServer != nullptr) {
-        WM_LOGW("HTTP server already running");
-        return true;
+// Fast reconnect cache
+
+#define WM_FAST_CONNECT_KEY "fastconn"
+#define WM_FAST_CONNECT_VERSION 1
+
+void WiFiManager::setFastReconnect(bool enable, bool reuseIP) {
+    _fastConnectEnabled = enable;
+    _fastConnectReuseIP = enable && reuseIP;
+    WM_LOGD("Fast reconnect set to %s (reuse IP: %s)", enable ? "true" : "false",
+            _fastConnectReuseIP ? "true" : "false");
+}
+
+wm_connect_metrics_t WiFiManager::getConnectMetrics() const {
+    return _connectMetrics;
+}
+
+wm_metrics_t WiFiManager::getMetrics() const {
+    wm_metrics_t metrics = {};
+#if WM_ENABLE_METRICS
+    _metrics.snapshot(metrics);
+#endif
+    return metrics;
+}
+
+bool WiFiManager::startLoadTest(const wm_load_test_config_t& config) {
+#if WM_ENABLE_LOAD_TEST
+    if (!_httpServer && !_dnsRunning) {
+        WM_LOGE("Load test needs the config portal running");
+        return false;
     }
+    if (!_loadTest) {
+        _loadTest.reset(new WMLoadTest(_metrics, WM_HTTP_PORT, WM_DNS_PORT));
+    }
+    return _loadTest->start(config);
+#else
+    WM_LOGW("Load test not compiled in, enable CONFIG_WM_ENABLE_LOAD_TEST");
+    return false;
+#endif
+}
+
+void WiFiManager::stopLoadTest() {
+#if WM_ENABLE_LOAD_TEST
+    if (_loadTest) {
+        _loadTest->stop();
+    }
+#endif
+}
+
+bool WiFiManager::isLoadTestRunning() const {
+#if WM_ENABLE_LOAD_TEST
+    return _loadTest && _loadTest->isRunning();
+#else
+    return false;
+#endif
+}
+
+bool WiFiManager::loadFastConnect() {
+    if (_fastConnectLoaded) {
+        return _fastConnect.version == WM_FAST_CONNECT_VERSION;
+    }
+    _fastConnectLoaded = true;
+    memset(&_fastConnect, 0, sizeof(_fastConnect));
     
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.server_port = WM_HTTP_PORT;
-    config.max_open_sockets = 7;
-    config.stack_size = CONFIG_WM_HTTP_STACK_SIZE;
-    config.max_uri_handlers = 12; // Increase handler limit
-    config.recv_wait_timeout = 60; // Increase receive timeout to 60 seconds
-    config.send_wait_timeout = 60; // Increase send timeout to 60 seconds  
-    config.uri_match_fn = httpd_uri_match_wildcard; // Enable wildcard URI matching
-    config.global_user_ctx = this; // Store WiFiManager instance for handlers
-    
-    esp_err_t ret = httpd_start(&_httpServer, &config);
-    if (ret != ESP_OK) {
-        WM_LOGE("Failed to start HTTP server: %s", esp_err_to_name(ret));
+    nvs_handle_t nvs;
+    if (nvs_open(WM_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
         return false;
     }
+    size_t len = sizeof(_fastConnect);
+    esp_err_t ret = nvs_get_blob(nvs, WM_FAST_CONNECT_KEY, &_fastConnect, &len);
+    nvs_close(nvs);
     
-    // Register URI handlers
-    httpd_uri_t root_uri = {
-        .uri = "/",
-        .method = HTTP_GET,
-        .handler = handleRoot,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &root_uri);
-    
-    httpd_uri_t scan_uri = {
-        .uri = "/scan",
-        .method = HTTP_GET,
-        .handler = handleScan,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &scan_uri);
-    
-    httpd_uri_t wifisave_uri = {
-        .uri = "/wifisave",
-        .method = HTTP_POST,
-        .handler = handleWifiSave,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &wifisave_uri);
-    
-    httpd_uri_t info_uri = {
-        .uri = "/info",
-        .method = HTTP_GET,
-        .handler = handleInfo,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &info_uri);
+    if (ret != ESP_OK || len != sizeof(_fastConnect) || _fastConnect.version != WM_FAST_CONNECT_VERSION) {
+        memset(&_fastConnect, 0, sizeof(_fastConnect));
+        return false;
+    }
+    return true;
+}
+
+bool WiFiManager::applyFastConnect() {
+    _fastConnectActive = false;
     
-    httpd_uri_t exit_uri = {
-        .uri = "/exit",
-        .method = HTTP_GET,
-        .handler = handleExit,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &exit_uri);
-    
-    // Captive portal detection handlers
-    httpd_uri_t generate_204_uri = {
-        .uri = "/generate_204",
-        .method = HTTP_GET,
-        .handler = handleCaptivePortal,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &generate_204_uri);
+    wifi_config_t wifi_config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+        return false;
+    }
     
-    httpd_uri_t hotspot_detect_uri = {
-        .uri = "/hotspot-detect.html",
-        .method = HTTP_GET,
-        .handler = handleCaptivePortal,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &hotspot_detect_uri);
+    bool usable = _fastConnectEnabled && loadFastConnect() &&
+                  memcmp(wifi_config.sta.ssid, _fastConnect.ssid, sizeof(wifi_config.sta.ssid)) == 0;
+    if (!usable) {
+        // Don't leave a stale directed config from an earlier boot in the driver
+        if (wifi_config.sta.bssid_set) {
+            wifi_config.sta.bssid_set = false;
+            wifi_config.sta.channel = 0;
+            wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        }
+        return false;
+    }
     
-    httpd_uri_t ncsi_uri = {
-        .uri = "/ncsi.txt",
-        .method = HTTP_GET,
-        .handler = handleCaptivePortal,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &ncsi_uri);
+    memcpy(wifi_config.sta.bssid, _fastConnect.bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.bssid_set = true;
+    wifi_config.sta.channel = _fastConnect.channel;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    if (esp_wifi_set_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+        return false;
+    }
     
-    httpd_uri_t fwlink_uri = {
-        .uri = "/fwlink",
-        .method = HTTP_GET,
-        .handler = handleCaptivePortal,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &fwlink_uri);
-    
-    // Add /wifi route (configure page)
-    httpd_uri_t wifi_uri = {
-        .uri = "/wifi",
-        .method = HTTP_GET,
-        .handler = handleWifi,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &wifi_uri);
-    
-    // Add /status route (connection status JSON)
-    httpd_uri_t status_uri = {
-        .uri = "/status",
-        .method = HTTP_GET,
-        .handler = handleStatus,
-        .user_ctx = this
-    };
-    httpd_register_uri_handler(_httpServer, &status_uri);
+    if (_fastConnectReuseIP && _fastConnect.ip != 0 && _staNetif) {
+        esp_netif_ip_info_t ip_info = {};
+        ip_info.ip.addr = _fastConnect.ip;
+        ip_info.gw.addr = _fastConnect.gw;
+        ip_info.netmask.addr = _fastConnect.netmask;
+        if (esp_netif_dhcpc_stop(_staNetif) == ESP_OK &&
+            esp_netif_set_ip_info(_staNetif, &ip_info) == ESP_OK) {
+            _connectMetrics.cachedIP = true;
+            WM_LOGI("⚡ Reusing cached IP: " IPSTR, IP2STR(&ip_info.ip));
+        } else {
+            esp_netif_dhcpc_start(_staNetif);
+        }
+    }
     
-    WM_LOGI("HTTP server started on port %d", config.server_port);
+    _fastConnectActive = true;
+    _connectMetrics.fastConnect = true;
+    WM_LOGI("⚡ Directed connect to " MACSTR " on channel %d", 
+            MAC2STR(_fastConnect.bssid), _fastConnect.channel);
     return true;
 }
 
-void WiFiManager::stopHTTPServer() {
-    if (_httpServer) {
-        WM_LOGI("🛑 Stopping HTTP server...");
-        
-        esp_err_t ret = httpd_stop(_httpServer);
-        if (ret == ESP_OK) {
-            WM_LOGI("✅ HTTP server stopped successfully");
-            _httpServer = nullptr;
-        } else {
-            WM_LOGW("⚠️ Error stopping HTTP server: %s", esp_err_to_name(ret));
-            _httpServer = nullptr;  // Clear handle anyway to prevent issues
+bool WiFiManager::applyScannedAP(wifi_config_t& config) {
+    wifi_ap_record_t ap;
+    {
+        std::lock_guard<std::mutex> lock(_scanMutex);
+        const wifi_ap_record_t* found = _scanTables[_scanFront].find((const char*)config.sta.ssid);
+        if (!found) {
+            return false;
         }
-    } else {
-        WM_LOGD("HTTP server already stopped");
+        ap = *found;
     }
-}
-
-
-
-bool WiFiManager::startDNSServer() {
-    WM_LOGD("Starting DNS server");
     
-    if (_dnsRunning) {
-        WM_LOGW("DNS server already running");
-        return true;
+    // The portal's own scan already located the AP, skip the driver's connect scan
+    memcpy(config.sta.bssid, ap.bssid, sizeof(config.sta.bssid));
+    config.sta.bssid_set = true;
+    config.sta.channel = ap.primary;
+    config.sta.scan_method = WIFI_FAST_SCAN;
+    config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    
+    // Refuse anything weaker than what was advertised; WPA3 modes stay at WPA2 so
+    // transition-mode APs aren't forced onto SAE
+    wifi_auth_mode_t authmode = ap.authmode;
+    if (authmode == WIFI_AUTH_WPA3_PSK || authmode == WIFI_AUTH_WPA2_WPA3_PSK) {
+        authmode = WIFI_AUTH_WPA2_PSK;
     }
+    config.sta.threshold.authmode = authmode;
     
-    _dnsRunning = true;
+    WM_LOGI("⚡ Directed connect to scanned " MACSTR " on channel %d", MAC2STR(ap.bssid), ap.primary);
+    return true;
+}
+
+void WiFiManager::fallbackFromFastConnect() {
+    WM_LOGW("⚠️  Directed connect failed, retrying with full scan");
+    _fastConnectActive = false;
+    _connectMetrics.fastConnectFallback = true;
     
-    BaseType_t ret = xTaskCreate(dnsServerTask, "dns_server", 
-                                CONFIG_WM_DNS_STACK_SIZE, this, 5, &_dnsTaskHandle);
+    wifi_config_t wifi_config = {};
+    bool cachedTarget = false;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+        cachedTarget = memcmp(wifi_config.sta.bssid, _fastConnect.bssid, sizeof(_fastConnect.bssid)) == 0;
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    }
     
-    if (ret != pdPASS) {
-        WM_LOGE("Failed to create DNS server task");
-        _dnsRunning = false;
-        return false;
+    if (_connectMetrics.cachedIP && _staNetif) {
+        esp_netif_dhcpc_start(_staNetif);
+        _connectMetrics.cachedIP = false;
     }
     
-    WM_LOGI("DNS server started");
-    return true;
+    // The cache is stale, it gets rewritten once the full connect succeeds
+    if (cachedTarget) {
+        clearFastConnect();
+    }
+    esp_wifi_connect();
 }
 
-void WiFiManager::stopDNSServer() {
-    if (!_dnsRunning) {
-        WM_LOGD("DNS server already stopped");
+void WiFiManager::saveFastConnect(const esp_netif_ip_info_t& ip_info) {
+    wifi_ap_record_t ap_info;
+    wifi_config_t wifi_config = {};
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK ||
+        esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
         return;
     }
     
-    WM_LOGI("🛑 Stopping DNS server...");
-    _dnsRunning = false;
+    FastConnectCache cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.version = WM_FAST_CONNECT_VERSION;
+    memcpy(cache.ssid, wifi_config.sta.ssid, sizeof(cache.ssid));
+    memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+    cache.channel = ap_info.primary;
+    cache.ip = ip_info.ip.addr;
+    cache.gw = ip_info.gw.addr;
+    cache.netmask = ip_info.netmask.addr;
+    
+    // Only touch flash when something changed
+    loadFastConnect();
+    if (memcmp(&cache, &_fastConnect, sizeof(cache)) == 0) {
+        return;
+    }
     
-    // Close socket to wake up task
-    if (_dnsSocket >= 0) {
-        close(_dnsSocket);
-        _dnsSocket = -1;
+    nvs_handle_t nvs;
+    if (nvs_open(WM_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        WM_LOGW("Failed to open NVS for fast reconnect cache");
+        return;
+    }
+    if (nvs_set_blob(nvs, WM_FAST_CONNECT_KEY, &cache, sizeof(cache)) == ESP_OK &&
+        nvs_commit(nvs) == ESP_OK) {
+        _fastConnect = cache;
+        WM_LOGD("Fast reconnect cache updated: " MACSTR " ch %d", MAC2STR(cache.bssid), cache.channel);
+    }
+    nvs_close(nvs);
+}
+
+// Persistent store: credentials and custom parameter values in one NVS blob
+
+#define WM_STORE_KEY "config"
+#define WM_STORE_VERSION 1
+#define WM_CREDENTIALS_VERSION 1
+#define WM_CREDENTIALS_FLUSH_SUCCESSES 8    // Reconnects counted in RAM before the counters are written
+
+// Blob layout: StoreHeader, CredentialStore, then one ParamRecord, id bytes and value bytes per parameter
+struct StoreHeader {
+    uint8_t version;
+    uint8_t paramCount;
+    uint16_t paramBytes;
+    uint32_t crc;               // CRC32 of everything after the header
+};
+
+struct ParamRecord {
+    uint32_t idHash;            // WMFormParser::hashKey() of the parameter id
+    uint16_t length;
+    uint8_t idLength;
+    uint8_t reserved;
+};
+
+bool WiFiManager::loadStore() {
+    bool paramsPending = WM_PERSIST_PARAMS && _paramsRestored < _paramsCount;
+    if (_credStoreLoaded && !paramsPending) {
+        return true;
     }
     
-    // Wait for task to finish
-    int timeout = 50; // 5 seconds
-    while (_dnsTaskHandle && timeout-- > 0) {
-        vTaskDelay(pdMS_TO_TICKS(100));
+    nvs_handle_t nvs;
+    bool opened = nvs_open(WM_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK;
+    
+    // One read of the whole blob, validated before anything is taken from it
+    std::unique_ptr<uint8_t[]> blob;
+    StoreHeader header = {};
+    size_t len = 0;
+    if (opened && nvs_get_blob(nvs, WM_STORE_KEY, nullptr, &len) == ESP_OK &&
+        len >= sizeof(StoreHeader) + sizeof(CredentialStore) &&
+        len <= sizeof(StoreHeader) + sizeof(CredentialStore) + WM_STORE_MAX_PARAM_BYTES) {
+        blob.reset(new (std::nothrow) uint8_t[len]);
+        if (blob && nvs_get_blob(nvs, WM_STORE_KEY, blob.get(), &len) == ESP_OK) {
+            memcpy(&header, blob.get(), sizeof(header));
+        }
+    }
+    bool valid = header.version == WM_STORE_VERSION &&
+                 len == sizeof(StoreHeader) + sizeof(CredentialStore) + header.paramBytes &&
+                 esp_rom_crc32_le(0, blob.get() + sizeof(header), len - sizeof(header)) == header.crc;
+    if (blob && !valid) {
+        WM_LOGW("Stored configuration is invalid, ignoring it");
     }
     
-    if (_dnsTaskHandle) {
-        WM_LOGW("DNS task did not terminate gracefully, deleting");
-        vTaskDelete(_dnsTaskHandle);
-        _dnsTaskHandle = nullptr;
+    if (!_credStoreLoaded) {
+        _credStoreLoaded = true;
+        memset(&_credStore, 0, sizeof(_credStore));
+        if (valid) {
+            memcpy(&_credStore, blob.get() + sizeof(header), sizeof(_credStore));
+        }
+        if (_credStore.version != WM_CREDENTIALS_VERSION || _credStore.count > WM_MAX_CREDENTIALS) {
+            memset(&_credStore, 0, sizeof(_credStore));
+        }
+        WM_LOGD("Loaded %d stored networks", _credStore.count);
+    }
+    if (opened) {
+        nvs_close(nvs);
     }
     
-    WM_LOGI("✅ DNS server stopped successfully");
+    if (valid) {
+        _storeCrc = storeContentCrc(blob.get() + sizeof(header) + sizeof(CredentialStore), header.paramBytes);
+        if (paramsPending) {
+            restoreParameters(blob.get() + sizeof(header) + sizeof(CredentialStore),
+                              header.paramCount, header.paramBytes);
+        }
+    }
+    _paramsRestored = _paramsCount;
+    return valid;
 }
 
+void WiFiManager::restoreParameters(const uint8_t* records, uint8_t count, size_t bytes) {
+    const uint8_t* end = records + bytes;
+    for (uint8_t i = 0; i < count && (size_t)(end - records) >= sizeof(ParamRecord); i++) {
+        ParamRecord record;
+        memcpy(&record, records, sizeof(record));
+        records += sizeof(record);
+        if (record.idLength + record.length > (size_t)(end - records)) {
+            break;
+        }
+        const char* storedId = (const char*)records;
+        records += record.idLength;
+        
+        // The hash narrows the search, the stored id decides
+        const ParamIndexEntry* first = _paramIndex;
+        const ParamIndexEntry* last = first + _paramIndexCount;
+        const ParamIndexEntry* it = std::lower_bound(first, last, record.idHash,
+            [](const ParamIndexEntry& e, uint32_t h) { return e.hash < h; });
+        for (; it != last && it->hash == record.idHash; ++it) {
+            const char* id = _params[it->param]->getID();
+            if (strlen(id) == record.idLength && memcmp(id, storedId, record.idLength) == 0) {
+                // Only parameters added since the last restore, earlier ones may have been edited
+                if (it->param >= _paramsRestored) {
+                    _params[it->param]->setValue(std::string_view((const char*)records, record.length));
+                }
+                break;
+            }
+        }
+        records += record.length;
+    }
+    WM_LOGD("Restored %d stored parameter values", count);
+}
+
+bool WiFiManager::saveStore() {
+    _credStore.version = WM_CREDENTIALS_VERSION;
+    
+    size_t paramBytes = 0;
+    uint8_t paramCount = 0;
+#if WM_PERSIST_PARAMS
+    for (int i = 0; i < _paramsCount; i++) {
+        const char* id = _params[i]->getID();
+        if (!id || !id[0] || strlen(id) > UINT8_MAX) {
+            continue;
+        }
+        size_t size = sizeof(ParamRecord) + strlen(id) + _params[i]->getValueLength();
+        if (paramBytes + size > WM_STORE_MAX_PARAM_BYTES) {
+            WM_LOGW("Parameter %s does not fit in the stored configuration", id);
+            continue;
+        }
+        paramBytes += size;
+        paramCount++;
+    }
+#endif
+    
+    size_t len = sizeof(StoreHeader) + sizeof(_credStore) + paramBytes;
+    std::unique_ptr<uint8_t[]> blob(new (std::nothrow) uint8_t[len]);
+    if (!blob) {
+        WM_LOGE("❌ No memory to save configuration");
+        return false;
+    }
+    
+    uint8_t* out = blob.get() + sizeof(StoreHeader);
+    memcpy(out, &_credStore, sizeof(_credStore));
+    out += sizeof(_credStore);
+    // Same selection as the sizing pass above
+    size_t written = 0;
+    for (int i = 0; i < _paramsCount && paramCount > 0; i++) {
+        const char* id = _params[i]->getID();
+        if (!id || !id[0] || strlen(id) > UINT8_MAX) {
+            continue;
+        }
+        ParamRecord record = {WMFormParser::hashKey(id, strlen(id)),
+                              static_cast<uint16_t>(_params[i]->getValueLength()),
+                              static_cast<uint8_t>(strlen(id)), 0};
+        size_t size = sizeof(record) + record.idLength + record.length;
+        if (written + size > WM_STORE_MAX_PARAM_BYTES) {
+            continue;
+        }
+        written += size;
+        memcpy(out, &record, sizeof(record));
+        memcpy(out + sizeof(record), id, record.idLength);
+        memcpy(out + sizeof(record) + record.idLength, _params[i]->getValue(), record.length);
+        out += size;
+    }
+    
+    // Nothing changed since the last load or save, spare the flash. Usage counters
+    // alone don't count until WM_CREDENTIALS_FLUSH_SUCCESSES reconnects have piled up.
+    uint32_t contentCrc = storeContentCrc(blob.get() + sizeof(StoreHeader) + sizeof(_credStore), paramBytes);
+    if (contentCrc == _storeCrc && _credUnsavedSuccesses < WM_CREDENTIALS_FLUSH_SUCCESSES) {
+        WM_LOGD("Stored configuration unchanged");
+        return true;
+    }
+    
+    StoreHeader header = {WM_STORE_VERSION, paramCount, static_cast<uint16_t>(paramBytes),
+                          esp_rom_crc32_le(0, blob.get() + sizeof(StoreHeader), len - sizeof(StoreHeader))};
+    memcpy(blob.get(), &header, sizeof(header));
+    
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(WM_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        WM_LOGE("❌ Failed to open NVS for configuration: %s", esp_err_to_name(ret));
+        return false;
+    }
+    ret = nvs_set_blob(nvs, WM_STORE_KEY, blob.get(), len);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    
+    if (ret != ESP_OK) {
+        WM_LOGE("❌ Failed to save configuration: %s", esp_err_to_name(ret));
+        return false;
+    }
+    _storeCrc = contentCrc;
+    _credUnsavedSuccesses = 0;
+    WM_LOGD("Saved configuration: %d networks, %d parameters, %d bytes",
+            _credStore.count, paramCount, (int)len);
+    return true;
+}
+
+uint32_t WiFiManager::storeContentCrc(const uint8_t* params, size_t paramBytes) const {
+    // Networks, their passwords, which one is most recent, and the parameter records.
+    // Clock, last-use stamps and success counts are left out.
+    uint8_t count = _credStore.count;
+    uint8_t recent = static_cast<uint8_t>(mostRecentCredential());
+    uint32_t crc = esp_rom_crc32_le(0, &count, sizeof(count));
+    for (int i = 0; i < _credStore.count; i++) {
+        const StoredCredential& entry = _credStore.entries[i];
+        crc = esp_rom_crc32_le(crc, reinterpret_cast<const uint8_t*>(entry.ssid), sizeof(entry.ssid));
+        crc = esp_rom_crc32_le(crc, reinterpret_cast<const uint8_t*>(entry.password), sizeof(entry.password));
+    }
+    crc = esp_rom_crc32_le(crc, &recent, sizeof(recent));
+    crc = esp_rom_crc32_le(crc, params, paramBytes);
+    return crc ? crc : 1;  // 0 means unknown
+}
+
+void WiFiManager::restoreStore() {
+    // Parameters added since the last load get their stored values here
+    std::lock_guard<std::mutex> lock(_credMutex);
+    loadStore();
+}
+
+bool WiFiManager::saveParameters() {
+    std::lock_guard<std::mutex> lock(_credMutex);
+    loadStore();
+    return saveStore();
+}
+
+int WiFiManager::findCredential(const char* ssid) const {
+    for (int i = 0; i < _credStore.count; i++) {
+        if (strncmp(_credStore.entries[i].ssid, ssid, WM_MAX_SSID_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int WiFiManager::mostRecentCredential() const {
+    int recent = -1;
+    for (int i = 0; i < _credStore.count; i++) {
+        if (recent < 0 || _credStore.entries[i].lastUsed > _credStore.entries[recent].lastUsed) {
+            recent = i;
+        }
+    }
+    return recent;
+}
+
+int WiFiManager::insertCredential(const char* ssid, const char* password) {
+    int slot = findCredential(ssid);
+    if (slot < 0) {
+        if (_credStore.count < WM_MAX_CREDENTIALS) {
+            slot = _credStore.count++;
+        } else {
+            // Replace the least recently used network
+            slot = 0;
+            for (int i = 1; i < _credStore.count; i++) {
+                if (_credStore.entries[i].lastUsed < _credStore.entries[slot].lastUsed) {
+                    slot = i;
+                }
+            }
+            WM_LOGI("Store full, replacing %s", _credStore.entries[slot].ssid);
+        }
+        memset(&_credStore.entries[slot], 0, sizeof(StoredCredential));
+        strncpy(_credStore.entries[slot].ssid, ssid, WM_MAX_SSID_LEN);
+    }
+    
+    StoredCredential& entry = _credStore.entries[slot];
+    memset(entry.password, 0, sizeof(entry.password));
+    if (password) {
+        strncpy(entry.password, password, WM_MAX_PASSWORD_LEN);
+    }
+    entry.lastUsed = ++_credStore.clock;
+    return slot;
+}
+
+bool WiFiManager::addCredential(const char* ssid, const char* password) {
+    if (!ssid || strlen(ssid) == 0 || strlen(ssid) > WM_MAX_SSID_LEN ||
+        (password && strlen(password) > WM_MAX_PASSWORD_LEN)) {
+        WM_LOGE("❌ Invalid network credentials");
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(_credMutex);
+    loadStore();
+    insertCredential(ssid, password);
+    WM_LOGI("💾 Stored network: %s (%d/%d)", ssid, _credStore.count, WM_MAX_CREDENTIALS);
+    return saveStore();
+}
+
+bool WiFiManager::removeCredential(const char* ssid) {
+    if (!ssid) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(_credMutex);
+    loadStore();
+    int slot = findCredential(ssid);
+    if (slot < 0) {
+        WM_LOGW("Network %s is not stored", ssid);
+        return false;
+    }
+    
+    // Keep entries packed
+    _credStore.count--;
+    if (slot != _credStore.count) {
+        _credStore.entries[slot] = _credStore.entries[_credStore.count];
+    }
+    memset(&_credStore.entries[_credStore.count], 0, sizeof(StoredCredential));
+    WM_LOGI("🗑️  Removed stored network: %s", ssid);
+    return saveStore();
+}
+
+std::vector<WiFiCredential> WiFiManager::listCredentials() {
+    std::lock_guard<std::mutex> lock(_credMutex);
+    loadStore();
+    
+    std::vector<WiFiCredential> list;
+    list.reserve(_credStore.count);
+    for (int i = 0; i < _credStore.count; i++) {
+        const StoredCredential& entry = _credStore.entries[i];
+        list.push_back({entry.ssid, entry.successCount, entry.lastUsed});
+    }
+    
+    // Most recently used first
+    std::sort(list.begin(), list.end(), [](const WiFiCredential& a, const WiFiCredential& b) {
+        return a.lastUsed > b.lastUsed;
+    });
+    return list;
+}
+
+void WiFiManager::recordCredentialSuccess() {
+    wifi_config_t wifi_config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK || wifi_config.sta.ssid[0] == 0) {
+        return;
+    }
+    
+    char ssid[WM_MAX_SSID_LEN + 1] = {0};
+    char password[WM_MAX_PASSWORD_LEN + 1] = {0};
+    memcpy(ssid, wifi_config.sta.ssid, WM_MAX_SSID_LEN);
+    memcpy(password, wifi_config.sta.password, WM_MAX_PASSWORD_LEN);
+    
+    // Networks only enter the store once they have actually connected
+    std::lock_guard<std::mutex> lock(_credMutex);
+    loadStore();
+    int slot = insertCredential(ssid, password);
+    if (_credStore.entries[slot].successCount < UINT16_MAX) {
+        _credStore.entries[slot].successCount++;
+    }
+    
+    // This runs for every GOT_IP. Reconnecting to the most recent network leaves the
+    // store's content as it is in flash, so saveStore() only writes the counters on
+    // every WM_CREDENTIALS_FLUSH_SUCCESSES-th one; a real change writes them too.
+    if (_credUnsavedSuccesses < UINT8_MAX) {
+        _credUnsavedSuccesses++;
+    }
+    saveStore();
+}
+
+bool WiFiManager::connectToStoredNetworks(const char* skipSSID) {
+    {
+        std::lock_guard<std::mutex> lock(_credMutex);
+        loadStore();
+        if (_credStore.count == 0 ||
+            (_credStore.count == 1 && skipSSID && findCredential(skipSSID) == 0)) {
+            return false;
+        }
+    }
+    
+    // Make sure the STA is idle so the scan can run
+    esp_wifi_disconnect();
+    wifi_mode_t mode;
+    if (esp_wifi_get_mode(&mode) != ESP_OK || mode == WIFI_MODE_NULL) {
+        esp_wifi_set_mode(WIFI_MODE_STA);
+    }
+    esp_wifi_start();
+    
+    // One scan, intersected with the store through the scan table's SSID index
+    scanWiFiNetworks();
+    
+    struct Candidate {
+        StoredCredential cred;
+        int8_t rssi;
+        uint8_t channel;
+    };
+    std::vector<Candidate> candidates;
+    {
+        // Looked up in the front table in place, it is too big to copy onto this stack
+        std::lock_guard<std::mutex> lock(_credMutex);
+        std::lock_guard<std::mutex> scanLock(_scanMutex);
+        const WMScanTable& scan = _scanTables[_scanFront];
+        candidates.reserve(_credStore.count);
+        for (int i = 0; i < _credStore.count; i++) {
+            const StoredCredential& entry = _credStore.entries[i];
+            if (skipSSID && strncmp(entry.ssid, skipSSID, WM_MAX_SSID_LEN) == 0) {
+                continue;
+            }
+            const wifi_ap_record_t* ap = scan.find(entry.ssid);
+            if (ap) {
+                candidates.push_back({entry, ap->rssi, ap->primary});
+            }
+        }
+    }
+    
+    if (candidates.empty()) {
+        WM_LOGI("No stored networks in range");
+        return false;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.rssi > b.rssi;
+    });
+    
+    for (const auto& candidate : candidates) {
+        WM_LOGI("📡 Trying stored network %s (RSSI: %d)", candidate.cred.ssid, candidate.rssi);
+        
+        wifi_config_t wifi_config = {};
+        strncpy((char*)wifi_config.sta.ssid, candidate.cred.ssid, sizeof(wifi_config.sta.ssid));
+        strncpy((char*)wifi_config.sta.password, candidate.cred.password, sizeof(wifi_config.sta.password));
+        wifi_config.sta.channel = candidate.channel;
+        applyStaConfig(wifi_config);
+        if (esp_wifi_set_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+            continue;
+        }
+        
+        xEventGroupClearBits(_eventGroup, WM_EVT_GOT_IP | WM_EVT_DISCONNECTED);
+        _connectMetrics = {};
+        _fastConnectActive = false;
+        beginConnectAttempt();
+        setState(WM_STATE_TRY_STA);
+        if (esp_wifi_connect() != ESP_OK) {
+            continue;
+        }
+        
+        // The config stays in the driver's flash storage, so the next boot starts with it
+        EventBits_t bits = waitForEvents(WM_EVT_GOT_IP | WM_EVT_DISCONNECTED,
+                                         _connectStart + _connectTimeout);
+        if (bits & WM_EVT_GOT_IP) {
+            return true;
+        }
+        WM_LOGW("⚠️  Stored network %s failed: %s", candidate.cred.ssid,
+                getWLStatusString(bits ? getLastConxResult() : WL_CONNECT_FAILED));
+        esp_wifi_disconnect();
+    }
+    
+    transitionState(WM_STATE_TRY_STA, WM_STATE_START_PORTAL);
+    return false;
+}
+
+void WiFiManager::clearFastConnect() {
+    memset(&_fastConnect, 0, sizeof(_fastConnect));
+    _fastConnectLoaded = true;
+    
+    nvs_handle_t nvs;
+    if (nvs_open(WM_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_erase_key(nvs, WM_FAST_CONNECT_KEY) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+}
+
+void WiFiManager::setWiFiAutoReconnect(bool autoReconnect) {
+    _autoReconnect = autoReconnect;
+    WM_LOGD("Auto reconnect %s", autoReconnect ? "enabled" : "disabled");
+    if (!autoReconnect) {
+        cancelReconnect();
+    }
+}
+
+bool WiFiManager::disconnect(bool wifioff) {
+    cancelReconnect();
+    esp_err_t err = esp_wifi_disconnect();
+    if (wifioff) {
+        esp_wifi_stop();
+    }
+    return err == ESP_OK;
+}
+
+void WiFiManager::setReconnectConfig(const wm_reconnect_config_t& config) {
+    _reconnectConfig = config;
+    if (_reconnectConfig.minDelayMs == 0) {
+        _reconnectConfig.minDelayMs = 1;
+    }
+    if (_reconnectConfig.maxDelayMs < _reconnectConfig.minDelayMs) {
+        _reconnectConfig.maxDelayMs = _reconnectConfig.minDelayMs;
+    }
+    WM_LOGD("Reconnect config set: %lu-%lu ms, auth %lu ms, %d attempts",
+            (unsigned long)_reconnectConfig.minDelayMs, (unsigned long)_reconnectConfig.maxDelayMs,
+            (unsigned long)_reconnectConfig.authFailDelayMs, _reconnectConfig.maxAttempts);
+}
+
+wm_reconnect_config_t WiFiManager::getReconnectConfig() const {
+    return _reconnectConfig;
+}
+
+bool WiFiManager::reconnectWiFiAsync() {
+    if (!_wifiInitialized) {
+        WM_LOGE("WiFi not initialized");
+        return false;
+    }
+    wifi_config_t wifi_config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK || wifi_config.sta.ssid[0] == 0) {
+        WM_LOGE("❌ No saved WiFi credentials found");
+        return false;
+    }
+    
+    if (_state == WM_STATE_TRY_STA || _state == WM_STATE_START_PORTAL || _state == WM_STATE_RUN_PORTAL) {
+        WM_LOGW("Connection attempt or portal in progress, not reconnecting");
+        return false;
+    }
+    
+    // Starts a fresh sequence with the first attempt right away
+    cancelReconnect();
+    esp_wifi_disconnect();
+    scheduleReconnect(WM_RECONNECT_NOW);
+    return true;
+}
+
+uint32_t WiFiManager::reconnectDelay(uint8_t reason, uint8_t attempt) const {
+    const wm_reconnect_config_t& config = _reconnectConfig;
+    
+    // A lost beacon usually means a brief fade, retry quickly. Anything else
+    // (AP rebooting, refused association) starts a few doublings in.
+    uint8_t shift = attempt + (reason == WIFI_REASON_BEACON_TIMEOUT || attempt == 0 ? 0 : 2);
+    uint64_t base = (uint64_t)config.minDelayMs << (shift < 20 ? shift : 20);
+    if (base > config.maxDelayMs) {
+        base = config.maxDelayMs;
+    }
+    
+    // Equal jitter: half fixed, half random, so devices that lost the same AP spread out
+    uint32_t delay = base / 2 + esp_random() % (uint32_t)(base / 2 + 1);
+    
+    // A wrong password won't fix itself soon, don't keep the AP busy with it
+    if (getLastConxResult() == WL_WRONG_PASSWORD && delay < config.authFailDelayMs) {
+        delay = config.authFailDelayMs;
+    }
+    return delay;
+}
+
+void WiFiManager::scheduleReconnect(uint8_t reason) {
+    if (!_autoReconnect && _reconnectAttempts == 0 && reason != WM_RECONNECT_NOW) {
+        return;
+    }
+    
+    uint8_t attempt = _reconnectAttempts;
+    if (_reconnectConfig.maxAttempts > 0 && attempt >= _reconnectConfig.maxAttempts) {
+        WM_LOGW("⚠️  Giving up reconnecting after %d attempts", attempt);
+        finishReconnect(false);
+        return;
+    }
+    
+    if (!_reconnectTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = reconnectTimerCallback;
+        args.arg = this;
+        args.name = "wm_reconnect";
+        if (esp_timer_create(&args, &_reconnectTimer) != ESP_OK) {
+            _reconnectTimer = nullptr;
+            WM_LOGE("Failed to create reconnect timer");
+            return;
+        }
+    }
+    
+    // An explicit request only waits for its own disconnect to settle
+    uint32_t delay = reason == WM_RECONNECT_NOW ? 100 : reconnectDelay(reason, attempt);
+    WM_LOGI("🔄 Reconnect attempt %d in %lu ms (reason %d)", attempt + 1, (unsigned long)delay, reason);
+    esp_timer_stop(_reconnectTimer);
+    esp_timer_start_once(_reconnectTimer, (uint64_t)delay * 1000);
+}
+
+void WiFiManager::reconnectTimerCallback(void* arg) {
+    WiFiManager* manager = static_cast<WiFiManager*>(arg);
+    // The portal or a fresh connect took over while we were waiting
+    wm_state_t state = manager->_state;
+    if (state == WM_STATE_TRY_STA || state == WM_STATE_START_PORTAL || state == WM_STATE_RUN_PORTAL) {
+        manager->_reconnectAttempts = 0;
+        return;
+    }
+    
+    manager->_reconnectAttempts++;
+    manager->beginConnectAttempt();
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        // No event will follow, so schedule the next try ourselves
+        WM_LOGW("Reconnect failed to start: %s", esp_err_to_name(err));
+        manager->scheduleReconnect(WIFI_REASON_UNSPECIFIED);
+    }
+}
+
+void WiFiManager::cancelReconnect() {
+    if (_reconnectTimer) {
+        esp_timer_stop(_reconnectTimer);
+    }
+    _reconnectAttempts = 0;
+}
+
+void WiFiManager::finishReconnect(bool connected) {
+    uint8_t attempts = _reconnectAttempts.exchange(0);
+    if (attempts == 0) {
+        return;
+    }
+    if (connected) {
+        WM_LOGI("✅ Reconnected after %d attempts", attempts);
+    }
+    if (_reconnectCallback) {
+        _reconnectCallback(connected, attempts);
+    }
+}
+
+// Power profiles
+
+static const char* const POWER_PROFILE_NAMES[] = {
+    "unmanaged", "portal responsive", "STA low power", "STA balanced", "STA throughput"
+};
+
+void WiFiManager::setPowerConfig(const wm_power_config_t& config) {
+    _powerConfig = config;
+    WM_LOGD("Power config set: portal %s, STA %s, listen interval %d, TX cap %d, auto AP channel %s",
+            POWER_PROFILE_NAMES[config.portalProfile], POWER_PROFILE_NAMES[config.staProfile],
+            config.listenInterval, config.lowPowerTxPower, config.autoAPChannel ? "on" : "off");
+    
+    // Force the current profile through again with the new settings
+    _powerProfile = WM_POWER_UNMANAGED;
+    applyPowerProfile();
+}
+
+wm_power_config_t WiFiManager::getPowerConfig() const {
+    return _powerConfig;
+}
+
+void WiFiManager::applyPowerProfile() {
+    if (!_wifiInitialized) {
+        return;
+    }
+    
+    // A portal being served wins over the link state, it stays responsive until stopped
+    wm_state_t state = _state;
+    wm_power_profile_t profile;
+    if (isWebPortalActive() || state == WM_STATE_START_PORTAL || state == WM_STATE_RUN_PORTAL) {
+        profile = _powerConfig.portalProfile;
+    } else if (state == WM_STATE_RUN_STA || state == WM_STATE_TRY_STA) {
+        profile = _powerConfig.staProfile;
+    } else {
+        return;
+    }
+    if (_powerProfile.exchange(profile) == profile || profile == WM_POWER_UNMANAGED) {
+        return;
+    }
+    
+    wifi_ps_type_t ps = WIFI_PS_NONE;
+    int8_t txPower = WM_MAX_TX_POWER;
+    if (profile == WM_POWER_STA_LOW_POWER) {
+        ps = WIFI_PS_MAX_MODEM;
+        if (_powerConfig.lowPowerTxPower > 0) {
+            txPower = std::max<int8_t>(_powerConfig.lowPowerTxPower, WM_MIN_TX_POWER);
+        }
+    } else if (profile == WM_POWER_STA_BALANCED) {
+        ps = WIFI_PS_MIN_MODEM;
+    }
+    
+    // TX power needs a started driver; startAP()/startSTA() apply the profile again
+    esp_err_t ret = esp_wifi_set_max_tx_power(txPower);
+    if (ret == ESP_ERR_WIFI_NOT_STARTED) {
+        _powerProfile = WM_POWER_UNMANAGED;
+        return;
+    }
+    if (ret != ESP_OK) {
+        WM_LOGW("⚠️ Failed to set TX power %d: %s", txPower, esp_err_to_name(ret));
+    }
+    // Refused e.g. when Bluetooth coexistence requires modem sleep
+    ret = esp_wifi_set_ps(ps);
+    if (ret != ESP_OK) {
+        WM_LOGW("⚠️ Failed to set power save mode %d: %s", ps, esp_err_to_name(ret));
+    }
+    WM_LOGI("🔋 Power profile: %s", POWER_PROFILE_NAMES[profile]);
+}
+
+void WiFiManager::applyStaConfig(wifi_config_t& config) const {
+    applyRoamCapabilities(config);
+    // Only read at association, so it is part of every STA config we write
+    if (_powerConfig.staProfile == WM_POWER_STA_LOW_POWER) {
+        config.sta.listen_interval = _powerConfig.listenInterval;
+    }
+}
+
+uint8_t WiFiManager::pickAPChannel() {
+    // The non-overlapping 20 MHz channels, usable in every regulatory domain
+    static const uint8_t CANDIDATES[] = {1, 6, 11};
+    uint32_t load[sizeof(CANDIDATES)] = {};
+    size_t networks;
+    {
+        std::lock_guard<std::mutex> lock(_scanMutex);
+        const WMScanTable& table = _scanTables[_scanFront];
+        networks = table.size();
+        for (size_t i = 0; i < networks; i++) {
+            const wifi_ap_record_t& ap = table[i];
+            // Channels are 5 MHz apart, so a neighbour overlaps up to four channels away
+            for (size_t c = 0; c < sizeof(CANDIDATES); c++) {
+                int distance = std::abs(ap.primary - CANDIDATES[c]);
+                if (distance < 5) {
+                    load[c] += (WMScanTable::signalQuality(ap.rssi) + 1) * (5 - distance);
+                }
+            }
+        }
+    }
+    if (networks == 0) {
+        return WM_DEFAULT_AP_CHANNEL;
+    }
+    
+    size_t best = 0;
+    for (size_t c = 1; c < sizeof(CANDIDATES); c++) {
+        if (load[c] < load[best]) {
+            best = c;
+        }
+    }
+    WM_LOGD("AP channel load 1/6/11: %lu/%lu/%lu from %d networks", (unsigned long)load[0],
+            (unsigned long)load[1], (unsigned long)load[2], networks);
+    return CANDIDATES[best];
+}
+
+void WiFiManager::setRoamConfig(const wm_roam_config_t& config) {
+    _roamConfig = config;
+    WM_LOGD("Roam config set: every %d ms, below %d dBm, gain %d dB, holdoff %d s",
+            config.intervalMs, config.rssiThreshold, config.minGainDb, config.holdoffSec);
+#if !WM_ENABLE_ROAMING
+    WM_LOGW("Roaming not compiled in, enable CONFIG_WM_ENABLE_ROAMING");
+#endif
+    if (config.intervalMs == 0) {
+        stopLinkMonitor();
+    } else if (_state == WM_STATE_RUN_STA) {
+        startLinkMonitor();
+    }
+}
+
+wm_roam_config_t WiFiManager::getRoamConfig() const {
+    return _roamConfig;
+}
+
+void WiFiManager::applyRoamCapabilities(wifi_config_t& config) const {
+#if WM_ROAM_11KV
+    // Lets the AP suggest neighbours (11k) and steer us to them (11v)
+    config.sta.rm_enabled = 1;
+    config.sta.btm_enabled = 1;
+#else
+    (void)config;
+#endif
+}
+
+void WiFiManager::startLinkMonitor() {
+#if WM_ENABLE_ROAMING
+    if (_linkMonitorTask || _roamConfig.intervalMs == 0) {
+        return;
+    }
+    _linkMonitorRun = true;
+    xEventGroupClearBits(_eventGroup, WM_EVT_LINK_STOPPED);
+    if (xTaskCreate(linkMonitorTask, "wm_link", WM_ROAM_STACK_SIZE, this, 1, &_linkMonitorTask) != pdPASS) {
+        WM_LOGW("Failed to create link monitor task");
+        _linkMonitorRun = false;
+        _linkMonitorTask = nullptr;
+    }
+#endif
+}
+
+void WiFiManager::stopLinkMonitor() {
+    TaskHandle_t task = _linkMonitorTask;
+    if (!task) {
+        return;
+    }
+    _linkMonitorRun = false;
+    xTaskNotifyGive(task);
+    
+    // A roam in progress finishes its reconnect first; the task owns the driver
+    // calls it is in the middle of, so it always exits by itself
+    TickType_t timeout = pdMS_TO_TICKS(WM_ROAM_CONNECT_TIMEOUT_MS + WM_SCAN_TIMEOUT_MS);
+    if (!(xEventGroupWaitBits(_eventGroup, WM_EVT_LINK_STOPPED, pdTRUE, pdFALSE, timeout) & WM_EVT_LINK_STOPPED)) {
+        WM_LOGW("Link monitor still finishing a roam");
+    }
+}
+
+void WiFiManager::linkMonitorTask(void* pvParameters) {
+    WiFiManager* manager = static_cast<WiFiManager*>(pvParameters);
+    int8_t samples[WM_ROAM_AVG_SAMPLES];
+    uint8_t count = 0;
+    uint8_t next = 0;
+    int64_t holdoffUntil = 0;
+    WM_LOGD("Link monitor started");
+    
+    while (manager->_linkMonitorRun) {
+        // Sleeps the interval unless stopLinkMonitor() wakes it
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(manager->_roamConfig.intervalMs));
+        if (!manager->_linkMonitorRun) {
+            break;
+        }
+        
+        wifi_ap_record_t ap;
+        if (manager->_state != WM_STATE_RUN_STA || esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+            count = 0;  // Start a fresh average on the next link
+            continue;
+        }
+        manager->_status.update([&ap](WiFiManagerStatus& status) { status.rssi = ap.rssi; });
+        
+        samples[next] = ap.rssi;
+        next = (next + 1) % WM_ROAM_AVG_SAMPLES;
+        if (count < WM_ROAM_AVG_SAMPLES) {
+            count++;
+            continue;
+        }
+        
+        int sum = 0;
+        for (int8_t sample : samples) {
+            sum += sample;
+        }
+        int8_t average = sum / WM_ROAM_AVG_SAMPLES;
+        WM_LOGV("Link RSSI %d dBm, average %d dBm", ap.rssi, average);
+        
+        if (average >= manager->_roamConfig.rssiThreshold || esp_timer_get_time() < holdoffUntil) {
+            continue;
+        }
+        holdoffUntil = esp_timer_get_time() + manager->_roamConfig.holdoffSec * 1000000LL;
+        manager->roam(ap, average);
+        count = 0;  // Samples from the old AP say nothing about the new one
+    }
+    
+    WM_LOGD("Link monitor stopped");
+    manager->_linkMonitorTask = nullptr;
+    xEventGroupSetBits(manager->_eventGroup, WM_EVT_LINK_STOPPED);
+    vTaskDelete(nullptr);
+}
+
+bool WiFiManager::findRoamCandidate(const wifi_ap_record_t& current, int8_t minRssi, wifi_ap_record_t& out) {
+    // Never compete with a portal scan for the radio
+    bool idle = false;
+    if (!_scanInProgress.compare_exchange_strong(idle, true)) {
+        WM_LOGD("Scan in progress, roaming postponed");
+        return false;
+    }
+    _scanAsync = false;  // The SCAN_DONE handler leaves blocking scans alone
+    _scanStartTime = esp_timer_get_time();
+    
+    // Only the current network, all channels, so the other BSSIDs show up
+    wifi_scan_config_t scan_config = {};
+    scan_config.ssid = const_cast<uint8_t*>(current.ssid);
+    scan_config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+    scan_config.scan_time.active.min = _scanConfig.activeDwellMs / 2;
+    scan_config.scan_time.active.max = _scanConfig.activeDwellMs;
+    
+    wifi_ap_record_t records[WM_ROAM_MAX_CANDIDATES];
+    uint16_t found = WM_ROAM_MAX_CANDIDATES;
+    bool scanned = esp_wifi_scan_start(&scan_config, true) == ESP_OK &&
+                   esp_wifi_scan_get_ap_records(&found, records) == ESP_OK;
+    if (!scanned) {
+        esp_wifi_clear_ap_list();
+        found = 0;
+    }
+    _scanInProgress = false;
+    
+    const wifi_ap_record_t* best = nullptr;
+    for (uint16_t i = 0; i < found; i++) {
+        if (memcmp(records[i].bssid, current.bssid, sizeof(current.bssid)) != 0 &&
+            records[i].rssi >= minRssi && (!best || records[i].rssi > best->rssi)) {
+            best = &records[i];
+        }
+    }
+    if (!best) {
+        return false;
+    }
+    out = *best;
+    return true;
+}
+
+void WiFiManager::roam(const wifi_ap_record_t& current, int8_t average) {
+    WM_LOGI("📶 Link weak (%d dBm average), looking for a better AP", average);
+    
+#if WM_ROAM_11KV
+    // The AP knows its neighbours; on a BSS transition request the supplicant moves by itself
+    if (esp_wnm_is_btm_supported_connection()) {
+        if (esp_wnm_send_bss_transition_mgmt_query(REASON_FRAME_LOSS, NULL, 0) == 0) {
+            WM_LOGI("📶 Sent BSS transition query to the AP");
+            return;
+        }
+    }
+#endif
+    
+    wifi_ap_record_t target;
+    if (!findRoamCandidate(current, average + _roamConfig.minGainDb, target)) {
+        WM_LOGI("No stronger AP for %s, staying", (const char*)current.ssid);
+        return;
+    }
+    
+    wifi_config_t wifi_config = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK) {
+        return;
+    }
+    WM_LOGI("📶 Roaming to " MACSTR " on channel %d (%d dBm)", MAC2STR(target.bssid), target.primary, target.rssi);
+    
+    // Same directed connect as fast reconnect; GOT_IP refreshes the cached BSSID
+    _roaming = WM_ROAM_DIRECTED;
+    memcpy(wifi_config.sta.bssid, target.bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.bssid_set = true;
+    wifi_config.sta.channel = target.primary;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    
+    xEventGroupClearBits(_eventGroup, WM_EVT_GOT_IP | WM_EVT_DISCONNECTED);
+    esp_wifi_disconnect();
+    beginConnectAttempt();
+    EventBits_t bits = 0;
+    if (esp_wifi_connect() == ESP_OK) {
+        bits = waitForEvents(WM_EVT_GOT_IP | WM_EVT_DISCONNECTED,
+                             _connectStart + WM_ROAM_CONNECT_TIMEOUT_MS * 1000LL);
+    }
+    
+    // GOT_IP ends the roam even when it lands just after the wait gave up
+    uint8_t phase = WM_ROAM_DIRECTED;
+    if (!(bits & WM_EVT_GOT_IP) && _roaming.compare_exchange_strong(phase, WM_ROAM_FALLBACK)) {
+        // Back to letting the driver pick any AP of the network
+        WM_LOGW("⚠️  Roam to " MACSTR " failed, reconnecting normally", MAC2STR(target.bssid));
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        esp_wifi_connect();
+        return;
+    }
+    
+    WM_LOGI("✅ Roamed in %lld ms", (esp_timer_get_time() - _connectStart) / 1000);
+}
+
+#if WM_PROVISION_HTTP
+// Connectivity probes are the bulk of portal traffic, so their responses are
+// prebuilt and go out in one send. Entries stay grouped by OS.
+#define WM_PROBE_URI "@probe"   // Handler template, never a real request path
+#define WM_PROBE_REDIRECT "HTTP/1.1 302 Found\r\nLocation: /\r\n" \
+                          "Cache-Control: no-store\r\nContent-Length: 0\r\n\r\n"
+
+struct WMProbe {
+    const char* path;
+    uint8_t pathLen;
+    const char* response;
+    uint16_t responseLen;
+};
+
+#define WM_PROBE(path, response) { path, sizeof(path) - 1, response, sizeof(response) - 1 }
+
+static const WMProbe PROBES[] = {
+    // Android
+    WM_PROBE("/generate_204", "HTTP/1.1 204 No Content\r\nCache-Control: no-store\r\nContent-Length: 0\r\n\r\n"),
+    WM_PROBE("/gen_204", WM_PROBE_REDIRECT),
+    // Apple
+    WM_PROBE("/hotspot-detect.html", WM_PROBE_REDIRECT),
+    WM_PROBE("/library/test/success.html", WM_PROBE_REDIRECT),
+    // Windows
+    WM_PROBE("/ncsi.txt", "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+                          "Cache-Control: no-store\r\nContent-Length: 14\r\n\r\nMicrosoft NCSI"),
+    WM_PROBE("/connecttest.txt", WM_PROBE_REDIRECT),
+    WM_PROBE("/redirect", WM_PROBE_REDIRECT),
+    WM_PROBE("/fwlink", WM_PROBE_REDIRECT),
+    // Firefox, Linux desktops
+    WM_PROBE("/success.txt", WM_PROBE_REDIRECT),
+    WM_PROBE("/canonical.html", WM_PROBE_REDIRECT),
+};
+
+// uri is the path without its query string, as handed to the match function
+static const WMProbe* findProbe(const char* uri, size_t len) {
+    for (const WMProbe& probe : PROBES) {
+        if (probe.pathLen == len && memcmp(probe.path, uri, len) == 0) {
+            return &probe;
+        }
+    }
+    return nullptr;
+}
+
+// Exact routes are compared directly; only templates with wildcards pay for
+// httpd_uri_match_wildcard. The probe handler is registered first so the
+// probe table is checked before anything else.
+static bool uriMatch(const char* uriTemplate, const char* uri, size_t len) {
+    if (uriTemplate[0] == '@') {
+        return strcmp(uriTemplate, WM_PROBE_URI) == 0 && findProbe(uri, len);
+    }
+    if (strncmp(uriTemplate, uri, len) == 0 && uriTemplate[len] == '\0') {
+        return true;
+    }
+    return strpbrk(uriTemplate, "*?") && httpd_uri_match_wildcard(uriTemplate, uri, len);
+}
+
+// Over-budget requests get this instead of a page, without touching the heap
+static const char BUSY_RESPONSE[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 2\r\n"
+                                    "Cache-Control: no-store\r\nContent-Length: 0\r\n\r\n";
+
+// Built-in routes, registered in this order. The captive probes go first since
+// handlers are matched in registration order; async entries run on a worker.
+// Probes and /events stay outside the heap budget: the former are one prebuilt
+// send, the latter is bounded by its client table.
+#define WM_STREAM(handler) budgetHandler<handler, WM_HTTP_COST_STREAM>
+#define WM_SMALL(handler) budgetHandler<handler, WM_HTTP_COST_SMALL>
+const WMRoute WiFiManager::ROUTES[] = {
+    {WM_PROBE_URI, HTTP_GET, handleCaptivePortal, nullptr},
+    {"/", HTTP_GET, WM_STREAM(handleRoot), nullptr},
+    {"/scan", HTTP_GET, asyncHandler<WM_STREAM(handleScan)>, nullptr},
+    {"/wifisave", HTTP_POST, asyncHandler<WM_SMALL(handleWifiSave)>, nullptr},
+    {"/info", HTTP_GET, WM_STREAM(handleInfo), nullptr},
+    {"/exit", HTTP_GET, WM_SMALL(handleExit), nullptr},
+    {"/wifi", HTTP_GET, WM_STREAM(handleWifi), nullptr},
+    {"/wifi.css", HTTP_GET, WM_STREAM(handleWifiCss), nullptr},
+    {"/wifi.js", HTTP_GET, WM_STREAM(handleWifiJs), nullptr},
+    {"/status", HTTP_GET, WM_SMALL(handleStatus), nullptr},
+#if WM_HTTP_EVENTS
+    {"/events", HTTP_GET, handleEvents, nullptr},
+#endif
+#if WM_ENABLE_METRICS
+    {"/metrics", HTTP_GET, WM_STREAM(handleMetrics), nullptr},
+#endif
+};
+#undef WM_STREAM
+#undef WM_SMALL
+
+void WiFiManager::registerRoute(const WMRoute& route) {
+    httpd_uri_t uri = {
+        .uri = route.uri,
+        .method = route.method,
+        .handler = route.handler,
+        .user_ctx = route.userCtx ? route.userCtx : this
+    };
+    esp_err_t ret = httpd_register_uri_handler(_httpServer, &uri);
+    if (ret != ESP_OK) {
+        WM_LOGW("Failed to register %s: %s", route.uri, esp_err_to_name(ret));
+    }
+}
+
+void WiFiManager::setExtraRoutes(const WMRoute* routes, size_t count) {
+    _extraRoutes = routes;
+    _extraRouteCount = routes && count <= UINT8_MAX ? count : 0;
+    WM_LOGD("Extra routes set: %d", _extraRouteCount);
+}
+
+bool WiFiManager::startHTTPServer(bool staOnly) {
+    WM_LOGD("Starting HTTP server");
+    WM_METRIC_PHASE(_metrics, WM_PHASE_HTTP_START);
+    
+    if (_httpServer != nullptr) {
+        if (_httpStaOnly == staOnly) {
+            WM_LOGW("HTTP server already running");
+            return true;
+        }
+        // Priority and routes differ between the two modes, restart with the new ones
+        stopHTTPServer();
+    }
+    
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = WM_HTTP_PORT;
+    config.max_open_sockets = _portalLean ? std::min<uint16_t>(_httpConfig.maxOpenSockets, WM_HTTP_LEAN_SOCKETS)
+                                          : _httpConfig.maxOpenSockets;
+    config.stack_size = CONFIG_WM_HTTP_STACK_SIZE;
+    config.max_uri_handlers = sizeof(ROUTES) / sizeof(ROUTES[0]) + _extraRouteCount;
+    config.recv_wait_timeout = _httpConfig.recvTimeout;
+    config.send_wait_timeout = _httpConfig.sendTimeout;
+    config.lru_purge_enable = _httpConfig.lruPurge;
+    config.core_id = _httpConfig.coreId < 0 ? tskNO_AFFINITY : _httpConfig.coreId;
+    if (staOnly) {
+        // Below lwIP and the WiFi task, so serving a page never delays application traffic
+        config.task_priority = _httpConfig.webPortalPriority;
+    }
+    config.uri_match_fn = uriMatch;
+    config.global_user_ctx = this; // Store WiFiManager instance for handlers
+    
+    esp_err_t ret = httpd_start(&_httpServer, &config);
+    if (ret != ESP_OK) {
+        WM_LOGE("Failed to start HTTP server: %s", esp_err_to_name(ret));
+        return false;
+    }
+    _httpStaOnly = staOnly;
+    
+    // Without workers the slow handlers simply run inline, which is all a lean portal can afford
+    if (!_portalLean) {
+        startAsyncWorkers();
+    }
+    
+    // One pass over the static table, then the application's routes
+    for (const WMRoute& route : ROUTES) {
+        // On the STA network the probes belong to the real internet, so leave them unanswered
+        if (staOnly && route.handler == handleCaptivePortal) {
+            continue;
+        }
+        // Each stream pins a socket; pages fall back to polling /status
+        if (_portalLean && route.handler == handleEvents) {
+            continue;
+        }
+        registerRoute(route);
+    }
+    for (uint8_t i = 0; i < _extraRouteCount; i++) {
+        registerRoute(_extraRoutes[i]);
+    }
+    
+    WM_LOGI("HTTP server started on port %d (sockets: %d, timeouts: %d/%d s, priority: %d)", config.server_port,
+            config.max_open_sockets, config.recv_wait_timeout, config.send_wait_timeout,
+            (int)config.task_priority);
+    return true;
+}
+
+void WiFiManager::stopHTTPServer() {
+    if (_httpServer) {
+        WM_LOGI("🛑 Stopping HTTP server...");
+        
+        // Let in-flight async requests finish while their sockets are still valid
+        stopAsyncWorkers();
+#if WM_HTTP_EVENTS
+        // Runs on the server task ahead of the stop request
+        httpd_queue_work(_httpServer, closeEventClients, this);
+#endif
+        
+        esp_err_t ret = httpd_stop(_httpServer);
+        if (ret == ESP_OK) {
+            WM_LOGI("✅ HTTP server stopped successfully");
+            _httpServer = nullptr;
+        } else {
+            WM_LOGW("⚠️ Error stopping HTTP server: %s", esp_err_to_name(ret));
+            _httpServer = nullptr;  // Clear handle anyway to prevent issues
+        }
+    } else {
+        WM_LOGD("HTTP server already stopped");
+    }
+}
+
+
+
+bool WiFiManager::startDNSServer() {
+    WM_LOGD("Starting DNS server");
+    WM_METRIC_PHASE(_metrics, WM_PHASE_DNS_START);
+    
+    if (_dnsRunning) {
+        WM_LOGW("DNS server already running");
+        return true;
+    }
+    
+    _dnsRunning = true;
+    
+    BaseType_t ret = xTaskCreate(dnsServerTask, "dns_server", 
+                                CONFIG_WM_DNS_STACK_SIZE, this, 5, &_dnsTaskHandle);
+    
+    if (ret != pdPASS) {
+        WM_LOGE("Failed to create DNS server task");
+        _dnsRunning = false;
+        return false;
+    }
+    
+    WM_LOGI("DNS server started");
+    return true;
+}
+
+void WiFiManager::stopDNSServer() {
+    if (!_dnsRunning) {
+        WM_LOGD("DNS server already stopped");
+        return;
+    }
+    
+    WM_LOGI("🛑 Stopping DNS server...");
+    _dnsRunning = false;
+    
+    // Close socket to wake up task
+    if (_dnsSocket >= 0) {
+        close(_dnsSocket);
+        _dnsSocket = -1;
+    }
+    
+    // Wait for task to finish
+    int timeout = 50; // 5 seconds
+    while (_dnsTaskHandle && timeout-- > 0) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    
+    if (_dnsTaskHandle) {
+        WM_LOGW("DNS task did not terminate gracefully, deleting");
+        vTaskDelete(_dnsTaskHandle);
+        _dnsTaskHandle = nullptr;
+    }
+    
+    WM_LOGI("✅ DNS server stopped successfully");
+}
+#else
+
+// UDP provisioning server
+
+bool WiFiManager::startProvisionServer() {
+    if (_provisionRunning) {
+        WM_LOGW("Provisioning server already running");
+        return true;
+    }
+    
+    _provisionRunning = true;
+    _provisionClient = 0;
+    
+    BaseType_t ret = xTaskCreate(provisionTask, "wm_provision",
+                                WM_PROVISION_STACK_SIZE, this, 5, &_provisionTaskHandle);
+    if (ret != pdPASS) {
+        WM_LOGE("Failed to create provisioning task");
+        _provisionRunning = false;
+        return false;
+    }
+    return true;
+}
+
+void WiFiManager::stopProvisionServer() {
+    if (!_provisionRunning) {
+        WM_LOGD("Provisioning server already stopped");
+        return;
+    }
+    
+    WM_LOGI("🛑 Stopping provisioning server...");
+    _provisionRunning = false;
+    
+    // Close socket to wake up task
+    if (_provisionSocket >= 0) {
+        close(_provisionSocket);
+        _provisionSocket = -1;
+    }
+    
+    // Wait for task to finish
+    int timeout = 50; // 5 seconds
+    while (_provisionTaskHandle && timeout-- > 0) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    
+    if (_provisionTaskHandle) {
+        WM_LOGW("Provisioning task did not terminate gracefully, deleting");
+        vTaskDelete(_provisionTaskHandle);
+        _provisionTaskHandle = nullptr;
+    }
+    
+    WM_LOGI("✅ Provisioning server stopped successfully");
+}
+
+void WiFiManager::provisionTask(void* pvParameters) {
+    WiFiManager* manager = static_cast<WiFiManager*>(pvParameters);
+    
+    struct sockaddr_in server_addr = {};
+    struct sockaddr_in client_addr;
+    uint8_t request[WM_PROVISION_MAX_PACKET];
+    uint8_t reply[WM_PROVISION_MAX_PACKET];
+    socklen_t client_len;
+    struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+    int sock;
+    
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(WM_PROVISION_PORT);
+    
+    manager->_provisionSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (manager->_provisionSocket < 0) {
+        WM_LOGE("Failed to create provisioning socket");
+        goto cleanup;
+    }
+    sock = manager->_provisionSocket;
+    
+    // The timeout only bounds how long a stop request can go unnoticed
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    
+    if (bind(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        WM_LOGE("Failed to bind provisioning socket");
+        goto cleanup;
+    }
+    
+    WM_LOGI("Provisioning server started on UDP port %d", WM_PROVISION_PORT);
+    
+    while (manager->_provisionRunning) {
+        client_len = sizeof(client_addr);
+        int len = recvfrom(sock, request, sizeof(request), 0,
+                           (struct sockaddr*)&client_addr, &client_len);
+        if (len < 0) {
+            if (manager->_provisionRunning && errno != EAGAIN && errno != EWOULDBLOCK) {
+                WM_LOGE("Provisioning recvfrom error: %d", errno);
+                break;
+            }
+            continue;
+        }
+        
+        size_t reply_len = manager->handleProvisionRequest(request, len, reply);
+        if (reply_len > 0) {
+            // Status changes are pushed to whoever asked last
+            manager->_provisionClient = (uint64_t)client_addr.sin_addr.s_addr << 16 | client_addr.sin_port;
+            sendto(sock, reply, reply_len, 0, (struct sockaddr*)&client_addr, client_len);
+        }
+    }
+    
+cleanup:
+    if (manager->_provisionSocket >= 0) {
+        close(manager->_provisionSocket);
+        manager->_provisionSocket = -1;
+    }
+    
+    WM_LOGI("Provisioning task ended");
+    manager->_provisionTaskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+size_t WiFiManager::handleProvisionRequest(const uint8_t* request, size_t len, uint8_t* reply) {
+    WMProvisionReader in(request, len);
+    if (!in.valid()) {
+        return 0;  // Not ours, stay silent
+    }
+    WMProvisionWriter out(reply, WM_PROVISION_MAX_PACKET, in.op(), in.seq());
+    
+    switch (in.op()) {
+        case WM_PROV_INFO:
+            out.str(_apName.c_str());
+            out.u8(_state);
+            out.u8(_paramsCount);
+            break;
+            
+        case WM_PROV_SCAN: {
+            // Same cache as the HTTP /scan, refreshed in the background when stale
+            uint8_t first = 0;
+            in.u8(first);
+            if (isScanCacheStale()) {
+                performWiFiScan(true);
+            }
+            
+            std::lock_guard<std::mutex> lock(_scanMutex);
+            const WMScanTable& table = _scanTables[_scanFront];
+            if (_scanInProgress && table.empty()) {
+                out.status(WM_PROV_BUSY);
+                break;
+            }
+            out.u8(table.size());
+            out.u8(first);
+            size_t countPos = out.size();
+            out.u8(0);
+            
+            // As many networks as fit, the client asks again from the next index
+            uint8_t n = 0;
+            for (size_t i = first; i < table.size(); i++) {
+                const wifi_ap_record_t& ap = table[i];
+                size_t entry = out.size();
+                if (!(out.str((const char*)ap.ssid) && out.i8(ap.rssi) &&
+                      out.u8(ap.primary) && out.u8(ap.authmode))) {
+                    out.truncate(entry);
+                    break;
+                }
+                n++;
+            }
+            out.set(countPos, n);
+            break;
+        }
+            
+        case WM_PROV_PARAMS: {
+            uint8_t first = 0;
+            in.u8(first);
+            out.u8(_paramsCount);
+            out.u8(first);
+            size_t countPos = out.size();
+            out.u8(0);
+            
+            // Custom HTML entries come through with an empty id so indexes stay stable
+            uint8_t n = 0;
+            for (int i = first; i < _paramsCount; i++) {
+                const WiFiManagerParameter* param = _params[i];
+                size_t maxLen = param->storageSize() - 1;
+                size_t entry = out.size();
+                if (!(out.str(param->getID()) && out.str(param->getLabel()) &&
+                      out.u8(maxLen < 0xFF ? maxLen : 0xFF) &&
+                      out.str(param->getValue(), param->getValueLength()))) {
+                    out.truncate(entry);
+                    break;
+                }
+                n++;
+            }
+            out.set(countPos, n);
+            break;
+        }
+            
+        case WM_PROV_SET_PARAM: {
+            const char* id;
+            const char* value;
+            uint8_t idLen, valueLen;
+            if (!in.str(id, idLen) || !in.str(value, valueLen) || idLen == 0) {
+                out.status(WM_PROV_BAD_REQUEST);
+                break;
+            }
+            WiFiManagerParameter* param = findParameter(id, idLen);
+            if (!param) {
+                out.status(WM_PROV_NOT_FOUND);
+                break;
+            }
+            param->setValue(std::string_view(value, valueLen));
+            WM_LOGD("Updated parameter %s = %s", param->getID(), param->getValue());
+            break;
+        }
+            
+        case WM_PROV_CONNECT: {
+            const char* ssidData;
+            const char* passwordData;
+            uint8_t ssidLen, passwordLen;
+            if (!in.str(ssidData, ssidLen) || !in.str(passwordData, passwordLen) ||
+                ssidLen == 0 || ssidLen > WM_MAX_SSID_LEN || passwordLen > WM_MAX_PASSWORD_LEN) {
+                out.status(WM_PROV_BAD_REQUEST);
+                break;
+            }
+            char ssid[WM_MAX_SSID_LEN + 1] = {0};
+            char password[WM_MAX_PASSWORD_LEN + 1] = {0};
+            memcpy(ssid, ssidData, ssidLen);
+            memcpy(password, passwordData, passwordLen);
+            
+            // The outcome follows as an unsolicited STATUS frame
+            if (!beginPortalConnect(ssid, password)) {
+                out.status(WM_PROV_FAILED);
+            }
+            break;
+        }
+            
+        case WM_PROV_STATUS:
+            return writeProvisionStatus(reply, WM_PROVISION_MAX_PACKET, in.seq());
+            
+        case WM_PROV_EXIT:
+            WM_LOGD("Exit requested");
+            _portalAbortResult = true;
+            setState(WM_STATE_PORTAL_ABORT);
+            xEventGroupSetBits(_eventGroup, WM_EVT_ABORT);
+            break;
+            
+        default:
+            out.status(WM_PROV_UNKNOWN_OP);
+            break;
+    }
+    return out.size();
+}
+
+size_t WiFiManager::writeProvisionStatus(uint8_t* buffer, size_t capacity, uint8_t seq) const {
+    WiFiManagerStatus status = _status.read();
+    WMProvisionWriter out(buffer, capacity, WM_PROV_STATUS, seq);
+    out.u8(status.state);
+    out.u8(status.lastResult);
+    out.u32(ntohl(status.ip.addr));
+    out.i8(status.rssi);
+    return out.size();
+}
+#endif
+
 void WiFiManager::updateState() {
-    // State machine logic based on current state
+    // Deadline-driven transitions; event-driven ones happen in the handlers
     switch (_state) {
         case WM_STATE_TRY_STA:
             // Check connection timeout
-            if (esp_timer_get_time() - _connectStart > _connectTimeout) {
+            if (esp_timer_get_time() - _connectStart > _connectTimeout &&
+                transitionState(WM_STATE_TRY_STA, WM_STATE_START_PORTAL)) {
                 WM_LOGW("STA connection timeout");
-                _lastConxResult = WL_CONNECT_FAILED;
-                _state = WM_STATE_START_PORTAL;
+                setLastConxResult(WL_CONNECT_FAILED);
             }
             break;
             
         case WM_STATE_RUN_PORTAL:
             // Check portal timeout
             if (_configPortalTimeout > 0 && 
-                esp_timer_get_time() - _configPortalStart > _configPortalTimeout) {
+                esp_timer_get_time() - _configPortalStart > _configPortalTimeout &&
+                transitionState(WM_STATE_RUN_PORTAL, WM_STATE_PORTAL_TIMEOUT)) {
                 WM_LOGW("Config portal timeout");
-                _state = WM_STATE_PORTAL_TIMEOUT;
             }
             break;
             
@@ -839,6 +2593,118 @@ void WiFiManager::updateState() {
     }
 }
 
+void WiFiManager::setState(wm_state_t state) {
+    wm_state_t previous = _state.exchange(state);
+    if (previous != state) {
+        WM_LOGD("State %d -> %d", previous, state);
+        _status.update([state](WiFiManagerStatus& status) { status.state = state; });
+        applyPowerProfile();
+    }
+}
+
+bool WiFiManager::transitionState(wm_state_t from, wm_state_t to) {
+    // Only moves on if nobody else changed the state in the meantime
+    if (_state.compare_exchange_strong(from, to)) {
+        WM_LOGD("State %d -> %d", from, to);
+        _status.update([to](WiFiManagerStatus& status) { status.state = to; });
+        applyPowerProfile();
+        return true;
+    }
+    return false;
+}
+
+void WiFiManager::setLastConxResult(wl_status_t result) {
+    _status.update([result](WiFiManagerStatus& status) {
+        status.lastResult = result;
+        if (result != WL_CONNECTED) {
+            status.rssi = 0;
+            status.ip.addr = 0;
+        }
+    });
+}
+
+void WiFiManager::beginConnectAttempt() {
+    int64_t now = esp_timer_get_time();
+    _connectStart = now;
+    _status.update([now](WiFiManagerStatus& status) { status.connectStartUs = now; });
+}
+
+bool WiFiManager::beginPortalConnect(const char* ssid, const char* password) {
+    WM_LOGI("Connecting to SSID: %s", ssid);
+    
+    esp_err_t err;
+#if WM_PROVISION_HTTP
+    bool staOnly = _httpStaOnly;
+#else
+    bool staOnly = false;
+#endif
+    if (!staOnly) {
+        // Switch to AP+STA mode to allow STA configuration
+        WM_LOGI("🔄 Switching to AP+STA mode for connection...");
+        err = esp_wifi_set_mode(WIFI_MODE_APSTA);
+        if (err != ESP_OK) {
+            WM_LOGE("❌ Failed to set AP+STA mode: %s", esp_err_to_name(err));
+            return false;
+        }
+    }
+    
+    // Configure WiFi with new credentials
+    wifi_config_t wifi_config = {};
+    strncpy((char*)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
+    if (password && strlen(password) > 0) {
+        strncpy((char*)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+    }
+    bool directed = applyScannedAP(wifi_config);
+    applyStaConfig(wifi_config);
+    
+    WM_LOGI("🔧 Setting STA configuration...");
+    err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (err != ESP_OK) {
+        WM_LOGE("❌ Failed to set WiFi config: %s", esp_err_to_name(err));
+        return false;
+    }
+    
+    // The attempt is set up before the driver can report on it, a failed directed
+    // attempt falls back to a full scan
+    _connectMetrics = {};
+    _connectMetrics.fastConnect = directed;
+    _fastConnectActive = directed;
+    beginConnectAttempt();
+    setState(WM_STATE_TRY_STA);
+    
+    // Attempt connection
+    WM_LOGI("🌐 Attempting to connect to WiFi...");
+    esp_wifi_disconnect();
+    err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        WM_LOGE("❌ Failed to start WiFi connection: %s", esp_err_to_name(err));
+        // Don't return error here, connection might still succeed
+    }
+    
+    notifyStatus();
+    xEventGroupSetBits(_eventGroup, WM_EVT_SAVED);
+    return true;
+}
+
+WiFiManagerStatus WiFiManager::getStatus() const {
+    return _status.read();
+}
+
+EventBits_t WiFiManager::waitForEvents(EventBits_t bits, int64_t deadline) {
+    TickType_t ticks = portMAX_DELAY;
+    if (deadline > 0) {
+        int64_t remaining_us = deadline - esp_timer_get_time();
+        if (remaining_us <= 0) {
+            return xEventGroupClearBits(_eventGroup, bits) & bits;
+        }
+        ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000);
+        if (ticks == 0) {
+            ticks = 1;
+        }
+    }
+    return xEventGroupWaitBits(_eventGroup, bits, pdTRUE, pdFALSE, ticks) & bits;
+}
+
 bool WiFiManager::getWiFiIsSaved() const {
     wifi_config_t wifi_config;
     esp_err_t ret = esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
@@ -856,22 +2722,114 @@ bool WiFiManager::getWiFiIsSaved() const {
     return configured;
 }
 
-// Additional missing methods
-void WiFiManager::setMinimumSignalQuality(int percent) {
-    _minimumQuality = percent;
-    WM_LOGD("Minimum signal quality set to %d%%", percent);
+// IP configuration
+void WiFiManager::setAPStaticIPConfig(ip4_addr_t ip, ip4_addr_t gw, ip4_addr_t netmask) {
+    _apIP = ip;
+    _apGW = gw;
+    _apNetmask = netmask;
+    _apStaticIPSet = true;
+    WM_LOGD("AP static IP set to " IPSTR, IP2STR(&_apIP));
+}
+
+// Additional missing methods
+void WiFiManager::setMinimumSignalQuality(int percent) {
+    _minimumQuality = percent;
+    WM_LOGD("Minimum signal quality set to %d%%", percent);
+}
+
+void WiFiManager::setRemoveDuplicateAPs(bool remove) {
+    _removeDuplicateAPs = remove;
+    WM_LOGD("Remove duplicate APs set to %s", remove ? "true" : "false");
+}
+
+void WiFiManager::setScanCacheMaxAge(uint32_t seconds) {
+    _scanCacheMaxAge = seconds * 1000000ULL; // Convert to microseconds
+    WM_LOGD("Scan cache max age set to %lu seconds", seconds);
+}
+
+void WiFiManager::setScanConfig(const wm_scan_config_t& config) {
+    _scanConfig = config;
+    WM_LOGD("Scan config set: %d channels/slice, home %d ms, dwell %d/%d ms, passive mask 0x%04x",
+            _scanConfig.channelsPerSlice, _scanConfig.homeDwellMs, _scanConfig.activeDwellMs,
+            _scanConfig.passiveDwellMs, _scanConfig.passiveChannels);
+}
+
+wm_scan_config_t WiFiManager::getScanConfig() const {
+    return _scanConfig;
+}
+
+bool WiFiManager::preloadWiFiScan(bool enable) {
+    _preloadScan = enable;
+    WM_LOGD("Preload WiFi scan set to %s", enable ? "true" : "false");
+    
+    // Kick off a background scan right away if the driver is already running
+    wifi_mode_t mode;
+    if (enable && esp_wifi_get_mode(&mode) == ESP_OK && mode != WIFI_MODE_NULL) {
+        performWiFiScan(true);
+    }
+    return true;
+}
+
+void WiFiManager::setMenu(const menu_page_t* menu, uint8_t size) {
+    _menuPages.assign(menu, menu + size);
 }
 
-void WiFiManager::setRemoveDuplicateAPs(bool remove) {
-    _removeDuplicateAPs = remove;
-    WM_LOGD("Remove duplicate APs set to %s", remove ? "true" : "false");
+void WiFiManager::setClass(const char* cssClass) {
+    _cssClass = cssClass ? cssClass : "";
+}
+
+void WiFiManager::setCustomHeadElement(const char* html) {
+    _customHeadElement = html ? html : "";
 }
 
 void WiFiManager::addParameter(WiFiManagerParameter* parameter) {
-    if (parameter && _params.size() < WM_MAX_CUSTOM_PARAMS) {
-        _params.push_back(std::unique_ptr<WiFiManagerParameter>(parameter));
-        WM_LOGD("Added custom parameter: %s", parameter->getID());
+    if (parameter && _paramsCount < WM_MAX_CUSTOM_PARAMS) {
+        _params[_paramsCount++] = parameter;
+        
+        // Carve the value buffer out of the arena, parameters that don't fit keep their own
+        size_t size = parameter->storageSize();
+        if (WM_PARAM_ARENA_SIZE > 0 && _paramArenaUsed + size <= WM_PARAM_ARENA_SIZE) {
+            parameter->attachStorage(_paramArena + _paramArenaUsed);
+            _paramArenaUsed += size;
+        }
+        WM_LOGD("Added custom parameter: %s (arena %d/%d bytes)", parameter->getID(),
+                _paramArenaUsed, WM_PARAM_ARENA_SIZE);
+        
+        // Keep the form lookup sorted so /wifisave resolves each key with a binary search
+        const char* id = parameter->getID();
+        if (id && id[0]) {
+            ParamIndexEntry entry = {WMFormParser::hashKey(id, strlen(id)),
+                                     static_cast<uint8_t>(_paramsCount - 1)};
+            ParamIndexEntry* end = _paramIndex + _paramIndexCount;
+            ParamIndexEntry* pos = std::upper_bound(_paramIndex, end, entry.hash,
+                [](uint32_t hash, const ParamIndexEntry& e) { return hash < e.hash; });
+            std::move_backward(pos, end, end + 1);
+            *pos = entry;
+            _paramIndexCount++;
+        }
+    }
+}
+
+WiFiManagerParameter** WiFiManager::getParameters() {
+    return _params;
+}
+
+int WiFiManager::getParametersCount() const {
+    return _paramsCount;
+}
+
+WiFiManagerParameter* WiFiManager::findParameter(const char* id, size_t len) const {
+    uint32_t hash = WMFormParser::hashKey(id, len);
+    const ParamIndexEntry* end = _paramIndex + _paramIndexCount;
+    const ParamIndexEntry* it = std::lower_bound(_paramIndex, end, hash,
+        [](const ParamIndexEntry& e, uint32_t h) { return e.hash < h; });
+    for (; it != end && it->hash == hash; ++it) {
+        WiFiManagerParameter* param = _params[it->param];
+        if (strncmp(param->getID(), id, len) == 0 && param->getID()[len] == '\0') {
+            return param;
+        }
     }
+    return nullptr;
 }
 
 std::string WiFiManager::getSSID() const {
@@ -900,10 +2858,44 @@ void WiFiManager::wifiEventHandler(void* arg, esp_event_base_t event_base,
     switch (event_id) {
         case WIFI_EVENT_STA_START:
             WM_LOGI("STA started");
+            // An async scan was waiting for the STA interface to come up
+            if (manager->_scanWaitSTAStart) {
+                manager->_scanWaitSTAStart = false;
+                if (!manager->startScanDriver(false)) {
+                    manager->_scanAsync = false;
+                    manager->_scanInProgress = false;
+                }
+            }
+            break;
+            
+        case WIFI_EVENT_SCAN_DONE: {
+            wifi_event_sta_scan_done_t* done = 
+                static_cast<wifi_event_sta_scan_done_t*>(event_data);
+            // Blocking scans collect their own results
+            if (!manager->_scanAsync) {
+                break;
+            }
+            WM_LOGD("Async scan done, status: %lu, found: %d", done->status, done->number);
+            
+            if (manager->_scanSliced) {
+                manager->continueSlicedScan(done->status == 0);
+                break;
+            }
+            
+            if (done->status == 0) {
+                manager->publishScanResults();
+            } else {
+                WM_LOGW("⚠️  Async scan failed, keeping cached results");
+                esp_wifi_clear_ap_list();
+            }
+            manager->finishAsyncScan();
             break;
+        }
             
         case WIFI_EVENT_STA_CONNECTED:
             WM_LOGI("STA connected to AP");
+            manager->_connectMetrics.associatedUs = esp_timer_get_time() - manager->_connectStart;
+            WM_METRIC_PHASE_SET(manager->_metrics, WM_PHASE_STA_ASSOC, manager->_connectMetrics.associatedUs);
             break;
             
         case WIFI_EVENT_STA_DISCONNECTED: {
@@ -911,35 +2903,69 @@ void WiFiManager::wifiEventHandler(void* arg, esp_event_base_t event_base,
                 static_cast<wifi_event_sta_disconnected_t*>(event_data);
             WM_LOGW("STA disconnected, reason: %d", disconnected->reason);
             
+            // The link monitor dropped the link itself and waits for the new one;
+            // anything but its own ASSOC_LEAVE means the directed connect failed
+            if (manager->_roaming == WM_ROAM_DIRECTED) {
+                if (disconnected->reason != WIFI_REASON_ASSOC_LEAVE) {
+                    xEventGroupSetBits(manager->_eventGroup, WM_EVT_DISCONNECTED);
+                }
+                break;
+            }
+            
+            // The roam's fallback reconnect failed too, the scheduler takes over
+            uint8_t fallback = WM_ROAM_FALLBACK;
+            manager->_roaming.compare_exchange_strong(fallback, WM_ROAM_IDLE);
+            
+            // Our own esp_wifi_disconnect() tearing down the previous link of an attempt
+            // that is already under way; its outcome comes with the next event
+            if (disconnected->reason == WIFI_REASON_ASSOC_LEAVE && manager->_state == WM_STATE_TRY_STA) {
+                break;
+            }
+            
+            // A failed directed connect retries with a full scan before counting as a failure
+            if (manager->_fastConnectActive && manager->_state == WM_STATE_TRY_STA) {
+                manager->fallbackFromFastConnect();
+                break;
+            }
+            
             // Map disconnect reason to wl_status_t
             switch (disconnected->reason) {
                 case WIFI_REASON_NO_AP_FOUND:
                 case WIFI_REASON_NO_AP_FOUND_W_COMPATIBLE_SECURITY:
                 case WIFI_REASON_NO_AP_FOUND_IN_AUTHMODE_THRESHOLD:
                 case WIFI_REASON_NO_AP_FOUND_IN_RSSI_THRESHOLD:
-                    manager->_lastConxResult = WL_NO_SSID_AVAIL;
+                    manager->setLastConxResult(WL_NO_SSID_AVAIL);
                     break;
                 case WIFI_REASON_AUTH_EXPIRE:
                 case WIFI_REASON_AUTH_LEAVE:
                 case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
                 case WIFI_REASON_GROUP_KEY_UPDATE_TIMEOUT:
                 case WIFI_REASON_802_1X_AUTH_FAILED:
-                    manager->_lastConxResult = WL_WRONG_PASSWORD;
+                    manager->setLastConxResult(WL_WRONG_PASSWORD);
                     break;
                 default:
-                    manager->_lastConxResult = WL_CONNECT_FAILED;
+                    manager->setLastConxResult(WL_CONNECT_FAILED);
                     break;
             }
             
             // If we're in STA connection attempt, transition to portal
-            if (manager->_state == WM_STATE_TRY_STA) {
-                manager->_state = WM_STATE_START_PORTAL;
+            manager->transitionState(WM_STATE_TRY_STA, WM_STATE_START_PORTAL);
+            manager->notifyStatus();
+            
+            // An established link that dropped (or a retry of it) gets the backoff scheduler;
+            // ASSOC_LEAVE is our own esp_wifi_disconnect()
+            if ((manager->_state == WM_STATE_RUN_STA || manager->_reconnectAttempts > 0) &&
+                disconnected->reason != WIFI_REASON_ASSOC_LEAVE) {
+                manager->scheduleReconnect(disconnected->reason);
             }
+            xEventGroupClearBits(manager->_eventGroup, WM_EVT_GOT_IP);
+            xEventGroupSetBits(manager->_eventGroup, WM_EVT_DISCONNECTED);
             break;
         }
         
         case WIFI_EVENT_AP_START:
             WM_LOGI("AP started");
+            xEventGroupSetBits(manager->_eventGroup, WM_EVT_AP_START);
             break;
             
         case WIFI_EVENT_AP_STOP:
@@ -980,11 +3006,40 @@ void WiFiManager::ipEventHandler(void* arg, esp_event_base_t event_base,
             WM_LOGI("STA netmask: " IPSTR, IP2STR(&event->ip_info.netmask));
             WM_LOGI("STA gateway: " IPSTR, IP2STR(&event->ip_info.gw));
             
-            manager->_lastConxResult = WL_CONNECTED;
-            manager->_state = WM_STATE_RUN_STA;
+            manager->_connectMetrics.gotIPUs = esp_timer_get_time() - manager->_connectStart;
+            WM_METRIC_PHASE_SET(manager->_metrics, WM_PHASE_STA_DHCP,
+                                manager->_connectMetrics.gotIPUs - manager->_connectMetrics.associatedUs);
+            WM_LOGI("⏱️  Connected in %lld ms (directed: %s, cached IP: %s)",
+                    manager->_connectMetrics.gotIPUs / 1000,
+                    manager->_connectMetrics.fastConnect && !manager->_connectMetrics.fastConnectFallback ? "yes" : "no",
+                    manager->_connectMetrics.cachedIP ? "yes" : "no");
+            manager->_fastConnectActive = false;
+            if (manager->_fastConnectEnabled) {
+                manager->saveFastConnect(event->ip_info);
+            }
+            manager->recordCredentialSuccess();
+            
+            // Result, address and signal land in one snapshot update
+            wifi_ap_record_t ap_info;
+            int8_t rssi = esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK ? ap_info.rssi : 0;
+            int64_t now = esp_timer_get_time();
+            manager->_status.update([&](WiFiManagerStatus& status) {
+                status.lastResult = WL_CONNECTED;
+                status.rssi = rssi;
+                status.ip = event->ip_info.ip;
+                status.connectedUs = now;
+            });
+            manager->setState(WM_STATE_RUN_STA);
+            manager->notifyStatus();  // Before the portal is told to shut down
             
-            // Trigger save config callback
-            if (manager->_saveConfigCallback) {
+            // Taken before roam() is woken, so its timing can't decide this
+            bool roamed = manager->_roaming.exchange(WM_ROAM_IDLE) != WM_ROAM_IDLE;
+            xEventGroupSetBits(manager->_eventGroup, WM_EVT_GOT_IP);
+            manager->startLinkMonitor();
+            manager->finishReconnect(true);
+            
+            // Trigger save config callback, a roam (or its fallback) is not a new configuration
+            if (manager->_saveConfigCallback && !roamed) {
                 manager->_saveConfigCallback();
             }
             break;
@@ -992,7 +3047,8 @@ void WiFiManager::ipEventHandler(void* arg, esp_event_base_t event_base,
         
         case IP_EVENT_STA_LOST_IP:
             WM_LOGW("STA lost IP");
-            manager->_lastConxResult = WL_CONNECTION_LOST;
+            manager->setLastConxResult(WL_CONNECTION_LOST);
+            manager->notifyStatus();
             break;
             
         case IP_EVENT_AP_STAIPASSIGNED: {
@@ -1034,121 +3090,426 @@ const char* WiFiManager::getModeString(wifi_mode_t mode) const {
     }
 }
 
-// DNS Server Implementation
+// Async request workers
+
+void WiFiManager::setHTTPServerConfig(const wm_http_config_t& config) {
+    _httpConfig = config;
+    if (_httpConfig.maxOpenSockets == 0) {
+        _httpConfig.maxOpenSockets = 1;
+    }
+    WM_LOGD("HTTP server config set: sockets %d, timeouts %d/%d s, LRU %s, core %d, heap budget %lu",
+            _httpConfig.maxOpenSockets, _httpConfig.recvTimeout, _httpConfig.sendTimeout,
+            _httpConfig.lruPurge ? "on" : "off", _httpConfig.coreId, (unsigned long)_httpConfig.heapBudget);
+}
+
+wm_http_config_t WiFiManager::getHTTPServerConfig() const {
+    return _httpConfig;
+}
+
+#if WM_PROVISION_HTTP
+bool WiFiManager::startAsyncWorkers() {
+#if WM_HTTP_ASYNC
+    if (_asyncQueue) {
+        return true;
+    }
+    
+    _asyncQueue = xQueueCreate(WM_HTTP_ASYNC_QUEUE_LEN, sizeof(AsyncRequest));
+    if (!_asyncQueue) {
+        WM_LOGE("Failed to create async request queue");
+        return false;
+    }
+    
+    BaseType_t core = _httpConfig.coreId < 0 ? tskNO_AFFINITY : _httpConfig.coreId;
+    for (int i = 0; i < WM_HTTP_ASYNC_WORKERS; i++) {
+        if (xTaskCreatePinnedToCore(asyncWorkerTask, "wm_async", WM_HTTP_ASYNC_STACK_SIZE,
+                                    this, 5, &_asyncWorkers[i], core) != pdPASS) {
+            WM_LOGE("Failed to create async worker %d", i);
+            _asyncWorkers[i] = nullptr;
+        }
+    }
+    WM_LOGD("Started %d async workers", WM_HTTP_ASYNC_WORKERS);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void WiFiManager::stopAsyncWorkers() {
+#if WM_HTTP_ASYNC
+    if (!_asyncQueue) {
+        return;
+    }
+    
+    // One empty request per worker, queued behind any pending work
+    AsyncRequest stop = {nullptr, nullptr};
+    for (int i = 0; i < WM_HTTP_ASYNC_WORKERS; i++) {
+        if (_asyncWorkers[i]) {
+            xQueueSend(_asyncQueue, &stop, pdMS_TO_TICKS(1000));
+        }
+    }
+    
+    // Wait for the workers to finish
+    for (int i = 0; i < WM_HTTP_ASYNC_WORKERS; i++) {
+        int timeout = 50; // 5 seconds
+        while (_asyncWorkers[i] && timeout-- > 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        if (_asyncWorkers[i]) {
+            WM_LOGW("Async worker %d did not terminate gracefully, deleting", i);
+            vTaskDelete(_asyncWorkers[i]);
+            _asyncWorkers[i] = nullptr;
+        }
+    }
+    
+    // Requests still queued after a forced stop are released without a response
+    AsyncRequest pending;
+    while (xQueueReceive(_asyncQueue, &pending, 0) == pdTRUE) {
+        if (pending.req) {
+            httpd_req_async_handler_complete(pending.req);
+        }
+    }
+    vQueueDelete(_asyncQueue);
+    _asyncQueue = nullptr;
+#endif
+}
+
+void WiFiManager::asyncWorkerTask(void* pvParameters) {
+    WiFiManager* manager = static_cast<WiFiManager*>(pvParameters);
+    
+#if WM_HTTP_ASYNC
+    AsyncRequest work;
+    while (xQueueReceive(manager->_asyncQueue, &work, portMAX_DELAY) == pdTRUE) {
+        if (!work.req) {
+            break;
+        }
+        
+        work.handler(work.req);
+        httpd_req_async_handler_complete(work.req);
+    }
+    
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < WM_HTTP_ASYNC_WORKERS; i++) {
+        if (manager->_asyncWorkers[i] == self) {
+            manager->_asyncWorkers[i] = nullptr;
+        }
+    }
+#else
+    (void)manager;
+#endif
+    vTaskDelete(nullptr);
+}
+
+esp_err_t WiFiManager::queueAsyncRequest(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t*)) {
+#if WM_HTTP_ASYNC
+    WiFiManager* manager = getManagerFromRequest(req);
+    if (!manager->_asyncQueue) {
+        return handler(req);
+    }
+    
+    // The copy keeps the socket alive after this handler returns to the server task
+    AsyncRequest work = {nullptr, handler};
+    esp_err_t ret = httpd_req_async_handler_begin(req, &work.req);
+    if (ret != ESP_OK) {
+        WM_LOGW("Async handler unavailable (%s), handling inline", esp_err_to_name(ret));
+        return handler(req);
+    }
+    
+    if (xQueueSend(manager->_asyncQueue, &work, 0) != pdTRUE) {
+        WM_LOGW("Async queue full, rejecting %s", req->uri);
+        ret = sendBusy(work.req);
+        httpd_req_async_handler_complete(work.req);
+        return ret;
+    }
+    return ESP_OK;
+#else
+    return handler(req);
+#endif
+}
+
+// Portal heap budget
+
+void WiFiManager::checkPortalHeap() {
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    _portalLean = largest < WM_PORTAL_MIN_FREE_BLOCK;
+    if (_portalLean) {
+        WM_LOGW("⚠️ Low memory (largest free block %u bytes), starting a lean portal", (unsigned)largest);
+    } else {
+        WM_LOGD("Portal heap preflight: largest free block %u bytes", (unsigned)largest);
+    }
+}
+
+bool WiFiManager::reserveHeap(uint32_t bytes) {
+    // One request always gets through, even with a budget smaller than its cost
+    uint32_t budget = _httpConfig.heapBudget;
+    uint32_t reserved = _httpHeapReserved.load(std::memory_order_relaxed);
+    do {
+        if (budget > 0 && reserved > 0 && reserved + bytes > budget) {
+            WM_LOGD("Heap budget exhausted (%lu/%lu bytes)", (unsigned long)reserved, (unsigned long)budget);
+            return false;
+        }
+    } while (!_httpHeapReserved.compare_exchange_weak(reserved, reserved + bytes, std::memory_order_relaxed));
+    
+    // The budget only knows about our handlers, the rest of the system allocates too
+    size_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (freeHeap < bytes + WM_HTTP_HEAP_RESERVE) {
+        WM_LOGD("Free heap too low for a request (%u bytes)", (unsigned)freeHeap);
+        releaseHeap(bytes);
+        return false;
+    }
+    return true;
+}
+
+void WiFiManager::releaseHeap(uint32_t bytes) {
+    _httpHeapReserved.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+esp_err_t WiFiManager::sendBusy(httpd_req_t *req) {
+    int sent = httpd_send(req, BUSY_RESPONSE, sizeof(BUSY_RESPONSE) - 1);
+    return sent == (int)sizeof(BUSY_RESPONSE) - 1 ? ESP_OK : ESP_FAIL;
+}
+
+#endif
+
+// Connection progress events
+
+void WiFiManager::notifyStatus() {
+#if WM_PROVISION_UDP
+    // Unsolicited STATUS frame (sequence 0) to the last provisioning client
+    uint64_t client = _provisionClient;
+    int sock = _provisionSocket;
+    if (client != 0 && sock >= 0) {
+        uint8_t frame[16];
+        size_t len = writeProvisionStatus(frame, sizeof(frame), 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = client >> 16;
+        addr.sin_port = client & 0xFFFF;
+        sendto(sock, frame, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+    }
+#elif WM_HTTP_EVENTS
+    // Event handlers run on the event loop task; the clients belong to the server task
+    httpd_handle_t server = _httpServer;
+    if (server) {
+        httpd_queue_work(server, broadcastStatus, this);
+    }
+#endif
+}
+
+#if WM_PROVISION_HTTP
+
+void WiFiManager::writeStatus(WMJsonWriter& json) const {
+    wifi_ap_record_t ap_info;
+    bool connected = (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK);
+    
+    // Get saved WiFi config using WiFi API (not direct NVS access)
+    wifi_config_t wifi_config = {};
+    bool has_saved_config = (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK);
+    bool has_saved_ssid = has_saved_config && (strlen((char*)wifi_config.sta.ssid) > 0);
+    
+    WiFiManagerStatus status = _status.read();
+    char ip_str[16];
+    snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&status.ip));
+    
+    json.beginObject();
+    json.field("connected", connected);
+    json.field("connecting", status.state == WM_STATE_TRY_STA);
+    json.field("result", getWLStatusString(status.lastResult));
+    if (connected) {
+        json.field("ssid", (const char*)ap_info.ssid);
+        json.field("ip", ip_str);
+    } else if (has_saved_ssid) {
+        json.field("saved_ssid", (const char*)wifi_config.sta.ssid);
+    }
+    json.endObject();
+}
+
+esp_err_t WiFiManager::sendEvent(httpd_req_t *req, const char* data, size_t len) {
+    esp_err_t err = httpd_resp_send_chunk(req, "data: ", 6);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, data, len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "\n\n", 2);
+    }
+    return err;
+}
+
+// Collects a small JSON document into a fixed buffer
+struct WMStatusBuffer {
+    char data[WM_JSON_CHUNK_SIZE];
+    size_t len;
+    
+    static esp_err_t sink(void* ctx, const char* data, size_t len) {
+        WMStatusBuffer* buf = static_cast<WMStatusBuffer*>(ctx);
+        if (buf->len + len > sizeof(buf->data)) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(buf->data + buf->len, data, len);
+        buf->len += len;
+        return ESP_OK;
+    }
+};
+
+void WiFiManager::broadcastStatus(void* arg) {
+#if WM_HTTP_EVENTS
+    WiFiManager* manager = static_cast<WiFiManager*>(arg);
+    
+    // One snapshot for every client
+    WMStatusBuffer status = {};
+    WMJsonWriter json(WMStatusBuffer::sink, &status);
+    manager->writeStatus(json);
+    if (json.finish() != ESP_OK) {
+        return;
+    }
+    
+    for (auto& client : manager->_eventClients) {
+        if (client && sendEvent(client, status.data, status.len) != ESP_OK) {
+            WM_LOGD("Event client gone, releasing its socket");
+            httpd_req_async_handler_complete(client);
+            client = nullptr;
+        }
+    }
+#endif
+}
 
-#define DNS_PORT 53
-#define DNS_MAX_PACKET_SIZE 512
+void WiFiManager::closeEventClients(void* arg) {
+#if WM_HTTP_EVENTS
+    WiFiManager* manager = static_cast<WiFiManager*>(arg);
+    for (auto& client : manager->_eventClients) {
+        if (client) {
+            httpd_resp_send_chunk(client, nullptr, 0);
+            httpd_req_async_handler_complete(client);
+            client = nullptr;
+        }
+    }
+#endif
+}
 
-// DNS header structure
-typedef struct {
-    uint16_t id;        // Identification
-    uint16_t flags;     // Flags
-    uint16_t qdcount;   // Question count
-    uint16_t ancount;   // Answer count
-    uint16_t nscount;   // Authority count
-    uint16_t arcount;   // Additional count
-} __attribute__((packed)) dns_header_t;
+esp_err_t WiFiManager::handleEvents(httpd_req_t *req) {
+    WM_LOGD("Event stream requested");
+    WiFiManager* manager = getManagerFromRequest(req);
+    WM_METRIC_REQUEST(manager->_metrics, WM_ROUTE_EVENTS);
+    
+#if WM_HTTP_EVENTS
+    // A full table drops the first stream; EventSource reconnects on its own
+    auto& slots = manager->_eventClients;
+    auto slot = std::find(std::begin(slots), std::end(slots), nullptr);
+    if (slot == std::end(slots)) {
+        WM_LOGD("Event client table full, dropping a stream");
+        httpd_resp_send_chunk(slots[0], nullptr, 0);
+        httpd_req_async_handler_complete(slots[0]);
+        std::move(std::begin(slots) + 1, std::end(slots), std::begin(slots));
+        slot = std::end(slots) - 1;
+        *slot = nullptr;
+    }
+    
+    httpd_req_t* client = nullptr;
+    esp_err_t ret = httpd_req_async_handler_begin(req, &client);
+    if (ret != ESP_OK) {
+        WM_LOGW("Cannot hold event stream open: %s", esp_err_to_name(ret));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Event stream unavailable");
+    }
+    
+    httpd_resp_set_type(client, "text/event-stream");
+    httpd_resp_set_hdr(client, "Cache-Control", "no-store");
+    
+    // Current state first so the page never waits for the next change
+    WMStatusBuffer status = {};
+    WMJsonWriter json(WMStatusBuffer::sink, &status);
+    manager->writeStatus(json);
+    ret = json.finish();
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(client, "retry: 3000\n", 12);
+    }
+    if (ret == ESP_OK) {
+        ret = sendEvent(client, status.data, status.len);
+    }
+    if (ret != ESP_OK) {
+        httpd_req_async_handler_complete(client);
+        return ret;
+    }
+    
+    *slot = client;
+    return ESP_OK;
+#else
+    (void)manager;
+    return httpd_resp_send_404(req);
+#endif
+}
 
-// DNS flags
-#define DNS_FLAG_RESPONSE   0x8000
-#define DNS_FLAG_AA         0x0400  // Authoritative Answer
+// DNS Server Implementation
 
 void WiFiManager::dnsServerTask(void* pvParameters) {
     WiFiManager* manager = static_cast<WiFiManager*>(pvParameters);
     
     struct sockaddr_in server_addr = {};
     struct sockaddr_in client_addr;
-    uint8_t buffer[DNS_MAX_PACKET_SIZE];
-    socklen_t client_len = sizeof(client_addr);
+    uint8_t buffer[WMDnsResponder::MAX_PACKET_SIZE];
+    socklen_t client_len;
     int reuse = 1;
+    int sock;
+    WMDnsResponder responder(manager->_apIP.addr);
     
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(DNS_PORT);
+    server_addr.sin_port = htons(WM_DNS_PORT);
     
     manager->_dnsSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (manager->_dnsSocket < 0) {
         WM_LOGE("Failed to create DNS socket");
         goto cleanup;
     }
+    sock = manager->_dnsSocket;
     
-    setsockopt(manager->_dnsSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
     
-    if (bind(manager->_dnsSocket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+    if (bind(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         WM_LOGE("Failed to bind DNS socket");
         goto cleanup;
     }
     
-    WM_LOGI("DNS server started on port %d", DNS_PORT);
+    WM_LOGI("DNS server started on port %d, answering with " IPSTR, WM_DNS_PORT, IP2STR(&manager->_apIP));
     
     while (manager->_dnsRunning) {
-        int len = recvfrom(manager->_dnsSocket, buffer, sizeof(buffer) - 1, 0,
-                          (struct sockaddr*)&client_addr, &client_len);
+        // Block until a query arrives; the timeout only bounds how long a stop request can go unnoticed
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(sock, &readfds);
+        struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+        int ready = select(sock + 1, &readfds, nullptr, nullptr, &tv);
+        if (ready < 0) {
+            if (manager->_dnsRunning && errno != EINTR) {
+                WM_LOGE("DNS select error: %d", errno);
+                break;
+            }
+            continue;
+        }
+        if (ready == 0) {
+            continue;
+        }
         
-        if (len > 0) {
-            WM_LOGD("DNS query from " IPSTR ":%d, length: %d", 
-                   IP2STR((ip4_addr_t*)&client_addr.sin_addr), 
-                   ntohs(client_addr.sin_port), len);
-            
-            // Create simple DNS response that redirects all queries to AP IP
-            if (len >= sizeof(dns_header_t)) {
-                dns_header_t* header = (dns_header_t*)buffer;
-                
-                // Modify header for response
-                header->flags = htons(ntohs(header->flags) | DNS_FLAG_RESPONSE | DNS_FLAG_AA);
-                header->ancount = header->qdcount; // Same number of answers as questions
-                header->nscount = 0;
-                header->arcount = 0;
-                
-                // For simplicity, we'll append a basic A record response
-                // This is a simplified implementation that works for most cases
-                uint8_t response[DNS_MAX_PACKET_SIZE];
-                memcpy(response, buffer, len);
-                int response_len = len;
-                
-                // Add a simple A record pointing to AP IP (192.168.4.1)
-                if (response_len + 16 < sizeof(response)) {
-                    // Name (compressed pointer to question)
-                    response[response_len++] = 0xC0;
-                    response[response_len++] = 0x0C; // Pointer to offset 12 (question)
-                    
-                    // Type (A record)
-                    response[response_len++] = 0x00;
-                    response[response_len++] = 0x01;
-                    
-                    // Class (Internet)
-                    response[response_len++] = 0x00;
-                    response[response_len++] = 0x01;
-                    
-                    // TTL (60 seconds)
-                    response[response_len++] = 0x00;
-                    response[response_len++] = 0x00;
-                    response[response_len++] = 0x00;
-                    response[response_len++] = 0x3C;
-                    
-                    // Data length (4 bytes for IPv4)
-                    response[response_len++] = 0x00;
-                    response[response_len++] = 0x04;
-                    
-                    // IP address (AP IP: 192.168.4.1)
-                    response[response_len++] = 192;
-                    response[response_len++] = 168;
-                    response[response_len++] = 4;
-                    response[response_len++] = 1;
+        // Drain every queued query before blocking again, phones send them in bursts
+        int flags = 0;
+        while (manager->_dnsRunning) {
+            client_len = sizeof(client_addr);
+            int len = recvfrom(sock, buffer, sizeof(buffer), flags,
+                               (struct sockaddr*)&client_addr, &client_len);
+            if (len < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && manager->_dnsRunning) {
+                    WM_LOGE("DNS recvfrom error: %d", errno);
                 }
-                
-                sendto(manager->_dnsSocket, response, response_len, 0,
-                       (struct sockaddr*)&client_addr, client_len);
-                WM_LOGV("DNS response sent, length: %d", response_len);
+                break;
             }
-        } else if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-            if (manager->_dnsRunning) {
-                WM_LOGE("DNS recvfrom error: %d", errno);
+            flags = MSG_DONTWAIT;
+            
+            WM_METRIC_DNS_QUERY(manager->_metrics);
+            int response_len = responder.respond(buffer, len);
+            if (response_len > 0) {
+                sendto(sock, buffer, response_len, 0, (struct sockaddr*)&client_addr, client_len);
+                WM_LOGV("DNS response sent to " IPSTR ", length: %d",
+                        IP2STR((ip4_addr_t*)&client_addr.sin_addr), response_len);
             }
-            break;
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(10)); // Small delay to prevent tight loop
     }
     
 cleanup:
@@ -1162,16 +3523,25 @@ cleanup:
     vTaskDelete(nullptr);
 }
 
+#endif
+
 // Enhanced WiFi Scanning Implementation
 
 void WiFiManager::performWiFiScan(bool async) {
     if (_scanInProgress) {
-        WM_LOGD("Scan already in progress");
-        return;
+        // Recover from a scan whose completion event never arrived
+        if (esp_timer_get_time() - _scanStartTime < WM_SCAN_TIMEOUT_MS * 1000LL) {
+            WM_LOGD("Scan already in progress");
+            return;
+        }
+        WM_LOGW("⚠️  Previous scan timed out, starting a new one");
+        _scanWaitSTAStart = false;
     }
     
     WM_LOGI("🔍 Starting WiFi scan (async: %s)", async ? "true" : "false");
     _scanInProgress = true;
+    _scanAsync = async;
+    _scanStartTime = esp_timer_get_time();
     
     // Get current WiFi mode
     wifi_mode_t current_mode;
@@ -1181,173 +3551,322 @@ void WiFiManager::performWiFiScan(bool async) {
     bool mode_changed = false;
     if (current_mode == WIFI_MODE_AP) {
         WM_LOGI("🔄 Switching to AP+STA mode for scanning...");
+        int64_t switch_start = esp_timer_get_time();
         esp_err_t ret = esp_wifi_set_mode(WIFI_MODE_APSTA);
+        WM_METRIC_PHASE_SET(_metrics, WM_PHASE_SCAN_MODE, esp_timer_get_time() - switch_start);
+        (void)switch_start;
         if (ret != ESP_OK) {
             WM_LOGE("❌ Failed to set APSTA mode for scanning: %s", esp_err_to_name(ret));
+            _scanAsync = false;
             _scanInProgress = false;
             return;
         }
         mode_changed = true;
+        
+        if (async) {
+            // The scan is started from WIFI_EVENT_STA_START once the STA is up
+            _scanRestoreAP = true;
+            _scanWaitSTAStart = true;
+            return;
+        }
         // Give it a moment to switch modes
         vTaskDelay(pdMS_TO_TICKS(500));
     }
     
-    // Configure scan parameters
+    if (!startScanDriver(!async)) {
+        _scanAsync = false;
+        _scanInProgress = false;
+        
+        // Restore original mode if we changed it
+        if (mode_changed) {
+            esp_wifi_set_mode(current_mode);
+        }
+        return;
+    }
+    
+    if (!async) {
+        // Blocking scan - get results immediately
+        publishScanResults();
+        _scanInProgress = false;
+        
+        // Restore original mode if we changed it
+        if (mode_changed) {
+            WM_LOGI("🔄 Restoring AP mode after scan...");
+            esp_wifi_set_mode(current_mode);
+        }
+    }
+    // For async scans, results will be processed in the WiFi event handler
+}
+
+bool WiFiManager::startScanDriver(bool block) {
+    // Background scans hand the radio back to the softAP between slices
+    if (!block && _scanConfig.channelsPerSlice > 0) {
+        return startSlicedScan();
+    }
+    _scanSliced = false;
+    
+    // Configure scan parameters
+    wifi_scan_config_t scan_config = {};
+    scan_config.ssid = nullptr;
+    scan_config.bssid = nullptr;
+    scan_config.channel = 0;
+    scan_config.show_hidden = true;
+    scan_config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+    scan_config.scan_time.active.min = 100;
+    scan_config.scan_time.active.max = 300;
+    
+    esp_err_t ret = esp_wifi_scan_start(&scan_config, block);
+    if (ret != ESP_OK) {
+        WM_LOGE("❌ WiFi scan failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+    return true;
+}
+
+bool WiFiManager::startSlicedScan() {
+    wifi_country_t country = {};
+    uint8_t first = 1, count = 13;
+    if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0) {
+        first = country.schan;
+        count = country.nchan;
+    }
+    
+    uint8_t home = 0;
+    wifi_second_chan_t second;
+    wifi_mode_t mode;
+    if (_scanConfig.homeChannelFirst && esp_wifi_get_mode(&mode) == ESP_OK &&
+        (mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA)) {
+        esp_wifi_get_channel(&home, &second);
+    }
+    
+    _scanChannelCount = 0;
+    if (home >= first && home < first + count) {
+        _scanChannels[_scanChannelCount++] = home;
+    }
+    for (uint8_t ch = first; ch < first + count && _scanChannelCount < WM_SCAN_MAX_CHANNELS; ch++) {
+        if (ch != home) {
+            _scanChannels[_scanChannelCount++] = ch;
+        }
+    }
+    
+    if (!_scanSliceTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = scanSliceTimerCallback;
+        args.arg = this;
+        args.name = "wm_scan";
+        if (esp_timer_create(&args, &_scanSliceTimer) != ESP_OK) {
+            _scanSliceTimer = nullptr;
+        }
+    }
+    
+    if (_scanSliceTimer) {
+        esp_timer_stop(_scanSliceTimer);  // Left over from a scan that timed out
+    }
+    
+    // Slices accumulate into a copy of the current results, so networks on channels
+    // not scanned yet stay listed; the ones nobody reported go when every channel is done.
+    // No flip happens until the first slice is in, the front is ours to read meanwhile.
+    _scanTables[_scanFront ^ 1] = _scanTables[_scanFront];
+    _scanTables[_scanFront ^ 1].refresh(_minimumQuality, _removeDuplicateAPs);
+    _scanChannelPos = 0;
+    _scanSliceDone = 0;
+    _scanSliced = true;
+    WM_LOGD("Sliced scan over %d channels, %d per slice", _scanChannelCount, _scanConfig.channelsPerSlice);
+    
+    if (!startScanChannel()) {
+        _scanSliced = false;
+        return false;
+    }
+    return true;
+}
+
+bool WiFiManager::startScanChannel() {
+    uint8_t channel = _scanChannels[_scanChannelPos];
+    bool passive = channel < 16 && (_scanConfig.passiveChannels & (1u << channel));
+    
     wifi_scan_config_t scan_config = {};
-    scan_config.ssid = nullptr;
-    scan_config.bssid = nullptr;
-    scan_config.channel = 0;
+    scan_config.channel = channel;
     scan_config.show_hidden = true;
-    scan_config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
-    scan_config.scan_time.active.min = 100;
-    scan_config.scan_time.active.max = 300;
+    if (passive) {
+        scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
+        scan_config.scan_time.passive = _scanConfig.passiveDwellMs;
+    } else {
+        scan_config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+        scan_config.scan_time.active.min = _scanConfig.activeDwellMs / 2;
+        scan_config.scan_time.active.max = _scanConfig.activeDwellMs;
+    }
     
-    esp_err_t ret = esp_wifi_scan_start(&scan_config, !async);
+    esp_err_t ret = esp_wifi_scan_start(&scan_config, false);
     if (ret != ESP_OK) {
-        WM_LOGE("❌ WiFi scan failed: %s", esp_err_to_name(ret));
-        _scanInProgress = false;
-        
-        // Restore original mode if we changed it
-        if (mode_changed) {
-            esp_wifi_set_mode(current_mode);
-        }
+        WM_LOGW("⚠️  Scan of channel %d failed: %s", channel, esp_err_to_name(ret));
+        return false;
+    }
+    return true;
+}
+
+void WiFiManager::continueSlicedScan(bool ok) {
+    WMScanTable& table = _scanTables[_scanFront ^ 1];
+    if (ok) {
+        collectScanRecords(table);
+    } else {
+        esp_wifi_clear_ap_list();
+    }
+    _scanChannelPos++;
+    _scanSliceDone++;
+    
+    if (_scanChannelPos >= _scanChannelCount) {
+        table.sweep();
+        WM_LOGI("✅ Sliced scan complete, kept %d networks", (int)table.size());
+        _scanSliced = false;
+        flipScanTables(true);
+        finishAsyncScan();
         return;
     }
     
-    if (!async) {
-        // Blocking scan - get results immediately
-        uint16_t ap_count = 0;
-        esp_wifi_scan_get_ap_num(&ap_count);
-        
-        if (ap_count > 0) {
-            _rawScanResults.resize(ap_count);
-            esp_wifi_scan_get_ap_records(&ap_count, _rawScanResults.data());
-            WM_LOGI("✅ Found %d WiFi networks", ap_count);
-            
-            // Filter and sort results
-            filterScanResults();
-        } else {
-            _rawScanResults.clear();
-            WM_LOGW("⚠️  No WiFi networks found");
-        }
-        
-        _lastScanTime = esp_timer_get_time();
-        _scanInProgress = false;
-        
-        // Restore original mode if we changed it
-        if (mode_changed) {
-            WM_LOGI("🔄 Restoring AP mode after scan...");
-            esp_wifi_set_mode(current_mode);
+    if (_scanSliceDone < _scanConfig.channelsPerSlice) {
+        if (!startScanChannel()) {
+            _scanSliced = false;
+            flipScanTables(true);
+            finishAsyncScan();
         }
+        return;
+    }
+    
+    // Publish what we have, then carry it forward as the base for the next slice.
+    // Readers only copy the front buffer under the lock, so the back is ours after the flip.
+    flipScanTables(false);
+    _scanTables[_scanFront ^ 1] = _scanTables[_scanFront];
+    _scanSliceDone = 0;
+    
+    if (_scanSliceTimer && _scanConfig.homeDwellMs > 0) {
+        esp_timer_start_once(_scanSliceTimer, _scanConfig.homeDwellMs * 1000ULL);
+    } else {
+        scanSliceTimerCallback(this);
     }
-    // For async scans, results will be processed in the WiFi event handler
 }
 
-bool WiFiManager::isDuplicateSSID(const char* ssid, const std::vector<wifi_ap_record_t>& results) {
-    for (const auto& ap : results) {
-        if (strcmp((char*)ap.ssid, ssid) == 0) {
-            return true;
-        }
+void WiFiManager::scanSliceTimerCallback(void* arg) {
+    WiFiManager* manager = static_cast<WiFiManager*>(arg);
+    
+    // A connection attempt may have taken the radio meanwhile; publish without a sweep
+    // so networks on the channels we didn't get to stay listed
+    if (manager->_scanSliced && !manager->startScanChannel()) {
+        manager->_scanSliced = false;
+        manager->flipScanTables(true);
+        manager->finishAsyncScan();
     }
-    return false;
 }
 
-int WiFiManager::calculateSignalQuality(int rssi) {
-    // Convert RSSI to percentage (0-100%)
-    // RSSI ranges typically from -100 (weak) to -30 (strong)
-    int quality = 2 * (rssi + 100);
-    if (quality > 100) quality = 100;
-    if (quality < 0) quality = 0;
-    return quality;
+void WiFiManager::finishAsyncScan() {
+    _scanAsync = false;
+    _scanInProgress = false;
+    
+    // Restore AP mode unless a connection attempt needs the STA interface
+    if (_scanRestoreAP) {
+        _scanRestoreAP = false;
+        if (_state == WM_STATE_RUN_PORTAL) {
+            WM_LOGI("🔄 Restoring AP mode after scan...");
+            esp_wifi_set_mode(WIFI_MODE_AP);
+        }
+    }
 }
 
-void WiFiManager::filterScanResults() {
-    if (_rawScanResults.empty()) {
-        return;
+size_t WiFiManager::collectScanRecords(WMScanTable& table) {
+    uint16_t ap_count = 0;
+    esp_wifi_scan_get_ap_num(&ap_count);
+    
+    // Filter, dedup and rank in one pass as records are pulled from the driver
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+    wifi_ap_record_t ap;
+    while (esp_wifi_scan_get_ap_record(&ap) == ESP_OK) {
+        table.add(ap);
     }
-    
-    std::vector<wifi_ap_record_t> filtered;
-    
-    for (const auto& ap : _rawScanResults) {
-        // Skip networks with empty SSID
-        if (strlen((char*)ap.ssid) == 0) {
-            continue;
-        }
-        
-        // Apply minimum quality filter
-        if (_minimumQuality > 0) {
-            int quality = calculateSignalQuality(ap.rssi);
-            if (quality < _minimumQuality) {
-                WM_LOGV("Filtering out %s (quality: %d < %d)", 
-                       (char*)ap.ssid, quality, _minimumQuality);
-                continue;
-            }
-        }
-        
-        // Check for duplicates if removal is enabled
-        if (_removeDuplicateAPs) {
-            if (isDuplicateSSID((char*)ap.ssid, filtered)) {
-                // Keep the one with stronger signal
-                for (auto& existing : filtered) {
-                    if (strcmp((char*)existing.ssid, (char*)ap.ssid) == 0) {
-                        if (ap.rssi > existing.rssi) {
-                            WM_LOGV("Replacing duplicate %s (RSSI: %d -> %d)", 
-                                   (char*)ap.ssid, existing.rssi, ap.rssi);
-                            existing = ap;
-                        }
-                        break;
-                    }
-                }
-                continue;
-            }
+#else
+    wifi_ap_record_t records[WMScanTable::CAPACITY];
+    uint16_t fetched = WMScanTable::CAPACITY;
+    esp_wifi_scan_get_ap_records(&fetched, records);
+    for (uint16_t i = 0; i < fetched; i++) {
+        table.add(records[i]);
+    }
+#endif
+    return ap_count;
+}
+
+void WiFiManager::flipScanTables(bool complete) {
+    // Both buffers are only written from here, so the stamps can be worked out unlocked
+    WMScanTable& next = _scanTables[_scanFront ^ 1];
+    const WMScanTable& current = _scanTables[_scanFront];
+    next.stamp(current, _scanHistory.generation() + 1, WM_SCAN_RSSI_STEP);
+    
+    // Flip buffers so readers see a complete snapshot; removals wait for the scan to complete
+    {
+        std::lock_guard<std::mutex> lock(_scanMutex);
+        _scanHistory.publish(next, complete);
+        _scanFront ^= 1;
+        if (complete) {
+            _lastScanTime = esp_timer_get_time();
         }
-        
-        filtered.push_back(ap);
     }
-    
-    // Sort by signal strength (strongest first)
-    std::sort(filtered.begin(), filtered.end(), 
-              [](const wifi_ap_record_t& a, const wifi_ap_record_t& b) {
-                  return a.rssi > b.rssi;
-              });
-    
-    // Update the raw scan results with filtered data
-    _rawScanResults = std::move(filtered);
-    
-    WM_LOGI("Filtered scan results: %d networks", _rawScanResults.size());
+    if (complete) {
+        WM_METRIC_PHASE_SET(_metrics, WM_PHASE_SCAN, _lastScanTime - _scanStartTime);
+    }
+}
+
+void WiFiManager::publishScanResults() {
+    // Fill the back buffer from the driver without holding the cache lock
+    WMScanTable& table = _scanTables[_scanFront ^ 1];
+    table.reset(_minimumQuality, _removeDuplicateAPs);
+    size_t ap_count = collectScanRecords(table);
+    
+    if (ap_count > 0) {
+        WM_LOGI("✅ Found %d WiFi networks, kept %d", (int)ap_count, (int)table.size());
+    } else {
+        WM_LOGW("⚠️  No WiFi networks found");
+    }
     
     // Log the filtered results
-    for (size_t i = 0; i < _rawScanResults.size() && i < 10; i++) {
-        const auto& ap = _rawScanResults[i];
-        int quality = calculateSignalQuality(ap.rssi);
+    for (size_t i = 0; i < table.size() && i < 10; i++) {
+        const auto& rec = table[i];
         WM_LOGD("  %d: %s (RSSI: %d, Quality: %d%%, Ch: %d, Auth: %d)", 
-               (int)i, (char*)ap.ssid, ap.rssi, quality, 
-               ap.primary, ap.authmode);
-        (void)quality; // Suppress unused variable warning when logging is disabled
+               (int)i, (char*)rec.ssid, rec.rssi, WMScanTable::signalQuality(rec.rssi), 
+               rec.primary, rec.authmode);
     }
+    
+    flipScanTables(true);
+}
+
+bool WiFiManager::isScanCacheStale() const {
+    return _lastScanTime == 0 ||
+           static_cast<uint64_t>(esp_timer_get_time() - _lastScanTime) > _scanCacheMaxAge;
+}
+
+int WiFiManager::calculateSignalQuality(int rssi) {
+    return WMScanTable::signalQuality(rssi);
 }
 
-void WiFiManager::sortScanResultsBySignal() {
-    std::sort(_rawScanResults.begin(), _rawScanResults.end(), 
-              [](const wifi_ap_record_t& a, const wifi_ap_record_t& b) {
-                  return a.rssi > b.rssi;
-              });
+size_t WiFiManager::getScanRows(WMScanRow* rows) {
+    std::lock_guard<std::mutex> lock(_scanMutex);
+    return _scanTables[_scanFront].copyRows(rows);
 }
 
-std::vector<wifi_ap_record_t> WiFiManager::getFilteredScanResults() {
-    return _rawScanResults;
+size_t WiFiManager::getScanDelta(uint32_t since, WMScanRow* rows, WMScanHistory::Delta& delta) {
+    std::lock_guard<std::mutex> lock(_scanMutex);
+    _scanHistory.delta(since, delta);
+    return _scanTables[_scanFront].copyRows(rows, delta.full ? 0 : since);
 }
 
 bool WiFiManager::scanWiFiNetworks() {
     performWiFiScan(false); // Blocking scan
-    return !_rawScanResults.empty();
+    std::lock_guard<std::mutex> lock(_scanMutex);
+    return !_scanTables[_scanFront].empty();
 }
 
 
 
+#if WM_PROVISION_HTTP
 // HTTP Server Handler Implementations
 
-// External binary data (embedded assets)
+// External binary data (embedded assets, packed by tools/pack_assets.py)
 extern const uint8_t index_html_start[] asm("_binary_index_html_start");
 extern const uint8_t index_html_end[] asm("_binary_index_html_end");
 extern const uint8_t wifi_html_start[] asm("_binary_wifi_html_start"); 
@@ -1356,168 +3875,293 @@ extern const uint8_t style_css_start[] asm("_binary_style_css_start");
 extern const uint8_t style_css_end[] asm("_binary_style_css_end");
 extern const uint8_t wm_js_start[] asm("_binary_wm_js_start");
 extern const uint8_t wm_js_end[] asm("_binary_wm_js_end");
+extern const uint8_t info_html_start[] asm("_binary_info_html_start");
+extern const uint8_t info_html_end[] asm("_binary_info_html_end");
+extern const uint8_t wifi_css_start[] asm("_binary_wifi_css_start");
+extern const uint8_t wifi_css_end[] asm("_binary_wifi_css_end");
+extern const uint8_t wifi_js_start[] asm("_binary_wifi_js_start");
+extern const uint8_t wifi_js_end[] asm("_binary_wifi_js_end");
 
 WiFiManager* WiFiManager::getManagerFromRequest(httpd_req_t *req) {
     return static_cast<WiFiManager*>(req->user_ctx);
 }
 
+#if WM_ASSETS_GZIP
+// Whether the client's Accept-Encoding allows gzip. No header means any coding
+// is fine; otherwise gzip (or *) has to be listed with a weight above 0.
+static bool acceptsGzip(httpd_req_t *req) {
+    char accept[96];
+    size_t len = httpd_req_get_hdr_value_len(req, "Accept-Encoding");
+    if (len == 0 || len >= sizeof(accept)) {
+        return true;  // Lists that long come from browsers offering everything
+    }
+    if (httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept, sizeof(accept)) != ESP_OK) {
+        return true;
+    }
+    
+    int gzip = -1;
+    int wildcard = -1;
+    for (const char* p = accept; *p; ) {
+        p += strspn(p, " \t,");
+        size_t n = strcspn(p, " \t,;");
+        bool isGzip = n == 4 && strncasecmp(p, "gzip", 4) == 0;
+        bool isWildcard = n == 1 && *p == '*';
+        p += n;
+        p += strspn(p, " \t");
+        
+        // q=0, 0.0, 0.00 or 0.000 rules the coding out
+        bool excluded = false;
+        if (*p == ';') {
+            p++;
+            p += strspn(p, " \t");
+            if ((*p == 'q' || *p == 'Q') && p[1] == '=' && p[2] == '0') {
+                const char* digits = p + 3;
+                if (*digits == '.') {
+                    digits += strspn(digits + 1, "0") + 1;
+                }
+                excluded = *digits < '0' || *digits > '9';
+            }
+        }
+        if (isGzip) {
+            gzip = !excluded;
+        } else if (isWildcard) {
+            wildcard = !excluded;
+        }
+        p += strcspn(p, ",");
+    }
+    return gzip >= 0 ? gzip : wildcard > 0;
+}
+#endif
+
+esp_err_t WiFiManager::sendAsset(httpd_req_t *req, const uint8_t* start, const uint8_t* end,
+                                 const char* type, const char* etag) {
+    // Let browsers revalidate instead of re-downloading unchanged pages
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    
+    char if_none_match[40];
+    size_t hdr_len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (hdr_len > 0 && hdr_len < sizeof(if_none_match) &&
+        httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strstr(if_none_match, etag)) {
+        WM_LOGV("Asset not modified: %s", etag);
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    
+#if WM_ASSETS_GZIP
+    // Only the compressed copy is in flash, there is nothing else to offer
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (!acceptsGzip(req)) {
+        WM_LOGW("Client does not accept gzip, asset %s not sent", etag);
+        httpd_resp_set_status(req, "406 Not Acceptable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, "gzip required", -1);
+    }
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+#endif
+    httpd_resp_set_type(req, type);
+    return httpd_resp_send(req, (const char*)start, end - start);
+}
+
+bool WiFiManager::resolveCommon(std::string_view name, WMTemplate& out) const {
+    if (name == "head") {
+        out.write(_customHeadElement.data(), _customHeadElement.size());  // Raw HTML by design
+    } else if (name == "class") {
+        out.writeEscaped(_cssClass.c_str());
+    } else if (name == "device") {
+        out.writeEscaped(!_hostname.empty() ? _hostname.c_str() : _apName.c_str());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void WiFiManager::renderMenu(WMTemplate& out) const {
+    static const menu_page_t DEFAULT_MENU[] = {MENU_WIFI, MENU_INFO, MENU_EXIT};
+    const menu_page_t* pages = _menuPages.empty() ? DEFAULT_MENU : _menuPages.data();
+    size_t count = _menuPages.empty() ? sizeof(DEFAULT_MENU) / sizeof(DEFAULT_MENU[0]) : _menuPages.size();
+    
+    // Only pages this portal actually serves get a link
+    for (size_t i = 0; i < count; i++) {
+        switch (pages[i]) {
+            case MENU_WIFI: out.write("<a href=\"/wifi\">Configure WiFi</a>"); break;
+            case MENU_INFO: out.write("<a href=\"/info\">Info</a>"); break;
+            case MENU_EXIT: out.write("<a href=\"/exit\">Exit</a>"); break;
+            default: break;
+        }
+    }
+}
+
+void WiFiManager::renderParameters(WMTemplate& out) const {
+    for (uint8_t i = 0; i < _paramsCount; i++) {
+        wmWriteParameter(out, *_params[i]);
+    }
+}
+
 esp_err_t WiFiManager::handleRoot(httpd_req_t *req) {
     WM_LOGD("Serving root page");
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_ROOT);
     
     httpd_resp_set_type(req, "text/html");
     httpd_resp_set_hdr(req, "Cache-Control", "no-store");
     
-    // Serve embedded HTML
-    const size_t index_html_len = index_html_end - index_html_start;
-    httpd_resp_send(req, (const char*)index_html_start, index_html_len);
-    
-    return ESP_OK;
+    WMTemplate page(req);
+    return page.render(index_html_start, index_html_end,
+        [](void* ctx, std::string_view name, WMTemplate& out) {
+            const WiFiManager* manager = static_cast<const WiFiManager*>(ctx);
+            if (!manager->resolveCommon(name, out) && name == "menu") {
+                manager->renderMenu(out);
+            }
+        }, getManagerFromRequest(req));
 }
 
 esp_err_t WiFiManager::handleWifi(httpd_req_t *req) {
     WM_LOGD("Serving WiFi configure page");
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_WIFI);
     
     httpd_resp_set_type(req, "text/html");
     httpd_resp_set_hdr(req, "Cache-Control", "no-store");
     
-    // Serve embedded WiFi HTML
-    const size_t wifi_html_len = wifi_html_end - wifi_html_start;
-    httpd_resp_send(req, (const char*)wifi_html_start, wifi_html_len);
-    
-    return ESP_OK;
+    WMTemplate page(req);
+    return page.render(wifi_html_start, wifi_html_end,
+        [](void* ctx, std::string_view name, WMTemplate& out) {
+            const WiFiManager* manager = static_cast<const WiFiManager*>(ctx);
+            if (!manager->resolveCommon(name, out) && name == "params") {
+                manager->renderParameters(out);
+            }
+        }, getManagerFromRequest(req));
+}
+
+esp_err_t WiFiManager::handleWifiCss(httpd_req_t *req) {
+    return sendAsset(req, wifi_css_start, wifi_css_end, "text/css", WM_ETAG_WIFI_CSS);
+}
+
+esp_err_t WiFiManager::handleWifiJs(httpd_req_t *req) {
+    return sendAsset(req, wifi_js_start, wifi_js_end, "application/javascript", WM_ETAG_WIFI_JS);
 }
 
 esp_err_t WiFiManager::handleStatus(httpd_req_t *req) {
     WM_LOGD("Status check requested");
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_STATUS);
     
-    // Get WiFi status
-    wifi_ap_record_t ap_info;
-    bool connected = (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
     
-    // Get saved WiFi config using WiFi API (not direct NVS access)
-    wifi_config_t wifi_config = {};
-    bool has_saved_config = (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK);
-    bool has_saved_ssid = has_saved_config && (strlen((char*)wifi_config.sta.ssid) > 0);
+    // Stream JSON response, same document /events pushes
+    WMJsonWriter json(req);
+    getManagerFromRequest(req)->writeStatus(json);
+    return json.finish();
+}
+
+esp_err_t WiFiManager::handleScan(httpd_req_t *req) {
+    WM_LOGD("WiFi scan requested");
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_SCAN);
+    WiFiManager* manager = getManagerFromRequest(req);
     
-    // Get IP address
-    esp_netif_ip_info_t ip_info;
-    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    char ip_str[16] = "0.0.0.0";
-    if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
-        snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&ip_info.ip));
+    // Refresh in the background when the cache is stale, answer from the snapshot now
+    if (manager->isScanCacheStale()) {
+        manager->performWiFiScan(true);
     }
     
-    // Create JSON response
-    cJSON* status_json = cJSON_CreateObject();
-    if (status_json) {
-        cJSON_AddBoolToObject(status_json, "connected", connected);
-        if (connected) {
-            cJSON_AddStringToObject(status_json, "ssid", (char*)ap_info.ssid);
-            cJSON_AddStringToObject(status_json, "ip", ip_str);
-        } else if (has_saved_ssid) {
-            cJSON_AddStringToObject(status_json, "saved_ssid", (char*)wifi_config.sta.ssid);
-        }
-        
-        char* json_string = cJSON_Print(status_json);
-        if (json_string) {
-            httpd_resp_set_type(req, "application/json");
-            httpd_resp_set_hdr(req, "Cache-Control", "no-store");
-            httpd_resp_send(req, json_string, strlen(json_string));
-            free(json_string);
-        } else {
-            httpd_resp_send_500(req);
-        }
-        cJSON_Delete(status_json);
+    // A page that already has a list asks for what changed since its generation
+    char query[32];
+    char since_param[12];
+    bool diff = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                httpd_query_key_value(query, "since", since_param, sizeof(since_param)) == ESP_OK;
+    uint32_t since = diff ? strtoul(since_param, nullptr, 10) : 0;
+    
+    // Copy out just the rows to send so the event task can publish while we stream
+    WMScanRow rows[WMScanTable::CAPACITY];
+    size_t count;
+    WMScanHistory::Delta delta;
+    if (diff) {
+        count = manager->getScanDelta(since, rows, delta);
     } else {
-        httpd_resp_send_500(req);
+        count = manager->getScanRows(rows);
     }
     
-    return ESP_OK;
-}
-
-esp_err_t WiFiManager::handleScan(httpd_req_t *req) {
-    WM_LOGD("WiFi scan requested");
-    WiFiManager* manager = getManagerFromRequest(req);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    // Nothing cached yet, or a sliced scan is still filling in - tell the page to poll again shortly
+    if (manager->_scanInProgress && (count == 0 || manager->_scanSliced)) {
+        httpd_resp_set_status(req, "202 Accepted");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+    }
     
-    // Use enhanced scanning functionality
-    manager->performWiFiScan(false); // Blocking scan with filtering
-    
-    // Get filtered scan results
-    std::vector<wifi_ap_record_t> scan_results = manager->getFilteredScanResults();
-    
-    // Create JSON response
-    cJSON* networks_json = cJSON_CreateArray();
-    if (networks_json) {
-        for (const auto& ap : scan_results) {
-            cJSON* network = cJSON_CreateObject();
-            if (network) {
-                cJSON_AddStringToObject(network, "ssid", (char*)ap.ssid);
-                cJSON_AddNumberToObject(network, "rssi", ap.rssi);
-                cJSON_AddNumberToObject(network, "channel", ap.primary);
-                cJSON_AddNumberToObject(network, "encryption", ap.authmode);
-                cJSON_AddBoolToObject(network, "hidden", false);
-                
-                // Calculate signal quality percentage
-                int quality = manager->calculateSignalQuality(ap.rssi);
-                cJSON_AddNumberToObject(network, "quality", quality);
-                
-                // Add security type string for display
-                const char* security = "Open";
-                switch (ap.authmode) {
-                    case WIFI_AUTH_WEP: security = "WEP"; break;
-                    case WIFI_AUTH_WPA_PSK: security = "WPA"; break;
-                    case WIFI_AUTH_WPA2_PSK: security = "WPA2"; break;
-                    case WIFI_AUTH_WPA_WPA2_PSK: security = "WPA/WPA2"; break;
-                    case WIFI_AUTH_WPA3_PSK: security = "WPA3"; break;
-                    case WIFI_AUTH_WPA2_WPA3_PSK: security = "WPA2/WPA3"; break;
-                    default: security = "Unknown"; break;
-                }
-                cJSON_AddStringToObject(network, "security", security);
-                
-                cJSON_AddItemToArray(networks_json, network);
-            }
-        }
+    WMJsonWriter json(req);
+    if (diff) {
+        wmWriteScanDelta(json, rows, count, delta, since);
+        esp_err_t ret = json.finish();
+        WM_LOGD("Sent scan diff since %lu: generation %lu%s", (unsigned long)since,
+                (unsigned long)delta.generation, delta.full ? " (full)" : "");
+        return ret;
     }
     
-    char* json_string = cJSON_Print(networks_json);
-    if (json_string) {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Cache-Control", "no-store");
-        httpd_resp_send(req, json_string, strlen(json_string));
-        free(json_string);
-        
-        WM_LOGI("Sent scan results: %d networks", scan_results.size());
+    // Stream JSON response, one object per network
+    wmWriteScanList(json, rows, count, manager->_portalLean);
+    
+    esp_err_t ret = json.finish();
+    if (ret == ESP_OK) {
+        WM_LOGI("Sent scan results: %d networks", (int)count);
     } else {
-        WM_LOGE("Failed to create JSON response");
-        httpd_resp_send_500(req);
+        WM_LOGE("Failed to send scan results: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+void WiFiManager::handleFormField(void* ctx, const char* key, size_t keyLen,
+                                  const char* value, size_t valueLen, bool truncated) {
+    SaveForm* form = static_cast<SaveForm*>(ctx);
+    
+    // Built-in fields first, then custom parameters. Cutting a credential short would
+    // just fail to connect later, so an oversized one rejects the whole form.
+    if (keyLen == 1 && key[0] == 's') {
+        if (truncated || valueLen > WM_MAX_SSID_LEN) {
+            form->tooLong = true;
+            return;
+        }
+        memcpy(form->ssid, value, valueLen);
+        form->ssid[valueLen] = '\0';
+        return;
+    }
+    if (keyLen == 1 && key[0] == 'p') {
+        if (truncated || valueLen > WM_MAX_PASSWORD_LEN) {
+            form->tooLong = true;
+            return;
+        }
+        memcpy(form->password, value, valueLen);
+        form->password[valueLen] = '\0';
+        return;
     }
     
-    cJSON_Delete(networks_json);
-    return ESP_OK;
+    WiFiManagerParameter* param = form->manager->findParameter(key, keyLen);
+    if (param && valueLen > 0 && !truncated) {
+        param->setValue(value, valueLen);
+        WM_LOGD("Updated parameter %s = %s", param->getID(), value);
+    }
 }
 
 esp_err_t WiFiManager::handleWifiSave(httpd_req_t *req) {
     WM_LOGD("WiFi save requested, content length: %d", req->content_len);
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_WIFISAVE);
     WiFiManager* manager = getManagerFromRequest(req);
     
-    // Handle larger POST requests with dynamic buffer
     size_t content_len = req->content_len;
-    if (content_len > 4096) { // Limit to reasonable size
+    if (content_len > WM_FORM_MAX_BODY) { // Limit to reasonable size
         WM_LOGE("POST data too large: %d bytes", content_len);
         httpd_resp_send_err(req, HTTPD_413_CONTENT_TOO_LARGE, "Form data too large");
         return ESP_FAIL;
     }
     
-    // Allocate buffer based on actual content length
-    size_t buf_len = (content_len > 0) ? content_len + 1 : 2048;
-    std::unique_ptr<char[]> buf(new char[buf_len]);
+    // Parse the form as it arrives, one small chunk at a time
+    SaveForm form = {manager, {0}, {0}, false};
+    WMFormParser parser(handleFormField, &form);
     
-    size_t total_received = 0;
+    char chunk[WM_FORM_RECV_CHUNK];
     size_t remaining = content_len;
-    
-    // Read POST data in chunks if necessary
     while (remaining > 0) {
-        int ret = httpd_req_recv(req, buf.get() + total_received, remaining);
+        int ret = httpd_req_recv(req, chunk, std::min(remaining, sizeof(chunk)));
         if (ret <= 0) {
             if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
                 WM_LOGE("Timeout receiving POST data");
@@ -1528,329 +4172,143 @@ esp_err_t WiFiManager::handleWifiSave(httpd_req_t *req) {
             }
             return ESP_FAIL;
         }
-        total_received += ret;
+        parser.feed(chunk, ret);
         remaining -= ret;
     }
+    parser.finish();
+    WM_LOGD("Received %d bytes of POST data", content_len);
     
-    buf[total_received] = '\0';
-    WM_LOGD("Received %d bytes of POST data", total_received);
-    
-    // Parse form data
-    char ssid[33] = {0};
-    char password[65] = {0};
-    
-    // Simple URL decode and parameter parsing
-    char* ssid_param = strstr(buf.get(), "s=");
-    char* pass_param = strstr(buf.get(), "p=");
-    
-    // Parse custom parameters
-    for (const auto& param : manager->_params) {
-        if (!param || !param->getID()) continue;
-        
-        // Look for parameter in form data
-        std::string param_key = std::string(param->getID()) + "=";
-        char* param_start = strstr(buf.get(), param_key.c_str());
-        if (param_start) {
-            param_start += param_key.length();
-            char* param_end = strchr(param_start, '&');
-            int len = param_end ? (param_end - param_start) : strlen(param_start);
-            
-            if (len > 0 && len < 256) {
-                char param_value[256] = {0};
-                strncpy(param_value, param_start, len);
-                
-                // URL decode parameter value
-                for (int i = 0, j = 0; i <= len; i++, j++) {
-                    if (param_value[i] == '+') {
-                        param_value[j] = ' ';
-                    } else if (param_value[i] == '%' && i + 2 <= len) {
-                        char hex[3] = {param_value[i+1], param_value[i+2], 0};
-                        param_value[j] = (char)strtol(hex, NULL, 16);
-                        i += 2;
-                    } else {
-                        param_value[j] = param_value[i];
-                    }
-                }
-                
-                param->setValue(param_value);
-                WM_LOGD("Updated parameter %s = %s", param->getID(), param_value);
-            }
-        }
-    }
-    
-    if (ssid_param) {
-        ssid_param += 2; // Skip "s="
-        char* end = strchr(ssid_param, '&');
-        int len = end ? (end - ssid_param) : strlen(ssid_param);
-        len = (len < sizeof(ssid) - 1) ? len : sizeof(ssid) - 1;
-        strncpy(ssid, ssid_param, len);
-        ssid[len] = '\0';
-        
-        // URL decode (basic)
-        for (int i = 0, j = 0; i <= len; i++, j++) {
-            if (ssid[i] == '+') {
-                ssid[j] = ' ';
-            } else if (ssid[i] == '%' && i + 2 <= len) {
-                // Hex decode
-                char hex[3] = {ssid[i+1], ssid[i+2], 0};
-                ssid[j] = (char)strtol(hex, NULL, 16);
-                i += 2;
-            } else {
-                ssid[j] = ssid[i];
-            }
-        }
-    }
-    
-    if (pass_param) {
-        pass_param += 2; // Skip "p="
-        char* end = strchr(pass_param, '&');
-        int len = end ? (end - pass_param) : strlen(pass_param);
-        len = (len < sizeof(password) - 1) ? len : sizeof(password) - 1;
-        strncpy(password, pass_param, len);
-        password[len] = '\0';
-        
-        // URL decode (basic)
-        for (int i = 0, j = 0; i <= len; i++, j++) {
-            if (password[i] == '+') {
-                password[j] = ' ';
-            } else if (password[i] == '%' && i + 2 <= len) {
-                char hex[3] = {password[i+1], password[i+2], 0};
-                password[j] = (char)strtol(hex, NULL, 16);
-                i += 2;
-            } else {
-                password[j] = password[i];
-            }
-        }
-    }
-    
-    WM_LOGI("Connecting to SSID: %s", ssid);
+    const char* ssid = form.ssid;
+    const char* password = form.password;
     
-    if (strlen(ssid) == 0) {
+    if (strlen(ssid) == 0 || form.tooLong) {
         // Send error response
+        if (form.tooLong) {
+            WM_LOGW("Rejected credentials longer than %d/%d bytes", WM_MAX_SSID_LEN, WM_MAX_PASSWORD_LEN);
+        }
         httpd_resp_set_type(req, "text/html");
-        httpd_resp_send(req, "<html><body><h1>Error: SSID required</h1><a href='/'>Back</a></body></html>", -1);
+        httpd_resp_send(req, form.tooLong ?
+            "<html><body><h1>Error: SSID or password too long</h1><a href='/'>Back</a></body></html>" :
+            "<html><body><h1>Error: SSID required</h1><a href='/'>Back</a></body></html>", -1);
         return ESP_OK;
     }
     
-    // Switch to AP+STA mode to allow STA configuration
-    WM_LOGI("🔄 Switching to AP+STA mode for connection...");
-    esp_err_t err = esp_wifi_set_mode(WIFI_MODE_APSTA);
-    if (err != ESP_OK) {
-        WM_LOGE("❌ Failed to set AP+STA mode: %s", esp_err_to_name(err));
-        httpd_resp_send_500(req);
-        return ESP_FAIL;
-    }
-    
-    // Give it a moment to switch modes
-    vTaskDelay(pdMS_TO_TICKS(500));
-    
-    // Configure WiFi with new credentials
-    wifi_config_t wifi_config = {};
-    strncpy((char*)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-    if (strlen(password) > 0) {
-        strncpy((char*)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
-    }
-    
-    WM_LOGI("🔧 Setting STA configuration...");
-    err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-    if (err != ESP_OK) {
-        WM_LOGE("❌ Failed to set WiFi config: %s", esp_err_to_name(err));
+    if (!manager->beginPortalConnect(ssid, password)) {
         httpd_resp_send_500(req);
         return ESP_FAIL;
     }
     
-    // Attempt connection
-    WM_LOGI("🌐 Attempting to connect to WiFi...");
-    esp_wifi_disconnect();
-    err = esp_wifi_connect();
-    if (err != ESP_OK) {
-        WM_LOGE("❌ Failed to start WiFi connection: %s", esp_err_to_name(err));
-        // Don't return error here, connection might still succeed
-    }
-    
-    // Update manager state
-    manager->_state = WM_STATE_TRY_STA;
-    manager->_connectStart = esp_timer_get_time();
-    
-    // Send success response and ensure it's completely transmitted
+    // Send success response, the page follows the attempt over /events
     httpd_resp_set_type(req, "text/html");
     const char* success_msg = 
         "<html><body>"
         "<h1>Connecting...</h1>"
         "<p>Device is attempting to connect to the network.</p>"
-        "<p>Please wait and check your device's connection status.</p>"
-        "<script>setTimeout(function(){window.location.href='/';}, 5000);</script>"
+        "<p id='state'>Please wait and check your device's connection status.</p>"
+        "<script>"
+        "var done=setTimeout(function(){location.href='/';},15000);"
+        "if(window.EventSource){var es=new EventSource('/events');"
+        "es.onmessage=function(e){var d=JSON.parse(e.data);if(d.connecting)return;"
+        "es.close();clearTimeout(done);"
+        "document.getElementById('state').textContent=d.connected?'Connected to '+d.ssid+' ('+d.ip+')':'Connection failed: '+d.result;"
+        "if(!d.connected)setTimeout(function(){location.href='/wifi';},3000);};}"
+        "</script>"
         "</body></html>";
     
-    WM_LOGI("📤 Sending HTTP response...");
+    // httpd_resp_send() returns once lwIP has the data; the AP stays up while the STA
+    // connects, so there is nothing to wait for and the worker is free for /events
     esp_err_t send_ret = httpd_resp_send(req, success_msg, strlen(success_msg));
     if (send_ret != ESP_OK) {
         WM_LOGE("❌ Failed to send HTTP response: %s", esp_err_to_name(send_ret));
-        return send_ret;
     }
-    
-    // CRITICAL: Ensure the response is actually transmitted over the network
-    WM_LOGI("⏳ Waiting for HTTP response transmission to complete...");
-    
-    // Give TCP stack time to actually send the data over WiFi
-    vTaskDelay(pdMS_TO_TICKS(1000)); // 1 second should be enough for small response
-    
-    WM_LOGI("✅ HTTP response transmission complete");
-    return ESP_OK;
+    return send_ret;
 }
 
 esp_err_t WiFiManager::handleInfo(httpd_req_t *req) {
     WM_LOGD("Info page requested");
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_INFO);
     
     httpd_resp_set_type(req, "text/html");
     httpd_resp_set_hdr(req, "Cache-Control", "no-store");
     
-    // Get device info
-    esp_chip_info_t chip_info;
-    esp_chip_info(&chip_info);
-    
-    // Get WiFi info
-    wifi_ap_record_t ap_info;
-    bool wifi_connected = (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK);
-    
-    wifi_config_t wifi_config = {};
-    bool has_saved_config = (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK);
-    bool has_saved_ssid = has_saved_config && (strlen((char*)wifi_config.sta.ssid) > 0);
+    // Everything the page shows is gathered up front, the template pulls from here
+    struct InfoPage {
+        const WiFiManager* manager;
+        esp_chip_info_t chip;
+        wifi_ap_record_t ap;
+        bool connected;
+        wifi_config_t config;
+        bool hasSavedSSID;
+        char ip[16];
+        uint8_t staMac[6];
+        uint8_t apMac[6];
+    } info = {};
+    info.manager = getManagerFromRequest(req);
+    
+    esp_chip_info(&info.chip);
+    info.connected = (esp_wifi_sta_get_ap_info(&info.ap) == ESP_OK);
+    info.hasSavedSSID = (esp_wifi_get_config(WIFI_IF_STA, &info.config) == ESP_OK) &&
+                        info.config.sta.ssid[0] != '\0';
     
     esp_netif_ip_info_t ip_info;
     esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    char ip_str[16] = "Not connected";
+    strcpy(info.ip, "Not connected");
     if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK && ip_info.ip.addr != 0) {
-        snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&ip_info.ip));
-    }
-    
-    // Get MAC addresses
-    uint8_t sta_mac[6], ap_mac[6];
-    esp_wifi_get_mac(WIFI_IF_STA, sta_mac);
-    esp_wifi_get_mac(WIFI_IF_AP, ap_mac);
-    
-    // Calculate uptime
-    int64_t uptime_us = esp_timer_get_time();
-    int uptime_sec = uptime_us / 1000000;
-    int hours = uptime_sec / 3600;
-    int minutes = (uptime_sec % 3600) / 60;
-    int seconds = uptime_sec % 60;
-    
-    std::string html = R"(
-<!DOCTYPE html>
-<html>
-<head>
-    <title>Device Info</title>
-    <meta name="viewport" content="width=device-width, initial-scale=1">
-    <style>
-        body { font-family: Arial, sans-serif; margin: 0; padding: 20px; background: #f0f0f0; }
-        .wrap { background: white; max-width: 600px; margin: 0 auto; padding: 20px; border-radius: 8px; box-shadow: 0 2px 10px rgba(0,0,0,0.1); }
-        .back-link { margin-bottom: 20px; }
-        .back-link a { color: #1fa3ec; text-decoration: none; font-size: 0.9em; }
-        .back-link a:hover { text-decoration: underline; }
-        h1 { color: #1fa3ec; margin-bottom: 30px; text-align: center; }
-        h3 { color: #333; margin-top: 30px; margin-bottom: 15px; border-bottom: 2px solid #1fa3ec; padding-bottom: 5px; }
-        .info-table { width: 100%; border-collapse: collapse; margin-bottom: 20px; }
-        .info-table td { padding: 10px; border-bottom: 1px solid #eee; }
-        .info-table td:first-child { font-weight: bold; width: 40%; color: #666; }
-        .info-table td:last-child { color: #333; }
-        .pages-list { list-style: none; padding: 0; }
-        .pages-list li { margin: 8px 0; }
-        .pages-list a { color: #1fa3ec; text-decoration: none; display: block; padding: 8px 12px; background: #f8f9fa; border-radius: 4px; }
-        .pages-list a:hover { background: #e9ecef; text-decoration: none; }
-        .status-connected { color: #28a745; font-weight: bold; }
-        .status-disconnected { color: #dc3545; font-weight: bold; }
-    </style>
-</head>
-<body>
-    <div class="wrap">
-        <div class="back-link">
-            <a href="/">&lt; Back to Home</a>
-        </div>
-        
-        <h1>Device Information</h1>
-        
-        <h3>Chip Information</h3>
-        <table class="info-table">
-            <tr><td>Chip Type</td><td>)";
-    html += CONFIG_IDF_TARGET;
-    html += R"(</td></tr>
-            <tr><td>CPU Cores</td><td>)";
-    html += std::to_string(chip_info.cores);
-    html += R"(</td></tr>
-            <tr><td>Chip Revision</td><td>)";
-    html += std::to_string(chip_info.revision / 100) + "." + std::to_string(chip_info.revision % 100);
-    html += R"(</td></tr>
-            <tr><td>WiFi Support</td><td>Yes</td></tr>
-            <tr><td>Bluetooth Support</td><td>)";
-    html += (chip_info.features & CHIP_FEATURE_BT) ? "Yes" : "No";
-    html += R"(</td></tr>
-            <tr><td>Free Heap</td><td>)";
-    html += std::to_string(esp_get_free_heap_size()) + " bytes";
-    html += R"(</td></tr>
-            <tr><td>Uptime</td><td>)";
-    html += std::to_string(hours) + "h " + std::to_string(minutes) + "m " + std::to_string(seconds) + "s";
-    html += R"(</td></tr>
-            <tr><td>WiFiManager Version</td><td>)";
-    html += WM_VERSION;
-    html += R"(</td></tr>
-        </table>
-        
-        <h3>WiFi Information</h3>
-        <table class="info-table">
-            <tr><td>Connection Status</td><td class=")";
-    html += wifi_connected ? "status-connected\">Connected" : "status-disconnected\">Disconnected";
-    html += R"(</td></tr>)";
-    
-    if (wifi_connected) {
-        html += R"(
-            <tr><td>Connected Network</td><td>)";
-        html += (char*)ap_info.ssid;
-        html += R"(</td></tr>
-            <tr><td>Signal Strength</td><td>)";
-        html += std::to_string(ap_info.rssi) + " dBm";
-        html += R"(</td></tr>
-            <tr><td>IP Address</td><td>)";
-        html += ip_str;
-        html += R"(</td></tr>)";
-    } else if (has_saved_ssid) {
-        html += R"(
-            <tr><td>Saved Network</td><td>)";
-        html += (char*)wifi_config.sta.ssid;
-        html += R"(</td></tr>)";
-    }
-    
-    html += R"(
-            <tr><td>Station MAC</td><td>)";
-    char mac_str[18];
-    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X", 
-             sta_mac[0], sta_mac[1], sta_mac[2], sta_mac[3], sta_mac[4], sta_mac[5]);
-    html += mac_str;
-    html += R"(</td></tr>
-            <tr><td>Access Point MAC</td><td>)";
-    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X", 
-             ap_mac[0], ap_mac[1], ap_mac[2], ap_mac[3], ap_mac[4], ap_mac[5]);
-    html += mac_str;
-    html += R"(</td></tr>
-        </table>
-        
-        <h3>Available Pages</h3>
-        <ul class="pages-list">
-            <li><a href="/">Home</a></li>
-            <li><a href="/wifi">Configure WiFi</a></li>
-            <li><a href="/info">Device Info</a></li>
-            <li><a href="/scan">Scan Networks</a></li>
-        </ul>)"
-        "</div>"
-        "</body>"
-        "</html>";
-    
-    httpd_resp_send(req, html.c_str(), html.length());
-    return ESP_OK;
+        snprintf(info.ip, sizeof(info.ip), IPSTR, IP2STR(&ip_info.ip));
+    }
+    
+    esp_wifi_get_mac(WIFI_IF_STA, info.staMac);
+    esp_wifi_get_mac(WIFI_IF_AP, info.apMac);
+    
+    WMTemplate page(req);
+    return page.render(info_html_start, info_html_end,
+        [](void* ctx, std::string_view name, WMTemplate& out) {
+            const InfoPage& info = *static_cast<const InfoPage*>(ctx);
+            if (info.manager->resolveCommon(name, out)) {
+                return;
+            }
+            
+            if (name == "chip") {
+                out.write(CONFIG_IDF_TARGET);
+            } else if (name == "cores") {
+                out.printf("%d", info.chip.cores);
+            } else if (name == "revision") {
+                out.printf("%d.%d", info.chip.revision / 100, info.chip.revision % 100);
+            } else if (name == "bt") {
+                out.write((info.chip.features & CHIP_FEATURE_BT) ? "Yes" : "No");
+            } else if (name == "heap") {
+                out.printf("%lu", (unsigned long)esp_get_free_heap_size());
+            } else if (name == "uptime") {
+                int uptime_sec = esp_timer_get_time() / 1000000;
+                out.printf("%dh %dm %ds", uptime_sec / 3600, (uptime_sec % 3600) / 60, uptime_sec % 60);
+            } else if (name == "version") {
+                out.write(WM_VERSION);
+            } else if (name == "wifi") {
+                out.write(info.connected
+                    ? "<tr><td>Connection Status</td><td class=\"status-connected\">Connected</td></tr>"
+                    : "<tr><td>Connection Status</td><td class=\"status-disconnected\">Disconnected</td></tr>");
+                if (info.connected) {
+                    out.write("<tr><td>Connected Network</td><td>");
+                    out.writeEscaped((const char*)info.ap.ssid);
+                    out.printf("</td></tr><tr><td>Signal Strength</td><td>%d dBm</td></tr>", info.ap.rssi);
+                    out.write("<tr><td>IP Address</td><td>");
+                    out.write(info.ip);
+                    out.write("</td></tr>");
+                } else if (info.hasSavedSSID) {
+                    out.write("<tr><td>Saved Network</td><td>");
+                    out.writeEscaped((const char*)info.config.sta.ssid);
+                    out.write("</td></tr>");
+                }
+            } else if (name == "sta_mac" || name == "ap_mac") {
+                const uint8_t* mac = name == "sta_mac" ? info.staMac : info.apMac;
+                out.printf("%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            }
+        }, &info);
 }
 
 esp_err_t WiFiManager::handleExit(httpd_req_t *req) {
     WM_LOGD("Exit requested");
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_EXIT);
     WiFiManager* manager = getManagerFromRequest(req);
     
     httpd_resp_set_type(req, "text/html");
@@ -1862,30 +4320,44 @@ esp_err_t WiFiManager::handleExit(httpd_req_t *req) {
     httpd_resp_send(req, exit_msg, strlen(exit_msg));
     
     // Signal to close portal
-    manager->_state = WM_STATE_PORTAL_ABORT;
     manager->_portalAbortResult = true;
+    manager->setState(WM_STATE_PORTAL_ABORT);
+    xEventGroupSetBits(manager->_eventGroup, WM_EVT_ABORT);
     
     return ESP_OK;
 }
 
 esp_err_t WiFiManager::handleCaptivePortal(httpd_req_t *req) {
     WM_LOGD("Captive portal detection request: %s", req->uri);
+    WM_METRIC_REQUEST(getManagerFromRequest(req)->_metrics, WM_ROUTE_CAPTIVE);
     
-    // Different responses based on the requesting OS
-    if (strstr(req->uri, "generate_204")) {
-        // Android captive portal check
-        httpd_resp_set_status(req, "204 No Content");
-        httpd_resp_send(req, NULL, 0);
-    } else if (strstr(req->uri, "ncsi.txt")) {
-        // Windows captive portal check
-        httpd_resp_set_type(req, "text/plain");
-        httpd_resp_send(req, "Microsoft NCSI", -1);
-    } else {
-        // iOS/macOS and others - redirect to main page
-        httpd_resp_set_status(req, "302 Found");
-        httpd_resp_set_hdr(req, "Location", "/");
-        httpd_resp_send(req, NULL, 0);
+    // Only reached through uriMatch(), so the lookup always hits
+    const char* query = strchr(req->uri, '?');
+    const WMProbe* probe = findProbe(req->uri, query ? query - req->uri : strlen(req->uri));
+    if (!probe) {
+        return httpd_resp_send_404(req);
     }
     
-    return ESP_OK;
-} 
\ No newline at end of file
+    int sent = httpd_send(req, probe->response, probe->responseLen);
+    return sent == probe->responseLen ? ESP_OK : ESP_FAIL;
+} 
+
+static esp_err_t metricsSink(void* ctx, const char* data, size_t len) {
+    return httpd_resp_send_chunk(static_cast<httpd_req_t*>(ctx), data, len);
+}
+
+esp_err_t WiFiManager::handleMetrics(httpd_req_t *req) {
+    WM_LOGD("Metrics requested");
+#if WM_ENABLE_METRICS
+    WiFiManager* manager = getManagerFromRequest(req);
+    WM_METRIC_REQUEST(manager->_metrics, WM_ROUTE_METRICS);
+    
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return manager->_metrics.writeText(metricsSink, req);
+#else
+    (void)metricsSink;
+    return httpd_resp_send_404(req);
+#endif
+}
+#endif
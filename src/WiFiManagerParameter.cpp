@@ -3,8 +3,10 @@
 #include <cstring>
 #include <algorithm>
 
+static const char* const EMPTY_VALUE = "";
+
 WiFiManagerParameter::WiFiManagerParameter(const char* customHtml) 
-    : _length(0), _type(WMP_TYPE_TEXT) {
+    : _value(EMPTY_VALUE), _valueLength(0), _length(0), _type(WMP_TYPE_TEXT), _flags(0) {
     if (customHtml) {
         _customHTML = customHtml;
     }
@@ -15,15 +17,17 @@ WiFiManagerParameter::WiFiManagerParameter(const char* id,
                                          const char* defaultValue, 
                                          int length, 
                                          const char* custom, 
-                                         int type) {
+                                         int type)
+    : _value(EMPTY_VALUE), _valueLength(0), _length(0), _type(WMP_TYPE_TEXT), _flags(0) {
     init(id, placeholder, defaultValue, length, custom, type);
 }
 
 WiFiManagerParameter::~WiFiManagerParameter() {
-    // Destructors for std::string members are called automatically
+    releaseValue();
 }
 
-WiFiManagerParameter::WiFiManagerParameter(const WiFiManagerParameter& other) {
+WiFiManagerParameter::WiFiManagerParameter(const WiFiManagerParameter& other)
+    : _value(EMPTY_VALUE), _valueLength(0), _length(0), _type(WMP_TYPE_TEXT), _flags(0) {
     copyFrom(other);
 }
 
@@ -40,50 +44,104 @@ void WiFiManagerParameter::init(const char* id,
                                int length, 
                                const char* custom, 
                                int type) {
+    releaseValue();
+    
     _id = id ? id : "";
     _placeholder = placeholder ? placeholder : "";
-    _label = placeholder ? placeholder : "";  // Use placeholder as label if not specified
-    _value = defaultValue ? defaultValue : "";
     _customHTML = custom ? custom : "";
-    _length = std::max(length, static_cast<int>(_value.length()));
+    
+    // The default stays where it is until the value is first changed
+    _value = defaultValue ? defaultValue : EMPTY_VALUE;
+    _valueLength = strlen(_value);
+    _length = std::min(std::max(length, static_cast<int>(_valueLength)), 0xFFFF);
     _type = type;
     
     WM_LOGD("Created parameter: id=%s, placeholder=%s, length=%d, type=%d", 
-            _id.c_str(), _placeholder.c_str(), _length, _type);
+            getID(), getPlaceholder(), _length, _type);
 }
 
 void WiFiManagerParameter::copyFrom(const WiFiManagerParameter& other) {
+    releaseValue();
+    
     _id = other._id;
     _placeholder = other._placeholder;
-    _label = other._label;
-    _value = other._value;
     _customHTML = other._customHTML;
     _length = other._length;
     _type = other._type;
+    
+    // Borrowed defaults can be shared, writable storage can't
+    if (other._flags & VALUE_WRITABLE) {
+        _value = EMPTY_VALUE;
+        _valueLength = 0;
+        setValue(other._value, other._valueLength);
+    } else {
+        _value = other._value;
+        _valueLength = other._valueLength;
+    }
+}
+
+void WiFiManagerParameter::releaseValue() {
+    if (_flags & VALUE_OWNED) {
+        delete[] const_cast<char*>(_value);
+    }
+    _value = EMPTY_VALUE;
+    _valueLength = 0;
+    _flags = 0;
+}
+
+char* WiFiManagerParameter::writableValue() {
+    if (!(_flags & VALUE_WRITABLE)) {
+        // Standalone parameter: give it its own fixed-size buffer
+        char* buffer = new char[storageSize()];
+        memcpy(buffer, _value, _valueLength);
+        buffer[_valueLength] = '\0';
+        _value = buffer;
+        _flags = VALUE_WRITABLE | VALUE_OWNED;
+    }
+    return const_cast<char*>(_value);
+}
+
+void WiFiManagerParameter::attachStorage(char* buffer) {
+    memcpy(buffer, _value, _valueLength);
+    buffer[_valueLength] = '\0';
+    
+    uint16_t valueLength = _valueLength;
+    releaseValue();
+    _value = buffer;
+    _valueLength = valueLength;
+    _flags = VALUE_WRITABLE;
+}
+
+void WiFiManagerParameter::detachStorage() {
+    if ((_flags & VALUE_WRITABLE) && !(_flags & VALUE_OWNED)) {
+        // The arena is going away, copy the current value into our own buffer
+        _flags = 0;
+        writableValue();
+    }
 }
 
 const char* WiFiManagerParameter::getID() const {
-    return _id.c_str();
+    return _id.data();
 }
 
 const char* WiFiManagerParameter::getValue() const {
-    return _value.c_str();
+    return _value;
 }
 
 const char* WiFiManagerParameter::getPlaceholder() const {
-    return _placeholder.c_str();
+    return _placeholder.data();
 }
 
 const char* WiFiManagerParameter::getLabel() const {
-    return _label.c_str();
+    return _placeholder.data();  // Placeholder doubles as label
 }
 
 int WiFiManagerParameter::getValueLength() const {
-    return _value.length();
+    return _valueLength;
 }
 
 const char* WiFiManagerParameter::getCustomHTML() const {
-    return _customHTML.c_str();
+    return _customHTML.data();
 }
 
 int WiFiManagerParameter::getType() const {
@@ -92,33 +150,31 @@ int WiFiManagerParameter::getType() const {
 
 void WiFiManagerParameter::setValue(const char* value, int length) {
     if (!value) {
-        _value.clear();
+        setValue(std::string_view());
         return;
     }
     
+    size_t len = strlen(value);
     if (length >= 0) {
-        _value.assign(value, std::min(length, static_cast<int>(strlen(value))));
-    } else {
-        _value = value;
+        len = std::min(static_cast<size_t>(length), len);
     }
-    
-    // Update length if necessary
-    if (static_cast<int>(_value.length()) > _length) {
-        _length = _value.length();
-    }
-    
-    WM_LOGD("Parameter %s value set to: %s", _id.c_str(), _value.c_str());
+    setValue(std::string_view(value, len));
 }
 
 void WiFiManagerParameter::setValue(const std::string& value) {
-    setValue(value.c_str(), value.length());
+    setValue(std::string_view(value));
 }
 
 void WiFiManagerParameter::setValue(std::string_view value) {
-    _value = value;
-    if (static_cast<int>(_value.length()) > _length) {
-        _length = _value.length();
+    if (value.length() > _length) {
+        WM_LOGW("Parameter %s value truncated to %d chars", getID(), _length);
+        value = value.substr(0, _length);
     }
     
-    WM_LOGD("Parameter %s value set to: %s", _id.c_str(), _value.c_str());
-} 
\ No newline at end of file
+    char* buffer = writableValue();
+    memmove(buffer, value.data(), value.length());
+    buffer[value.length()] = '\0';
+    _valueLength = value.length();
+    
+    WM_LOGD("Parameter %s value set to: %s", getID(), _value);
+}
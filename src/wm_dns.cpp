@@ -0,0 +1,113 @@
+#include "wm_dns.h"
+#include <cstring>
+
+#define DNS_HEADER_SIZE 12
+#define DNS_ANSWER_SIZE 16
+#define DNS_TTL 60
+
+// Header field offsets
+#define DNS_OFF_FLAGS   2
+#define DNS_OFF_QDCOUNT 4
+#define DNS_OFF_ANCOUNT 6
+#define DNS_OFF_NSCOUNT 8
+#define DNS_OFF_ARCOUNT 10
+
+// DNS flags
+#define DNS_FLAG_RESPONSE   0x8000
+#define DNS_FLAG_AA         0x0400  // Authoritative Answer
+#define DNS_FLAG_RD         0x0100  // Recursion Desired (echoed back)
+#define DNS_OPCODE_MASK     0x7800
+#define DNS_RCODE_FORMERR   1
+#define DNS_RCODE_NOTIMP    4
+
+// Query types and classes we care about
+#define DNS_TYPE_A      1
+#define DNS_TYPE_ANY    255
+#define DNS_CLASS_IN    1
+
+// Fields are big-endian and the buffer has no alignment guarantee
+static inline uint16_t get16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline void put16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+WMDnsResponder::WMDnsResponder(uint32_t ip) : _ip(ip) {
+}
+
+int WMDnsResponder::skipName(const uint8_t* packet, int len, int pos) {
+    while (pos < len) {
+        uint8_t label = packet[pos];
+        if (label == 0) {
+            return pos + 1;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            // Compression pointer always ends the name
+            return pos + 2 <= len ? pos + 2 : -1;
+        }
+        if (label > 63) {
+            return -1;
+        }
+        pos += label + 1;
+    }
+    return -1;
+}
+
+int WMDnsResponder::respond(uint8_t* packet, int len) const {
+    if (len < DNS_HEADER_SIZE) {
+        return 0;
+    }
+    
+    uint16_t flags = get16(packet + DNS_OFF_FLAGS);
+    if (flags & DNS_FLAG_RESPONSE) {
+        return 0;  // Never answer responses
+    }
+    
+    uint16_t rflags = DNS_FLAG_RESPONSE | DNS_FLAG_AA | (flags & (DNS_OPCODE_MASK | DNS_FLAG_RD));
+    put16(packet + DNS_OFF_ANCOUNT, 0);
+    put16(packet + DNS_OFF_NSCOUNT, 0);
+    put16(packet + DNS_OFF_ARCOUNT, 0);
+    
+    // Only standard queries with at least one question are answered
+    int qend = -1;
+    if ((flags & DNS_OPCODE_MASK) != 0) {
+        rflags |= DNS_RCODE_NOTIMP;
+    } else if (get16(packet + DNS_OFF_QDCOUNT) == 0 ||
+               (qend = skipName(packet, len, DNS_HEADER_SIZE)) < 0 || qend + 4 > len) {
+        rflags |= DNS_RCODE_FORMERR;
+        qend = -1;
+    }
+    put16(packet + DNS_OFF_FLAGS, rflags);
+    if (qend < 0) {
+        put16(packet + DNS_OFF_QDCOUNT, 0);
+        return DNS_HEADER_SIZE;
+    }
+    
+    // Answer the first question only; trailing questions and EDNS records are dropped
+    uint16_t qtype = get16(packet + qend);
+    uint16_t qclass = get16(packet + qend + 2);
+    int pos = qend + 4;
+    put16(packet + DNS_OFF_QDCOUNT, 1);
+    
+    // AAAA, HTTPS and everything else get an empty NOERROR so clients fall back to A quickly
+    if ((qtype != DNS_TYPE_A && qtype != DNS_TYPE_ANY) || qclass != DNS_CLASS_IN ||
+        pos + DNS_ANSWER_SIZE > MAX_PACKET_SIZE) {
+        return pos;
+    }
+    
+    uint8_t* answer = packet + pos;
+    answer[0] = 0xC0;  // Name: pointer to the question at offset 12
+    answer[1] = DNS_HEADER_SIZE;
+    put16(answer + 2, DNS_TYPE_A);
+    put16(answer + 4, DNS_CLASS_IN);
+    put16(answer + 6, 0);  // TTL
+    put16(answer + 8, DNS_TTL);
+    put16(answer + 10, 4); // Data length (4 bytes for IPv4)
+    memcpy(answer + 12, &_ip, 4);  // Already in network byte order
+    put16(packet + DNS_OFF_ANCOUNT, 1);
+    
+    return pos + DNS_ANSWER_SIZE;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Captive-portal DNS answers, built in place in the query buffer.
+ * Every A/ANY question is answered with the portal address, anything else
+ * gets an empty NOERROR. Pure packet logic with no socket or driver calls,
+ * so it can be driven from recorded captures off-target.
+ */
+class WMDnsResponder {
+public:
+    static constexpr int MAX_PACKET_SIZE = 512;
+
+    // ip is the IPv4 address to answer with, in network byte order
+    explicit WMDnsResponder(uint32_t ip);
+
+    // Turns the query in packet into its response, returns the response length or 0 to drop
+    int respond(uint8_t* packet, int len) const;
+
+    // Offset just past the name starting at pos, or -1 if it is malformed
+    static int skipName(const uint8_t* packet, int len, int pos);
+
+private:
+    uint32_t _ip;
+};
@@ -0,0 +1,114 @@
+#include "wm_form_parser.h"
+
+WMFormParser::WMFormParser(FieldHandler handler, void* ctx)
+    : _handler(handler), _ctx(ctx), _keyLen(0), _valueLen(0), _inValue(false),
+      _keyOverflow(false), _valueOverflow(false), _escape(0), _escapeHi(0) {
+}
+
+uint32_t WMFormParser::hashKey(const char* key, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= static_cast<uint8_t>(key[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int WMFormParser::hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void WMFormParser::feed(const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        
+        if (_escape) {
+            int v = hexValue(c);
+            if (v >= 0 && _escape == 2) {
+                _escapeHi = v;
+                _escape = 1;
+                continue;
+            }
+            if (v >= 0) {
+                putRaw(static_cast<char>((_escapeHi << 4) | v));
+                _escape = 0;
+                continue;
+            }
+            // Malformed escape: keep what we had literally and process c normally
+            putRaw('%');
+            if (_escape == 1) {
+                putRaw("0123456789ABCDEF"[_escapeHi]);
+            }
+            _escape = 0;
+        }
+        
+        switch (c) {
+            case '&':
+                dispatch();
+                break;
+            case '=':
+                if (!_inValue) {
+                    _inValue = true;
+                } else {
+                    putRaw(c);
+                }
+                break;
+            case '%':
+                _escape = 2;
+                break;
+            case '+':
+                putRaw(' ');
+                break;
+            default:
+                putRaw(c);
+                break;
+        }
+    }
+}
+
+void WMFormParser::putRaw(char c) {
+    if (_inValue) {
+        if (_valueLen < VALUE_SIZE) {
+            _value[_valueLen++] = c;
+        } else {
+            _valueOverflow = true;
+        }
+    } else {
+        if (_keyLen < KEY_SIZE) {
+            _key[_keyLen++] = c;
+        } else {
+            _keyOverflow = true;
+        }
+    }
+}
+
+void WMFormParser::dispatch() {
+    // A trailing '%' or '%X' is kept literally
+    if (_escape) {
+        putRaw('%');
+        if (_escape == 1) {
+            putRaw("0123456789ABCDEF"[_escapeHi]);
+        }
+        _escape = 0;
+    }
+    
+    // Keys that don't fit can't match anything, skip the pair
+    if (_keyLen > 0 && !_keyOverflow) {
+        _key[_keyLen] = '\0';
+        _value[_valueLen] = '\0';
+        _handler(_ctx, _key, _keyLen, _value, _valueLen, _valueOverflow);
+    }
+    
+    _keyLen = 0;
+    _valueLen = 0;
+    _inValue = false;
+    _keyOverflow = false;
+    _valueOverflow = false;
+}
+
+void WMFormParser::finish() {
+    dispatch();
+}
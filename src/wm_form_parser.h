@@ -0,0 +1,46 @@
+#pragma once
+
+#include "wm_limits.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Incremental application/x-www-form-urlencoded tokenizer.
+ * Body chunks are fed as they arrive from httpd_req_recv(); keys and values
+ * are URL-decoded straight into fixed buffers and each pair is dispatched
+ * once complete, so a body of any size is parsed in one pass without heap.
+ */
+class WMFormParser {
+public:
+    // Called once per key/value pair, both NUL-terminated; truncated if the value didn't fit
+    typedef void (*FieldHandler)(void* ctx, const char* key, size_t keyLen,
+                                 const char* value, size_t valueLen, bool truncated);
+
+    WMFormParser(FieldHandler handler, void* ctx);
+
+    void feed(const char* data, size_t len);
+    void finish();  // Dispatch the last pair
+
+    // FNV-1a over a key, for precomputed lookups
+    static uint32_t hashKey(const char* key, size_t len);
+
+private:
+    static constexpr size_t KEY_SIZE = WM_FORM_KEY_MAX;
+    static constexpr size_t VALUE_SIZE = WM_FORM_VALUE_MAX;
+
+    FieldHandler _handler;
+    void* _ctx;
+    char _key[KEY_SIZE + 1];
+    char _value[VALUE_SIZE + 1];
+    size_t _keyLen;
+    size_t _valueLen;
+    bool _inValue;
+    bool _keyOverflow;
+    bool _valueOverflow;
+    uint8_t _escape;     // Hex digits still expected after '%'
+    uint8_t _escapeHi;   // First hex digit of the pending escape
+
+    void putRaw(char c);
+    void dispatch();
+    static int hexValue(char c);
+};
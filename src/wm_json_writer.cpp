@@ -0,0 +1,188 @@
+#include "wm_json_writer.h"
+#include "esp_http_server.h"
+#include <cstring>
+
+WMJsonWriter::WMJsonWriter(httpd_req_t* req)
+    : WMJsonWriter(httpdSink, req) {
+}
+
+WMJsonWriter::WMJsonWriter(Sink sink, void* ctx)
+    : _sink(sink), _ctx(ctx), _len(0), _depth(0), _first(1), _err(ESP_OK) {
+}
+
+esp_err_t WMJsonWriter::httpdSink(void* ctx, const char* data, size_t len) {
+    return httpd_resp_send_chunk(static_cast<httpd_req_t*>(ctx), data, len);
+}
+
+void WMJsonWriter::beginObject() {
+    separator();
+    open('{');
+}
+
+void WMJsonWriter::endObject() {
+    close('}');
+}
+
+void WMJsonWriter::beginArray() {
+    separator();
+    open('[');
+}
+
+void WMJsonWriter::beginArray(const char* name) {
+    key(name);
+    open('[');
+}
+
+void WMJsonWriter::endArray() {
+    close(']');
+}
+
+void WMJsonWriter::field(const char* name, const char* value) {
+    key(name);
+    writeString(value);
+}
+
+void WMJsonWriter::field(const char* name, int value) {
+    key(name);
+    writeInt(value);
+}
+
+void WMJsonWriter::field(const char* name, long value) {
+    key(name);
+    writeInt(value);
+}
+
+void WMJsonWriter::field(const char* name, bool value) {
+    key(name);
+    write(value ? "true" : "false", value ? 4 : 5);
+}
+
+void WMJsonWriter::value(const char* value) {
+    separator();
+    writeString(value);
+}
+
+void WMJsonWriter::value(int value) {
+    separator();
+    writeInt(value);
+}
+
+void WMJsonWriter::value(long value) {
+    separator();
+    writeInt(value);
+}
+
+void WMJsonWriter::value(bool value) {
+    separator();
+    write(value ? "true" : "false", value ? 4 : 5);
+}
+
+esp_err_t WMJsonWriter::finish() {
+    flush();
+    if (_err == ESP_OK) {
+        _err = _sink(_ctx, nullptr, 0);
+    }
+    return _err;
+}
+
+void WMJsonWriter::separator() {
+    uint8_t bit = 1 << _depth;
+    if (_first & bit) {
+        _first &= ~bit;
+    } else {
+        put(',');
+    }
+}
+
+void WMJsonWriter::key(const char* name) {
+    separator();
+    writeString(name);
+    put(':');
+}
+
+void WMJsonWriter::open(char c) {
+    put(c);
+    if (_depth < MAX_DEPTH - 1) {
+        _depth++;
+        _first |= 1 << _depth;
+    }
+}
+
+void WMJsonWriter::close(char c) {
+    if (_depth > 0) {
+        _depth--;
+    }
+    put(c);
+}
+
+void WMJsonWriter::put(char c) {
+    if (_len == BUFFER_SIZE) {
+        flush();
+    }
+    _buf[_len++] = c;
+}
+
+void WMJsonWriter::write(const char* data, size_t len) {
+    while (len > 0) {
+        if (_len == BUFFER_SIZE) {
+            flush();
+        }
+        size_t n = BUFFER_SIZE - _len;
+        if (n > len) n = len;
+        memcpy(_buf + _len, data, n);
+        _len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void WMJsonWriter::writeString(const char* str) {
+    static const char hex[] = "0123456789abcdef";
+    
+    put('"');
+    for (const unsigned char* p = reinterpret_cast<const unsigned char*>(str ? str : ""); *p; p++) {
+        // Same escapes cJSON produces
+        switch (*p) {
+            case '"':  write("\\\"", 2); break;
+            case '\\': write("\\\\", 2); break;
+            case '\b': write("\\b", 2); break;
+            case '\f': write("\\f", 2); break;
+            case '\n': write("\\n", 2); break;
+            case '\r': write("\\r", 2); break;
+            case '\t': write("\\t", 2); break;
+            default:
+                if (*p < 0x20) {
+                    char esc[6] = {'\\', 'u', '0', '0', hex[*p >> 4], hex[*p & 0x0F]};
+                    write(esc, sizeof(esc));
+                } else {
+                    put(static_cast<char>(*p));
+                }
+                break;
+        }
+    }
+    put('"');
+}
+
+void WMJsonWriter::writeInt(long value) {
+    char tmp[21];
+    char* p = tmp + sizeof(tmp);
+    unsigned long v = value < 0 ? 0ul - static_cast<unsigned long>(value) : static_cast<unsigned long>(value);
+    
+    do {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (value < 0) {
+        *--p = '-';
+    }
+    write(p, tmp + sizeof(tmp) - p);
+}
+
+void WMJsonWriter::flush() {
+    if (_len == 0 || _err != ESP_OK) {
+        _len = 0;
+        return;
+    }
+    _err = _sink(_ctx, _buf, _len);
+    _len = 0;
+}
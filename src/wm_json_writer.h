@@ -0,0 +1,66 @@
+#pragma once
+
+#include "wm_limits.h"
+#include "esp_err.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Minimal streaming JSON emitter with a fixed-size buffer.
+ * Output is written compact and flushed through httpd_resp_send_chunk()
+ * whenever the buffer fills, so no heap is used regardless of document size.
+ */
+class WMJsonWriter {
+public:
+    // Sink receives each flushed chunk; a null/zero call terminates the response
+    typedef esp_err_t (*Sink)(void* ctx, const char* data, size_t len);
+
+    // Streams into a chunked httpd response
+    explicit WMJsonWriter(struct httpd_req* req);
+    WMJsonWriter(Sink sink, void* ctx);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void beginArray(const char* key);   // As an object member
+    void endArray();
+
+    // Object members
+    void field(const char* key, const char* value);
+    void field(const char* key, int value);
+    void field(const char* key, long value);
+    void field(const char* key, bool value);
+
+    // Array elements
+    void value(const char* value);
+    void value(int value);
+    void value(long value);
+    void value(bool value);
+
+    // Flush remaining output and terminate the chunked response
+    esp_err_t finish();
+
+private:
+    static constexpr size_t BUFFER_SIZE = WM_JSON_CHUNK_SIZE;
+    static constexpr int MAX_DEPTH = 8;
+
+    Sink _sink;
+    void* _ctx;
+    char _buf[BUFFER_SIZE];
+    size_t _len;
+    int _depth;
+    uint8_t _first;  // One bit per nesting level: no element written yet
+    esp_err_t _err;
+
+    void separator();
+    void key(const char* key);
+    void open(char c);
+    void close(char c);
+    void put(char c);
+    void write(const char* data, size_t len);
+    void writeString(const char* str);
+    void writeInt(long value);
+    void flush();
+
+    static esp_err_t httpdSink(void* ctx, const char* data, size_t len);
+};
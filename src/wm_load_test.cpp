@@ -0,0 +1,257 @@
+#include "wm_load_test.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "lwip/inet.h"
+#include <cstdio>
+#include <cstring>
+
+// What phones and laptops fetch right after joining the AP
+static const char* const PROBE_PATHS[] = {
+    "/generate_204", "/hotspot-detect.html", "/ncsi.txt", "/"
+};
+
+static const char* const PROBE_NAMES[] = {
+    "connectivitycheck.gstatic.com", "captive.apple.com",
+    "www.msftconnecttest.com", "detectportal.firefox.com"
+};
+
+static constexpr size_t PROBE_COUNT = sizeof(PROBE_PATHS) / sizeof(PROBE_PATHS[0]);
+static constexpr size_t NAME_COUNT = sizeof(PROBE_NAMES) / sizeof(PROBE_NAMES[0]);
+
+static void setLoopback(struct sockaddr_in& addr, uint16_t port) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+}
+
+static void setTimeouts(int sock) {
+    struct timeval tv = {};
+    tv.tv_sec = WM_LOAD_TEST_TIMEOUT_MS / 1000;
+    tv.tv_usec = (WM_LOAD_TEST_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// Never spin without yielding, an interval of 0 still gives the IDLE task a tick
+static void idleFor(uint16_t ms) {
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    vTaskDelay(ticks > 0 ? ticks : 1);
+}
+
+WMLoadTest::WMLoadTest(WMMetrics& metrics, uint16_t httpPort, uint16_t dnsPort) :
+    _metrics(metrics),
+    _httpPort(httpPort),
+    _dnsPort(dnsPort),
+    _config{},
+    _deadline(0),
+    _running(false),
+    _activeTasks(0),
+    _nextClient(0)
+{
+}
+
+WMLoadTest::~WMLoadTest() {
+    stop();
+}
+
+bool WMLoadTest::start(const wm_load_test_config_t& config) {
+    if (_activeTasks.load() > 0) {
+        WM_LOGW("Load test already running");
+        return false;
+    }
+
+    _config = config;
+    if (_config.httpClients > WM_LOAD_TEST_MAX_CLIENTS) {
+        _config.httpClients = WM_LOAD_TEST_MAX_CLIENTS;
+    }
+    _deadline = _config.durationMs ? esp_timer_get_time() + (int64_t)_config.durationMs * 1000 : 0;
+    _running = true;
+
+    // Counted before creation so a task finishing early can't hit zero while others start
+    for (uint8_t i = 0; i < _config.httpClients; i++) {
+        _activeTasks.fetch_add(1);
+        if (xTaskCreate(httpClientTask, "wm_load_http", WM_LOAD_TEST_STACK_SIZE, this, 4, nullptr) != pdPASS) {
+            _activeTasks.fetch_sub(1);
+            WM_LOGW("Failed to create load test HTTP client %d", i);
+        }
+    }
+    if (_config.dnsIntervalMs > 0) {
+        _activeTasks.fetch_add(1);
+        if (xTaskCreate(dnsClientTask, "wm_load_dns", WM_LOAD_TEST_STACK_SIZE, this, 4, nullptr) != pdPASS) {
+            _activeTasks.fetch_sub(1);
+            WM_LOGW("Failed to create load test DNS client");
+        }
+    }
+
+    if (_activeTasks.load() == 0) {
+        _running = false;
+        WM_LOGE("Load test has no clients to run");
+        return false;
+    }
+
+    WM_LOGI("🧪 Load test started: %d HTTP clients every %d ms, DNS every %d ms, %lu ms",
+            _config.httpClients, _config.httpIntervalMs, _config.dnsIntervalMs,
+            (unsigned long)_config.durationMs);
+    return true;
+}
+
+void WMLoadTest::stop() {
+    _running = false;
+
+    // Clients notice within one socket timeout
+    int timeout = WM_LOAD_TEST_TIMEOUT_MS / 100 + 10;
+    while (_activeTasks.load() > 0 && timeout-- > 0) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (_activeTasks.load() > 0) {
+        WM_LOGW("Load test clients still running after stop");
+    }
+}
+
+bool WMLoadTest::isRunning() const {
+    return _activeTasks.load() > 0;
+}
+
+bool WMLoadTest::keepRunning() const {
+    return _running.load(std::memory_order_relaxed) &&
+           (_deadline == 0 || esp_timer_get_time() < _deadline);
+}
+
+void WMLoadTest::taskExit() {
+    if (_activeTasks.fetch_sub(1) == 1) {
+        _running = false;
+        WM_LOGI("🧪 Load test finished");
+    }
+}
+
+wm_load_result_t WMLoadTest::httpRequest(const char* path) const {
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        return WM_LOAD_DROPPED;
+    }
+    setTimeouts(sock);
+
+    struct sockaddr_in addr;
+    setLoopback(addr, _httpPort);
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return WM_LOAD_DROPPED;
+    }
+
+    char buf[192];
+    int len = snprintf(buf, sizeof(buf),
+                       "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: wm-load-test\r\n"
+                       "Accept-Encoding: gzip\r\nConnection: close\r\n\r\n", path);
+    if (send(sock, buf, len, 0) != len) {
+        close(sock);
+        return WM_LOAD_DROPPED;
+    }
+
+    // Keep the first bytes for the status line, drain the rest until the server closes
+    char status[16];
+    size_t statusLen = 0;
+    int n;
+    while ((n = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        if (statusLen < sizeof(status) - 1) {
+            size_t take = sizeof(status) - 1 - statusLen;
+            take = (size_t)n < take ? n : take;
+            memcpy(status + statusLen, buf, take);
+            statusLen += take;
+        }
+    }
+    close(sock);
+    status[statusLen] = '\0';
+
+    int code = 0;
+    if (n < 0 || sscanf(status, "HTTP/1.%*d %d", &code) != 1) {
+        return WM_LOAD_DROPPED;
+    }
+    return code >= 200 && code < 400 ? WM_LOAD_OK : WM_LOAD_ERROR;
+}
+
+bool WMLoadTest::dnsQuery(int sock, uint16_t id, const char* name) const {
+    uint8_t packet[96] = {};
+    packet[0] = id >> 8;
+    packet[1] = id & 0xFF;
+    packet[2] = 0x01;   // RD
+    packet[5] = 1;      // QDCOUNT
+
+    // Labels: each dot-separated part prefixed by its length
+    size_t pos = 12;
+    const char* label = name;
+    while (*label && pos < sizeof(packet) - 6) {
+        const char* dot = strchr(label, '.');
+        size_t l = dot ? (size_t)(dot - label) : strlen(label);
+        if (l == 0 || l > 63 || pos + 1 + l > sizeof(packet) - 6) {
+            return false;
+        }
+        packet[pos++] = l;
+        memcpy(packet + pos, label, l);
+        pos += l;
+        label += l + (dot ? 1 : 0);
+    }
+    packet[pos++] = 0;
+    packet[pos++] = 0;
+    packet[pos++] = 1;  // QTYPE A
+    packet[pos++] = 0;
+    packet[pos++] = 1;  // QCLASS IN
+
+    if (send(sock, packet, pos, 0) != (int)pos) {
+        return false;
+    }
+
+    // Late answers to queries that already timed out are skipped by id
+    uint8_t reply[128];
+    int n;
+    while ((n = recv(sock, reply, sizeof(reply), 0)) >= 12) {
+        if (reply[0] == packet[0] && reply[1] == packet[1] && (reply[2] & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WMLoadTest::httpClientTask(void* pvParameters) {
+    WMLoadTest* self = static_cast<WMLoadTest*>(pvParameters);
+    // Stagger the clients so they don't all hit the same route together
+    size_t next = self->_nextClient.fetch_add(1);
+
+    while (self->keepRunning()) {
+        int64_t start = esp_timer_get_time();
+        wm_load_result_t result = self->httpRequest(PROBE_PATHS[next++ % PROBE_COUNT]);
+        self->_metrics.loadTestHttp(esp_timer_get_time() - start, result);
+        self->_metrics.sampleHeap();
+        idleFor(self->_config.httpIntervalMs);
+    }
+
+    self->taskExit();
+    vTaskDelete(nullptr);
+}
+
+void WMLoadTest::dnsClientTask(void* pvParameters) {
+    WMLoadTest* self = static_cast<WMLoadTest*>(pvParameters);
+    uint16_t id = 0;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        WM_LOGE("Failed to create load test DNS socket");
+    } else {
+        setTimeouts(sock);
+        struct sockaddr_in addr;
+        setLoopback(addr, self->_dnsPort);
+        connect(sock, (struct sockaddr*)&addr, sizeof(addr));
+
+        while (self->keepRunning()) {
+            id++;
+            int64_t start = esp_timer_get_time();
+            bool answered = self->dnsQuery(sock, id, PROBE_NAMES[id % NAME_COUNT]);
+            self->_metrics.loadTestDns(esp_timer_get_time() - start, answered);
+            idleFor(self->_config.dnsIntervalMs);
+        }
+        close(sock);
+    }
+
+    self->taskExit();
+    vTaskDelete(nullptr);
+}
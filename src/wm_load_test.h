@@ -0,0 +1,44 @@
+#pragma once
+
+#include "wm_config.h"
+#include "wm_metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Synthetic captive-portal clients for bench builds.
+ * HTTP client tasks request the OS connectivity probe URLs from the
+ * portal and a DNS task fires queries at the captive responder, both over
+ * loopback, so the full server path runs without any phones attached.
+ * Each request's client-side latency and outcome go into WMMetrics next to
+ * the server-side route histograms.
+ */
+class WMLoadTest {
+public:
+    WMLoadTest(WMMetrics& metrics, uint16_t httpPort, uint16_t dnsPort);
+    ~WMLoadTest();
+
+    bool start(const wm_load_test_config_t& config);
+    void stop();
+    bool isRunning() const;
+
+private:
+    static void httpClientTask(void* pvParameters);
+    static void dnsClientTask(void* pvParameters);
+
+    wm_load_result_t httpRequest(const char* path) const;
+    bool dnsQuery(int sock, uint16_t id, const char* name) const;
+    bool keepRunning() const;
+    void taskExit();
+
+    WMMetrics& _metrics;
+    uint16_t _httpPort;
+    uint16_t _dnsPort;
+    wm_load_test_config_t _config;
+    int64_t _deadline;              // esp_timer time, 0 = no deadline
+    std::atomic<bool> _running;
+    std::atomic<int> _activeTasks;
+    std::atomic<uint32_t> _nextClient;
+};
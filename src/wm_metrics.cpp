@@ -0,0 +1,268 @@
+#include "wm_metrics.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* const PHASE_NAMES[WM_PHASE_COUNT] = {
+    "init", "wifi_setup", "sta_assoc", "sta_dhcp", "ap_start",
+    "http_start", "dns_start", "scan_mode", "scan"
+};
+
+static const char* const ROUTE_NAMES[WM_ROUTE_COUNT] = {
+    "root", "wifi", "scan", "wifisave", "info", "exit", "status", "captive", "metrics", "events"
+};
+
+WMMetrics::WMMetrics() :
+    _dnsQueries(0),
+    _dnsWindowCount(0),
+    _dnsWindowStart(0),
+    _dnsLastQPS(0),
+    _dnsPeakQPS(0),
+    _heapLowWater(UINT32_MAX),
+    _loadHttpErrors(0),
+    _loadHttpDropped(0),
+    _loadDnsTimeouts(0)
+{
+    for (auto& phase : _phaseUs) {
+        phase = 0;
+    }
+    for (auto& route : _routes) {
+        reset(route);
+    }
+    reset(_loadHttp);
+    reset(_loadDns);
+}
+
+void WMMetrics::reset(Route& route) {
+    route.count = 0;
+    for (auto& bucket : route.buckets) {
+        bucket = 0;
+    }
+}
+
+void WMMetrics::record(Route& route, int64_t us) {
+    // Bucket i holds latencies in [2^i, 2^(i+1)) microseconds
+    uint32_t v = us > 0 ? static_cast<uint32_t>(us < UINT32_MAX ? us : UINT32_MAX) : 1;
+    int bucket = 31 - __builtin_clz(v);
+    if (bucket >= BUCKETS) {
+        bucket = BUCKETS - 1;
+    }
+
+    route.count.fetch_add(1, std::memory_order_relaxed);
+    route.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* WMMetrics::phaseName(wm_phase_t phase) {
+    return phase < WM_PHASE_COUNT ? PHASE_NAMES[phase] : "unknown";
+}
+
+const char* WMMetrics::routeName(wm_route_t route) {
+    return route < WM_ROUTE_COUNT ? ROUTE_NAMES[route] : "unknown";
+}
+
+void WMMetrics::phaseSet(wm_phase_t phase, int64_t us) {
+    if (phase < WM_PHASE_COUNT) {
+        _phaseUs[phase].store(us, std::memory_order_relaxed);
+    }
+}
+
+void WMMetrics::request(wm_route_t route, int64_t us) {
+    if (route < WM_ROUTE_COUNT) {
+        record(_routes[route], us);
+    }
+}
+
+void WMMetrics::dnsQuery() {
+    _dnsQueries.fetch_add(1, std::memory_order_relaxed);
+
+    // Fixed one second windows, only the DNS task writes these
+    int64_t now = esp_timer_get_time();
+    int64_t start = _dnsWindowStart.load(std::memory_order_relaxed);
+    if (now - start >= 1000000) {
+        uint32_t qps = now - start < 2000000 ? _dnsWindowCount.load(std::memory_order_relaxed) : 0;
+        _dnsLastQPS.store(qps, std::memory_order_relaxed);
+        if (qps > _dnsPeakQPS.load(std::memory_order_relaxed)) {
+            _dnsPeakQPS.store(qps, std::memory_order_relaxed);
+        }
+        _dnsWindowStart.store(now, std::memory_order_relaxed);
+        _dnsWindowCount.store(0, std::memory_order_relaxed);
+    }
+    _dnsWindowCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WMMetrics::sampleHeap() {
+    uint32_t free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    uint32_t low = _heapLowWater.load(std::memory_order_relaxed);
+    while (free < low && !_heapLowWater.compare_exchange_weak(low, free, std::memory_order_relaxed)) {
+    }
+}
+
+void WMMetrics::loadTestHttp(int64_t us, wm_load_result_t result) {
+    // Only successful requests go into the histogram, failures are counted
+    switch (result) {
+        case WM_LOAD_OK:
+            record(_loadHttp, us);
+            break;
+        case WM_LOAD_ERROR:
+            _loadHttpErrors.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case WM_LOAD_DROPPED:
+            _loadHttpDropped.fetch_add(1, std::memory_order_relaxed);
+            break;
+    }
+}
+
+void WMMetrics::loadTestDns(int64_t us, bool answered) {
+    if (answered) {
+        record(_loadDns, us);
+    } else {
+        _loadDnsTimeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint32_t WMMetrics::percentile(const Route& route, uint32_t total, uint32_t permille) {
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t rank = (total * permille + 999) / 1000;
+    uint32_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += route.buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return (2u << i) - 1;
+        }
+    }
+    return (2u << (BUCKETS - 1)) - 1;  // Counts raced ahead of the buckets
+}
+
+void WMMetrics::snapshot(wm_metrics_t& out) const {
+    memset(&out, 0, sizeof(out));
+
+    for (int i = 0; i < WM_PHASE_COUNT; i++) {
+        out.phaseUs[i] = _phaseUs[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < WM_ROUTE_COUNT; i++) {
+        uint32_t count = _routes[i].count.load(std::memory_order_relaxed);
+        out.routes[i].count = count;
+        out.routes[i].p50Us = percentile(_routes[i], count, 500);
+        out.routes[i].p99Us = percentile(_routes[i], count, 990);
+    }
+
+    out.dnsQueries = _dnsQueries.load(std::memory_order_relaxed);
+    // A window that ended long ago means the rate has dropped to zero
+    bool stale = esp_timer_get_time() - _dnsWindowStart.load(std::memory_order_relaxed) >= 2000000;
+    out.dnsQPS = stale ? 0 : _dnsLastQPS.load(std::memory_order_relaxed);
+    out.dnsPeakQPS = _dnsPeakQPS.load(std::memory_order_relaxed);
+
+    out.heapFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    uint32_t low = _heapLowWater.load(std::memory_order_relaxed);
+    out.heapLowWater = low < out.heapFree ? low : out.heapFree;
+    out.heapMinEver = esp_get_minimum_free_heap_size();
+
+    wm_load_test_metrics_t& lt = out.loadTest;
+    lt.httpRequests = _loadHttp.count.load(std::memory_order_relaxed);
+    lt.httpErrors = _loadHttpErrors.load(std::memory_order_relaxed);
+    lt.httpDropped = _loadHttpDropped.load(std::memory_order_relaxed);
+    lt.httpP50Us = percentile(_loadHttp, lt.httpRequests, 500);
+    lt.httpP99Us = percentile(_loadHttp, lt.httpRequests, 990);
+    lt.dnsQueries = _loadDns.count.load(std::memory_order_relaxed);
+    lt.dnsTimeouts = _loadDnsTimeouts.load(std::memory_order_relaxed);
+    lt.dnsP50Us = percentile(_loadDns, lt.dnsQueries, 500);
+    lt.dnsP99Us = percentile(_loadDns, lt.dnsQueries, 990);
+}
+
+esp_err_t WMMetrics::writeText(Sink sink, void* ctx) const {
+    wm_metrics_t m;
+    snapshot(m);
+
+    // Lines are batched into one buffer and flushed when the next one doesn't fit
+    char buf[WM_JSON_CHUNK_SIZE];
+    size_t len = 0;
+    char line[128];
+    esp_err_t err = ESP_OK;
+
+    auto emit = [&](int n) {
+        if (n <= 0 || err != ESP_OK) {
+            return;
+        }
+        size_t l = static_cast<size_t>(n) < sizeof(line) ? n : sizeof(line) - 1;
+        if (len + l > sizeof(buf)) {
+            err = sink(ctx, buf, len);
+            len = 0;
+        }
+        memcpy(buf + len, line, l);
+        len += l;
+    };
+
+    for (int i = 0; i < WM_PHASE_COUNT; i++) {
+        emit(snprintf(line, sizeof(line), "wm_phase_us{phase=\"%s\"} %lld\n",
+                      PHASE_NAMES[i], (long long)m.phaseUs[i]));
+    }
+    for (int i = 0; i < WM_ROUTE_COUNT; i++) {
+        const wm_route_metrics_t& r = m.routes[i];
+        emit(snprintf(line, sizeof(line), "wm_http_requests{route=\"%s\"} %lu\n",
+                      ROUTE_NAMES[i], (unsigned long)r.count));
+        if (r.count) {
+            emit(snprintf(line, sizeof(line), "wm_http_latency_us{route=\"%s\",q=\"0.5\"} %lu\n",
+                          ROUTE_NAMES[i], (unsigned long)r.p50Us));
+            emit(snprintf(line, sizeof(line), "wm_http_latency_us{route=\"%s\",q=\"0.99\"} %lu\n",
+                          ROUTE_NAMES[i], (unsigned long)r.p99Us));
+        }
+    }
+    emit(snprintf(line, sizeof(line), "wm_dns_queries %lu\nwm_dns_qps %lu\nwm_dns_qps_peak %lu\n",
+                  (unsigned long)m.dnsQueries, (unsigned long)m.dnsQPS, (unsigned long)m.dnsPeakQPS));
+    emit(snprintf(line, sizeof(line), "wm_heap_free %lu\nwm_heap_low_water %lu\nwm_heap_min_ever %lu\n",
+                  (unsigned long)m.heapFree, (unsigned long)m.heapLowWater, (unsigned long)m.heapMinEver));
+
+    // Load test lines only appear once a run has produced something
+    const wm_load_test_metrics_t& lt = m.loadTest;
+    if (lt.httpRequests || lt.httpErrors || lt.httpDropped) {
+        emit(snprintf(line, sizeof(line), "wm_load_http_requests %lu\nwm_load_http_errors %lu\nwm_load_http_dropped %lu\n",
+                      (unsigned long)lt.httpRequests, (unsigned long)lt.httpErrors, (unsigned long)lt.httpDropped));
+        emit(snprintf(line, sizeof(line), "wm_load_http_latency_us{q=\"0.5\"} %lu\nwm_load_http_latency_us{q=\"0.99\"} %lu\n",
+                      (unsigned long)lt.httpP50Us, (unsigned long)lt.httpP99Us));
+    }
+    if (lt.dnsQueries || lt.dnsTimeouts) {
+        emit(snprintf(line, sizeof(line), "wm_load_dns_queries %lu\nwm_load_dns_timeouts %lu\n",
+                      (unsigned long)lt.dnsQueries, (unsigned long)lt.dnsTimeouts));
+        emit(snprintf(line, sizeof(line), "wm_load_dns_latency_us{q=\"0.5\"} %lu\nwm_load_dns_latency_us{q=\"0.99\"} %lu\n",
+                      (unsigned long)lt.dnsP50Us, (unsigned long)lt.dnsP99Us));
+    }
+
+    if (err == ESP_OK && len > 0) {
+        err = sink(ctx, buf, len);
+    }
+    if (err == ESP_OK) {
+        err = sink(ctx, nullptr, 0);
+    }
+    return err;
+}
+
+WMScopeTimer::WMScopeTimer(WMMetrics& metrics, wm_phase_t phase) :
+    _metrics(metrics),
+    _start(esp_timer_get_time()),
+    _id(phase),
+    _isRoute(false)
+{
+}
+
+WMScopeTimer::WMScopeTimer(WMMetrics& metrics, wm_route_t route) :
+    _metrics(metrics),
+    _start(esp_timer_get_time()),
+    _id(route),
+    _isRoute(true)
+{
+}
+
+WMScopeTimer::~WMScopeTimer() {
+    int64_t elapsed = esp_timer_get_time() - _start;
+    if (_isRoute) {
+        _metrics.request(static_cast<wm_route_t>(_id), elapsed);
+    } else {
+        _metrics.phaseSet(static_cast<wm_phase_t>(_id), elapsed);
+    }
+    _metrics.sampleHeap();
+}
@@ -0,0 +1,55 @@
+#include "wm_param_html.h"
+
+void wmWriteParameter(WMTemplate& out, const WiFiManagerParameter& param) {
+    const char* id = param.getID();
+    
+    // Parameters without an id are plain custom HTML blocks
+    if (!id || !id[0]) {
+        out.write(param.getCustomHTML());
+        return;
+    }
+    
+    const char* type;
+    switch (param.getType()) {
+        case WMP_TYPE_PASSWORD: type = "password"; break;
+        case WMP_TYPE_NUMBER:   type = "number"; break;
+        case WMP_TYPE_CHECKBOX: type = "checkbox"; break;
+        case WMP_TYPE_HIDDEN:   type = "hidden"; break;
+        default:                type = "text"; break;
+    }
+    
+    bool hidden = param.getType() == WMP_TYPE_HIDDEN;
+    if (!hidden) {
+        out.write("<div class=\"form-group\"><label for=\"");
+        out.writeEscaped(id);
+        out.write("\">");
+        out.writeEscaped(param.getLabel());
+        out.write("</label>");
+    }
+    
+    bool textarea = param.getType() == WMP_TYPE_TEXTAREA;
+    out.write(textarea ? "<textarea id=\"" : "<input id=\"");
+    out.writeEscaped(id);
+    out.write("\" name=\"");
+    out.writeEscaped(id);
+    // The limit is the length the parameter was created with, not that of its value
+    out.printf("\" maxlength=\"%u\" placeholder=\"", static_cast<unsigned>(param.storageSize() - 1));
+    out.writeEscaped(param.getPlaceholder());
+    out.write("\" ");
+    out.write(param.getCustomHTML());
+    if (textarea) {
+        out.write(">");
+        out.writeEscaped(param.getValue());
+        out.write("</textarea>");
+    } else {
+        out.write(" type=\"");
+        out.write(type);
+        out.write("\" value=\"");
+        out.writeEscaped(param.getValue());
+        out.write("\">");
+    }
+    
+    if (!hidden) {
+        out.write("</div>");
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "WiFiManagerParameter.h"
+#include "wm_template.h"
+
+/**
+ * /wifi form fields for custom parameters, written into a page template.
+ * Free of manager state so the markup can be checked off-target.
+ */
+
+// A labelled <input> (or <textarea>) with the current value and the parameter's
+// length as maxlength; parameters without an id are written as their custom HTML
+void wmWriteParameter(WMTemplate& out, const WiFiManagerParameter& param);
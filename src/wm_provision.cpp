@@ -0,0 +1,86 @@
+#include "wm_provision.h"
+#include <cstring>
+
+WMProvisionReader::WMProvisionReader(const uint8_t* data, size_t len) :
+    _data(data),
+    _len(len),
+    _pos(WMProvisionWriter::HEADER_SIZE),
+    _op(0),
+    _seq(0),
+    _valid(false)
+{
+    if (len >= WMProvisionWriter::HEADER_SIZE && data[0] == 'W' && data[1] == 'M' &&
+        data[2] == WMProvisionWriter::VERSION && data[5] == WM_PROV_OK) {
+        _op = data[3];
+        _seq = data[4];
+        _valid = true;
+    }
+}
+
+bool WMProvisionReader::u8(uint8_t& out) {
+    if (_pos + 1 > _len) {
+        _pos = _len + 1;
+        return false;
+    }
+    out = _data[_pos++];
+    return true;
+}
+
+bool WMProvisionReader::str(const char*& out, uint8_t& len) {
+    if (!u8(len) || _pos + len > _len) {
+        _pos = _len + 1;
+        return false;
+    }
+    out = reinterpret_cast<const char*>(_data + _pos);
+    _pos += len;
+    return true;
+}
+
+WMProvisionWriter::WMProvisionWriter(uint8_t* buffer, size_t capacity, uint8_t op, uint8_t seq) :
+    _buffer(buffer),
+    _capacity(capacity),
+    _len(HEADER_SIZE)
+{
+    _buffer[0] = 'W';
+    _buffer[1] = 'M';
+    _buffer[2] = VERSION;
+    _buffer[3] = op;
+    _buffer[4] = seq;
+    _buffer[5] = WM_PROV_OK;
+}
+
+bool WMProvisionWriter::u8(uint8_t value) {
+    if (!fits(1)) {
+        return false;
+    }
+    _buffer[_len++] = value;
+    return true;
+}
+
+bool WMProvisionWriter::u32(uint32_t value) {
+    if (!fits(4)) {
+        return false;
+    }
+    _buffer[_len++] = value >> 24;
+    _buffer[_len++] = value >> 16;
+    _buffer[_len++] = value >> 8;
+    _buffer[_len++] = value;
+    return true;
+}
+
+bool WMProvisionWriter::str(const char* value, size_t len) {
+    if (len > 0xFF) {
+        len = 0xFF;
+    }
+    if (!fits(1 + len)) {
+        return false;
+    }
+    _buffer[_len++] = len;
+    memcpy(_buffer + _len, value, len);
+    _len += len;
+    return true;
+}
+
+bool WMProvisionWriter::str(const char* value) {
+    return str(value ? value : "", value ? strlen(value) : 0);
+}
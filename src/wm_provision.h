@@ -0,0 +1,83 @@
+#pragma once
+
+#include "wm_config.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Frames of the UDP provisioning protocol.
+ * Every datagram starts with "WM", the protocol version, an opcode, a
+ * sequence number echoed in the reply and a status byte (0 in requests).
+ * Strings are a length byte followed by that many bytes, multi-byte
+ * integers are big endian. Pure encoding with no socket or driver calls.
+ */
+enum wm_prov_op_t : uint8_t {
+    WM_PROV_INFO = 0x01,        // -> str name, u8 state, u8 paramCount
+    WM_PROV_SCAN = 0x02,        // u8 first -> u8 total, u8 first, u8 n, n x {str ssid, i8 rssi, u8 channel, u8 auth}
+    WM_PROV_PARAMS = 0x03,      // u8 first -> u8 total, u8 first, u8 n, n x {str id, str label, u8 maxLen, str value}
+    WM_PROV_SET_PARAM = 0x04,   // str id, str value
+    WM_PROV_CONNECT = 0x05,     // str ssid, str password
+    WM_PROV_STATUS = 0x06,      // -> u8 state, u8 result, u32 ip, i8 rssi
+    WM_PROV_EXIT = 0x07,
+};
+
+enum wm_prov_status_t : uint8_t {
+    WM_PROV_OK = 0,
+    WM_PROV_BAD_REQUEST,
+    WM_PROV_UNKNOWN_OP,
+    WM_PROV_NOT_FOUND,
+    WM_PROV_BUSY,               // Try again shortly, e.g. scan still running
+    WM_PROV_FAILED,
+};
+
+// Cursor over a received frame
+class WMProvisionReader {
+public:
+    WMProvisionReader(const uint8_t* data, size_t len);
+
+    // False for anything that isn't a well-formed request of this version
+    bool valid() const { return _valid; }
+    uint8_t op() const { return _op; }
+    uint8_t seq() const { return _seq; }
+
+    // Each getter fails (and keeps failing) once the frame runs out
+    bool u8(uint8_t& out);
+    bool str(const char*& out, uint8_t& len);
+
+private:
+    const uint8_t* _data;
+    size_t _len;
+    size_t _pos;
+    uint8_t _op;
+    uint8_t _seq;
+    bool _valid;
+};
+
+// Builds a reply in a caller-supplied buffer
+class WMProvisionWriter {
+public:
+    static constexpr size_t HEADER_SIZE = 6;
+    static constexpr uint8_t VERSION = 1;
+
+    WMProvisionWriter(uint8_t* buffer, size_t capacity, uint8_t op, uint8_t seq);
+
+    void status(wm_prov_status_t status) { _buffer[5] = status; }
+    bool u8(uint8_t value);
+    bool i8(int8_t value) { return u8(static_cast<uint8_t>(value)); }
+    bool u32(uint32_t value);
+    bool str(const char* value, size_t len);  // Longer than 255 bytes is truncated
+    bool str(const char* value);
+
+    // Patch a byte written earlier, e.g. a count only known at the end
+    void set(size_t pos, uint8_t value) { _buffer[pos] = value; }
+    bool fits(size_t bytes) const { return _len + bytes <= _capacity; }
+    size_t size() const { return _len; }
+
+    // Rewind to just after pos, dropping a partially written entry
+    void truncate(size_t pos) { _len = pos; }
+
+private:
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _len;
+};
@@ -0,0 +1,87 @@
+#include "wm_scan_json.h"
+#include <cstdio>
+
+// Open networks have always reported "Unknown" here; clients go by "encryption"
+static const char* securityName(uint8_t authmode) {
+    switch (authmode) {
+        case WIFI_AUTH_WEP: return "WEP";
+        case WIFI_AUTH_WPA_PSK: return "WPA";
+        case WIFI_AUTH_WPA2_PSK: return "WPA2";
+        case WIFI_AUTH_WPA_WPA2_PSK: return "WPA/WPA2";
+        case WIFI_AUTH_WPA3_PSK: return "WPA3";
+        case WIFI_AUTH_WPA2_WPA3_PSK: return "WPA2/WPA3";
+        default: return "Unknown";
+    }
+}
+
+void wmWriteScanList(WMJsonWriter& json, const WMScanRow* rows, size_t count, bool lean) {
+    json.beginArray();
+    for (size_t i = 0; i < count; i++) {
+        const WMScanRow& row = rows[i];
+        json.beginObject();
+        json.field("ssid", row.ssid);
+        json.field("rssi", row.rssi);
+        json.field("channel", row.channel);
+        json.field("encryption", row.authmode);
+        // The page only needs the fields above, a lean portal sends nothing more
+        if (!lean) {
+            json.field("hidden", false);
+            json.field("quality", WMScanTable::signalQuality(row.rssi));
+            json.field("security", securityName(row.authmode));
+        }
+        json.endObject();
+    }
+    json.endArray();
+}
+
+static void writeBSSID(WMJsonWriter& json, const uint8_t* bssid) {
+    char hex[13];
+    snprintf(hex, sizeof(hex), "%02x%02x%02x%02x%02x%02x",
+             bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+    json.value(hex);
+}
+
+void wmWriteScanDelta(WMJsonWriter& json, const WMScanRow* rows, size_t count,
+                      const WMScanHistory::Delta& delta, uint32_t since) {
+    // {"gen":N,"full":bool,"add":[[bssid,ssid,rssi,channel,auth]],"rssi":[[bssid,rssi]],"del":[bssid]}
+    // Removals go first in the client's patch, a BSSID can leave and come back within one diff
+    json.beginObject();
+    json.field("gen", (long)delta.generation);
+    json.field("full", delta.full);
+    
+    // Rows are only those that changed since the client's generation, or all of them when full
+    json.beginArray("add");
+    for (size_t i = 0; i < count; i++) {
+        const WMScanRow& row = rows[i];
+        if (!delta.full && row.added <= since) {
+            continue;
+        }
+        json.beginArray();
+        writeBSSID(json, row.bssid);
+        json.value(row.ssid);
+        json.value(row.rssi);
+        json.value(row.channel);
+        json.value(row.authmode);
+        json.endArray();
+    }
+    json.endArray();
+    
+    json.beginArray("rssi");
+    for (size_t i = 0; i < count && !delta.full; i++) {
+        if (rows[i].added > since) {
+            continue;
+        }
+        json.beginArray();
+        writeBSSID(json, rows[i].bssid);
+        json.value(rows[i].rssi);
+        json.endArray();
+    }
+    json.endArray();
+    
+    json.beginArray("del");
+    for (uint8_t i = 0; i < delta.removedCount; i++) {
+        writeBSSID(json, delta.removed[i]);
+    }
+    json.endArray();
+    json.endObject();
+}
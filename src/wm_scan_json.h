@@ -0,0 +1,18 @@
+#pragma once
+
+#include "wm_json_writer.h"
+#include "wm_scan_table.h"
+
+/**
+ * /scan response bodies, written from rows copied out of the scan table.
+ * Free of handler state so the schema can be checked off-target.
+ */
+
+// [{"ssid","rssi","channel","encryption","hidden","quality","security"},...]
+// strongest first; lean sends only the first four fields of each network
+void wmWriteScanList(WMJsonWriter& json, const WMScanRow* rows, size_t count, bool lean);
+
+// {"gen","full","add":[[bssid,ssid,rssi,channel,auth]],"rssi":[[bssid,rssi]],"del":[bssid]}
+// for a client at generation since; rows are those changed after it, or all when full
+void wmWriteScanDelta(WMJsonWriter& json, const WMScanRow* rows, size_t count,
+                      const WMScanHistory::Delta& delta, uint32_t since);
@@ -0,0 +1,387 @@
+#include "wm_scan_table.h"
+#include "wm_log.h"
+#include <cstring>
+
+static_assert(WMScanTable::CAPACITY < 0xFF, "Scan table slots must fit in uint8_t");
+
+WMScanTable::WMScanTable() {
+    reset();
+}
+
+void WMScanTable::reset(int minimumQuality, bool removeDuplicates) {
+    _count = 0;
+    _minimumQuality = minimumQuality;
+    _removeDuplicates = removeDuplicates;
+    memset(_index, EMPTY, sizeof(_index));
+}
+
+void WMScanTable::refresh(int minimumQuality, bool removeDuplicates) {
+    // The SSID index only exists with dedup, start over if that changed
+    if (removeDuplicates != _removeDuplicates) {
+        reset(minimumQuality, removeDuplicates);
+        return;
+    }
+    _minimumQuality = minimumQuality;
+    for (size_t slot = 0; slot < _count; slot++) {
+        _entries[slot].seen = false;
+        _entries[slot].altRssi = NO_ALT;
+    }
+}
+
+void WMScanTable::sweep() {
+    // An SSID whose listed BSSID went quiet moves to the strongest other one heard.
+    // The rest of the record (PHY modes, country) stays that of the old BSSID.
+    bool moved = false;
+    for (uint8_t slot = 0; slot < _count; slot++) {
+        Entry& e = _entries[slot];
+        if (!e.seen && e.altRssi != NO_ALT) {
+            memcpy(e.ap.bssid, e.altBssid, sizeof(e.ap.bssid));
+            e.ap.rssi = e.altRssi;
+            e.ap.primary = e.altChannel;
+            e.ap.authmode = e.altAuth;
+            e.seen = true;
+            moved = true;
+        }
+    }
+    
+    uint8_t remap[CAPACITY];
+    uint8_t kept = 0;
+    for (uint8_t slot = 0; slot < _count; slot++) {
+        if (!_entries[slot].seen) {
+            remap[slot] = EMPTY;
+            continue;
+        }
+        if (kept != slot) {
+            _entries[kept] = _entries[slot];
+        }
+        remap[slot] = kept++;
+    }
+    if (kept < _count) {
+        // Slots stay dense, so renumber the ranking and rebuild the index
+        size_t pos = 0;
+        for (size_t i = 0; i < _count; i++) {
+            if (remap[_order[i]] != EMPTY) {
+                _order[pos++] = remap[_order[i]];
+            }
+        }
+        _count = kept;
+        rebuildIndex();
+    }
+    if (moved) {
+        for (size_t pos = 1; pos < _count; pos++) {
+            bubbleUp(pos);
+        }
+    }
+}
+
+void WMScanTable::rebuildIndex() {
+    memset(_index, EMPTY, sizeof(_index));
+    if (_removeDuplicates) {
+        for (uint8_t slot = 0; slot < _count; slot++) {
+            indexInsert(slot);
+        }
+    }
+}
+
+int WMScanTable::signalQuality(int rssi) {
+    // Convert RSSI to percentage (0-100%)
+    // RSSI ranges typically from -100 (weak) to -30 (strong)
+    int quality = 2 * (rssi + 100);
+    if (quality > 100) quality = 100;
+    if (quality < 0) quality = 0;
+    return quality;
+}
+
+uint32_t WMScanTable::hashSSID(const char* ssid) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < WM_MAX_SSID_LEN && ssid[i]; i++) {
+        hash ^= static_cast<uint8_t>(ssid[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int WMScanTable::lookup(const char* ssid, uint32_t hash) const {
+    for (size_t i = hash & (INDEX_SIZE - 1); _index[i] != EMPTY; i = (i + 1) & (INDEX_SIZE - 1)) {
+        const Entry& e = _entries[_index[i]];
+        if (e.hash == hash && strcmp((const char*)e.ap.ssid, ssid) == 0) {
+            return _index[i];
+        }
+    }
+    return -1;
+}
+
+void WMScanTable::indexInsert(uint8_t slot) {
+    size_t i = _entries[slot].hash & (INDEX_SIZE - 1);
+    while (_index[i] != EMPTY) {
+        i = (i + 1) & (INDEX_SIZE - 1);
+    }
+    _index[i] = slot;
+}
+
+void WMScanTable::indexRemove(uint8_t slot) {
+    size_t i = _entries[slot].hash & (INDEX_SIZE - 1);
+    while (_index[i] != slot) {
+        i = (i + 1) & (INDEX_SIZE - 1);
+    }
+    
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & (INDEX_SIZE - 1);
+        if (_index[j] == EMPTY) {
+            break;
+        }
+        size_t home = _entries[_index[j]].hash & (INDEX_SIZE - 1);
+        // Move j back into the hole if its home isn't cyclically in (i, j]
+        bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            _index[i] = _index[j];
+            i = j;
+        }
+    }
+    _index[i] = EMPTY;
+}
+
+void WMScanTable::bubbleUp(size_t pos) {
+    uint8_t slot = _order[pos];
+    int8_t rssi = _entries[slot].ap.rssi;
+    while (pos > 0 && _entries[_order[pos - 1]].ap.rssi < rssi) {
+        _order[pos] = _order[pos - 1];
+        pos--;
+    }
+    _order[pos] = slot;
+}
+
+void WMScanTable::reorder(uint8_t slot) {
+    size_t pos = 0;
+    while (_order[pos] != slot) pos++;
+    
+    // A refreshed RSSI can move either way
+    int8_t rssi = _entries[slot].ap.rssi;
+    if (pos > 0 && _entries[_order[pos - 1]].ap.rssi < rssi) {
+        bubbleUp(pos);
+        return;
+    }
+    while (pos + 1 < _count && _entries[_order[pos + 1]].ap.rssi > rssi) {
+        _order[pos] = _order[pos + 1];
+        pos++;
+    }
+    _order[pos] = slot;
+}
+
+void WMScanTable::add(const wifi_ap_record_t& ap) {
+    const char* ssid = (const char*)ap.ssid;
+    
+    // Skip networks with empty SSID
+    if (ssid[0] == '\0') {
+        return;
+    }
+    
+    // Apply minimum quality filter
+    if (_minimumQuality > 0 && signalQuality(ap.rssi) < _minimumQuality) {
+        WM_LOGV("Filtering out %s (quality: %d < %d)", ssid, signalQuality(ap.rssi), _minimumQuality);
+        return;
+    }
+    
+    uint32_t hash = hashSSID(ssid);
+    
+    // Keep the strongest BSSID per SSID, or each BSSID once without dedup. An
+    // entry left over from before a refresh takes a new reading of its own BSSID
+    // and keeps its place against weaker ones, which wait for sweep().
+    int existingSlot = _removeDuplicates ? lookup(ssid, hash) : findSlot(ap.bssid);
+    if (existingSlot >= 0) {
+        Entry& existing = _entries[existingSlot];
+        bool same = memcmp(existing.ap.bssid, ap.bssid, sizeof(ap.bssid)) == 0;
+        if (ap.rssi > existing.ap.rssi || (same && !existing.seen)) {
+            WM_LOGV("Replacing %s (RSSI: %d -> %d)", ssid, existing.ap.rssi, ap.rssi);
+            existing.ap = ap;
+            existing.seen = true;
+            reorder(existingSlot);
+        } else if (!existing.seen && ap.rssi > existing.altRssi) {
+            memcpy(existing.altBssid, ap.bssid, sizeof(existing.altBssid));
+            existing.altRssi = ap.rssi;
+            existing.altChannel = ap.primary;
+            existing.altAuth = ap.authmode;
+        }
+        return;
+    }
+    
+    uint8_t slot;
+    if (_count < CAPACITY) {
+        slot = _count++;
+    } else {
+        // Table full - only a stronger network can displace the weakest one
+        slot = _order[CAPACITY - 1];
+        if (ap.rssi <= _entries[slot].ap.rssi) {
+            return;
+        }
+        if (_removeDuplicates) {
+            indexRemove(slot);
+        }
+    }
+    
+    _entries[slot].ap = ap;
+    _entries[slot].hash = hash;
+    _entries[slot].seen = true;
+    _entries[slot].altRssi = NO_ALT;
+    _entries[slot].added = 0;     // Unstamped until the table is published
+    _entries[slot].changed = 0;
+    if (_removeDuplicates) {
+        indexInsert(slot);
+    }
+    _order[_count - 1] = slot;
+    bubbleUp(_count - 1);
+}
+
+const wifi_ap_record_t* WMScanTable::find(const char* ssid) const {
+    if (!ssid || ssid[0] == '\0') {
+        return nullptr;
+    }
+    
+    if (_removeDuplicates) {
+        int slot = lookup(ssid, hashSSID(ssid));
+        return slot >= 0 ? &_entries[slot].ap : nullptr;
+    }
+    
+    // Without dedup the index isn't maintained; entries are few, scan by strength
+    for (size_t i = 0; i < _count; i++) {
+        if (strcmp((const char*)(*this)[i].ssid, ssid) == 0) {
+            return &(*this)[i];
+        }
+    }
+    return nullptr;
+}
+
+int WMScanTable::findSlot(const uint8_t* bssid) const {
+    // Few entries and no BSSID index, a linear pass is cheapest
+    for (size_t slot = 0; slot < _count; slot++) {
+        if (memcmp(_entries[slot].ap.bssid, bssid, sizeof(_entries[slot].ap.bssid)) == 0) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void WMScanTable::stamp(const WMScanTable& previous, uint32_t generation, int rssiStep) {
+    for (size_t slot = 0; slot < _count; slot++) {
+        Entry& e = _entries[slot];
+        int prev = previous.findSlot(e.ap.bssid);
+        if (prev < 0) {
+            e.added = generation;
+            e.changed = generation;
+            e.reportedRssi = e.ap.rssi;
+            continue;
+        }
+        
+        // Small fluctuations keep the old stamp so refreshes stay empty
+        const Entry& p = previous._entries[prev];
+        e.added = p.added;
+        int moved = e.ap.rssi - p.reportedRssi;
+        if (moved >= rssiStep || moved <= -rssiStep) {
+            e.changed = generation;
+            e.reportedRssi = e.ap.rssi;
+        } else {
+            e.changed = p.changed;
+            e.reportedRssi = p.reportedRssi;
+        }
+    }
+}
+
+size_t WMScanTable::copyRows(WMScanRow* out, uint32_t changedSince) const {
+    size_t n = 0;
+    for (size_t i = 0; i < _count; i++) {
+        const Entry& e = _entries[_order[i]];
+        if (changedSince && e.changed <= changedSince) {
+            continue;
+        }
+        WMScanRow& row = out[n++];
+        memcpy(row.bssid, e.ap.bssid, sizeof(row.bssid));
+        memcpy(row.ssid, e.ap.ssid, sizeof(row.ssid));
+        row.ssid[sizeof(row.ssid) - 1] = '\0';
+        row.rssi = e.ap.rssi;
+        row.channel = e.ap.primary;
+        row.authmode = e.ap.authmode;
+        row.added = e.added;
+        row.changed = e.changed;
+    }
+    return n;
+}
+
+WMScanHistory::WMScanHistory(uint32_t generation)
+    : _generation(generation), _floor(generation), _removals{}, _removalPos(0),
+      _listedCount(0), _listedOverflow(false) {
+}
+
+bool WMScanHistory::listed(const uint8_t* bssid) const {
+    for (size_t i = 0; i < _listedCount; i++) {
+        if (memcmp(_listed[i], bssid, 6) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WMScanHistory::recordRemoval(const uint8_t* bssid) {
+    // Overwriting a removal means diffs from before it can't be built anymore
+    Removal& removal = _removals[_removalPos];
+    if (removal.generation > _floor) {
+        _floor = removal.generation;
+    }
+    memcpy(removal.bssid, bssid, sizeof(removal.bssid));
+    removal.generation = _generation;
+    _removalPos = (_removalPos + 1) % WM_SCAN_REMOVALS;
+}
+
+void WMScanHistory::publish(const WMScanTable& next, bool complete) {
+    _generation++;
+    
+    // Partial results only add to what clients may be showing
+    if (!complete) {
+        for (size_t i = 0; i < next.size(); i++) {
+            const uint8_t* bssid = next.bssidAt(i);
+            if (listed(bssid)) {
+                continue;
+            }
+            if (_listedCount < LISTED_MAX) {
+                memcpy(_listed[_listedCount++], bssid, 6);
+            } else {
+                _listedOverflow = true;
+            }
+        }
+        return;
+    }
+    
+    for (size_t i = 0; i < _listedCount; i++) {
+        if (!next.contains(_listed[i])) {
+            recordRemoval(_listed[i]);
+        }
+    }
+    if (_listedOverflow) {
+        // A BSSID we lost track of may be gone; everyone starts over from here
+        _floor = _generation;
+        _listedOverflow = false;
+    }
+    
+    _listedCount = 0;
+    for (size_t i = 0; i < next.size(); i++) {
+        memcpy(_listed[_listedCount++], next.bssidAt(i), 6);
+    }
+}
+
+void WMScanHistory::delta(uint32_t since, Delta& out) const {
+    out.generation = _generation;
+    out.removedCount = 0;
+    
+    // Unknown generations (0, another boot, too far back) get the whole table
+    out.full = since == 0 || since > _generation || since < _floor;
+    if (out.full) {
+        return;
+    }
+    for (const Removal& removal : _removals) {
+        if (removal.generation > since) {
+            memcpy(out.removed[out.removedCount++], removal.bssid, sizeof(removal.bssid));
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#include "wm_template.h"
+#include "esp_http_server.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+WMTemplate::WMTemplate(httpd_req_t* req)
+    : WMTemplate(httpdSink, req) {
+}
+
+WMTemplate::WMTemplate(Sink sink, void* ctx)
+    : _sink(sink), _ctx(ctx), _len(0), _err(ESP_OK) {
+}
+
+esp_err_t WMTemplate::httpdSink(void* ctx, const char* data, size_t len) {
+    return httpd_resp_send_chunk(static_cast<httpd_req_t*>(ctx), data, len);
+}
+
+bool WMTemplate::isNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+esp_err_t WMTemplate::render(const uint8_t* start, const uint8_t* end, Resolver resolver, void* ctx) {
+    const char* p = reinterpret_cast<const char*>(start);
+    const char* stop = reinterpret_cast<const char*>(end);
+
+    while (p < stop && _err == ESP_OK) {
+        const char* open = static_cast<const char*>(memmem(p, stop - p, "{{", 2));
+        if (!open) {
+            writeStatic(p, stop - p);
+            break;
+        }
+
+        // Anything that doesn't look like {{name}} is passed through untouched
+        const char* name = open + 2;
+        const char* close = name;
+        while (close < stop && close - name < static_cast<ptrdiff_t>(MAX_NAME) && isNameChar(*close)) {
+            close++;
+        }
+        if (close == name || stop - close < 2 || close[0] != '}' || close[1] != '}') {
+            writeStatic(p, name - p);
+            p = name;
+            continue;
+        }
+
+        writeStatic(p, open - p);
+        resolver(ctx, std::string_view(name, close - name), *this);
+        p = close + 2;
+    }
+
+    flush();
+    if (_err == ESP_OK) {
+        _err = _sink(_ctx, nullptr, 0);
+    }
+    return _err;
+}
+
+void WMTemplate::write(const char* data, size_t len) {
+    while (len > 0 && _err == ESP_OK) {
+        if (_len == BUFFER_SIZE) {
+            flush();
+        }
+        size_t n = std::min(len, BUFFER_SIZE - _len);
+        memcpy(_buf + _len, data, n);
+        _len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void WMTemplate::write(const char* str) {
+    if (str) {
+        write(str, strlen(str));
+    }
+}
+
+void WMTemplate::writeEscaped(const char* str) {
+    if (!str) {
+        return;
+    }
+
+    const char* run = str;
+    for (const char* c = str; *c; c++) {
+        const char* entity;
+        switch (*c) {
+            case '&':  entity = "&amp;"; break;
+            case '<':  entity = "&lt;"; break;
+            case '>':  entity = "&gt;"; break;
+            case '"':  entity = "&quot;"; break;
+            case '\'': entity = "&#39;"; break;
+            default:   continue;
+        }
+        write(run, c - run);
+        write(entity);
+        run = c + 1;
+    }
+    write(run);
+}
+
+void WMTemplate::printf(const char* fmt, ...) {
+    char line[64];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n > 0) {
+        write(line, static_cast<size_t>(n) < sizeof(line) ? n : sizeof(line) - 1);
+    }
+}
+
+void WMTemplate::writeStatic(const char* data, size_t len) {
+    // Short runs between placeholders are batched, long ones go out directly from flash
+    if (len <= BUFFER_SIZE - _len) {
+        write(data, len);
+        return;
+    }
+
+    flush();
+    if (_err == ESP_OK && len > 0) {
+        _err = _sink(_ctx, data, len);
+    }
+}
+
+void WMTemplate::flush() {
+    if (_len > 0 && _err == ESP_OK) {
+        _err = _sink(_ctx, _buf, _len);
+    }
+    _len = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "wm_limits.h"
+#include "esp_err.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Renders an embedded page with {{name}} placeholders as a chunked response.
+ * Static text is sent straight from flash, placeholder values are produced by
+ * a resolver into a small fixed-size buffer, so nothing is assembled on the heap.
+ */
+class WMTemplate {
+public:
+    // Same contract as WMJsonWriter::Sink
+    typedef esp_err_t (*Sink)(void* ctx, const char* data, size_t len);
+    // Writes the value of one placeholder; writing nothing leaves it empty
+    // Names are [a-z0-9_]+, anything else between braces is left as literal text
+    typedef void (*Resolver)(void* ctx, std::string_view name, WMTemplate& out);
+
+    // Streams into a chunked httpd response
+    explicit WMTemplate(struct httpd_req* req);
+    WMTemplate(Sink sink, void* ctx);
+
+    // Render [start, end) and terminate the chunked response
+    esp_err_t render(const uint8_t* start, const uint8_t* end, Resolver resolver, void* ctx);
+
+    // Output helpers for resolvers
+    void write(const char* data, size_t len);
+    void write(const char* str);
+    void writeEscaped(const char* str);  // HTML-escapes &<>"'
+    void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+    static constexpr size_t BUFFER_SIZE = WM_JSON_CHUNK_SIZE;
+    static constexpr size_t MAX_NAME = 24;
+
+    Sink _sink;
+    void* _ctx;
+    char _buf[BUFFER_SIZE];
+    size_t _len;
+    esp_err_t _err;
+
+    void writeStatic(const char* data, size_t len);
+    void flush();
+
+    static bool isNameChar(char c);
+    static esp_err_t httpdSink(void* ctx, const char* data, size_t len);
+};
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Pack the portal web assets for embedding.
+
+Each input is minified (conservatively), optionally gzip-compressed and
+written to the output directory under its original file name. A header
+with one ETag per asset is generated alongside so the firmware can answer
+conditional requests with 304 Not Modified.
+
+Assets listed with --raw are HTML templates whose {{placeholders}} are
+resolved at request time; they are minified but never compressed.
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+
+def minify(name, text):
+    # Drop comments that can never be significant
+    if name.endswith('.html'):
+        text = re.sub(r'<!--.*?-->', '', text, flags=re.S)
+    if name.endswith(('.html', '.css')):
+        text = re.sub(r'/\*.*?\*/', '', text, flags=re.S)
+
+    lines = []
+    for line in text.splitlines():
+        line = line.strip()
+        if not line:
+            continue
+        # Full-line JS comments only; trailing ones may sit inside strings
+        if name.endswith(('.html', '.js')) and line.startswith('//'):
+            continue
+        lines.append(line)
+
+    # Keep line breaks so JS automatic semicolon insertion still works
+    return '\n'.join(lines) + '\n'
+
+
+def macro_name(name):
+    return 'WM_ETAG_' + re.sub(r'[^A-Za-z0-9]', '_', name).upper()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--out', required=True, help='output directory')
+    parser.add_argument('--header', required=True, help='generated header path')
+    parser.add_argument('--gzip', action='store_true', help='gzip-compress assets')
+    parser.add_argument('--raw', action='append', default=[], metavar='NAME',
+                        help='asset to leave uncompressed (repeatable)')
+    parser.add_argument('assets', nargs='+')
+    args = parser.parse_args()
+
+    os.makedirs(args.out, exist_ok=True)
+
+    defines = []
+    for path in args.assets:
+        name = os.path.basename(path)
+        with open(path, 'r', encoding='utf-8') as f:
+            data = minify(name, f.read()).encode('utf-8')
+        raw_len = len(data)
+
+        compress = args.gzip and name not in args.raw
+        if compress:
+            # mtime=0 keeps the output (and therefore the ETag) reproducible
+            data = gzip.compress(data, compresslevel=9, mtime=0)
+
+        with open(os.path.join(args.out, name), 'wb') as f:
+            f.write(data)
+
+        etag = hashlib.sha1(data).hexdigest()[:16]
+        defines.append('#define %s "\\"%s\\""' % (macro_name(name), etag))
+        print('%s: %d -> %d bytes' % (name, os.path.getsize(path), len(data)
+                                      if compress else raw_len))
+
+    with open(args.header, 'w') as f:
+        f.write('// Generated by tools/pack_assets.py - do not edit\n')
+        f.write('#pragma once\n\n')
+        f.write('// With 1 only the gzip copy of each asset is embedded; clients that\n'
+                '// don\'t accept gzip get 406 Not Acceptable from sendAsset()\n')
+        f.write('#define WM_ASSETS_GZIP %d\n\n' % (1 if args.gzip else 0))
+        f.write('\n'.join(defines) + '\n')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())